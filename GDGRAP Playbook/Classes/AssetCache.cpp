@@ -0,0 +1,235 @@
+#include "AssetCache.h"
+#include "Model.h"
+#include "MeshFile.h"
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+#include <chrono>
+
+// Decoded assets waiting for upload are held in memory, so the queue is kept short
+static const size_t MAX_PENDING_UPLOADS = 4;
+
+//Builds the lookup key for a mesh from its path and import options
+static std::string MeshKey(const std::string& filename, const MeshImportOptions& options) {
+    std::string key = filename + (options.generateTangents ? "|t1" : "|t0") + (options.generateLODs ? "|l1" : "|l0");
+    if (options.TransformsUVs()) {
+        for (int i = 0; i < 4; i++) {
+            key += "|u" + std::to_string(options.uvTransform[i]);
+        }
+    }
+    return key;
+}
+
+//Builds the lookup key for a texture from its path and import options
+static std::string TextureKey(const std::string& filename, const TextureImportOptions& options) {
+    return filename + (options.generateMipmaps ? "|m1" : "|m0") + "|l" + std::to_string(options.mipLevels) + (options.normalMap ? "|n1" : "|n0") + "|w" + std::to_string(options.wrapMode) + "|c" + std::to_string(options.compression);
+}
+
+//1x1 image shown until the real texture arrives: white for albedo, a flat normal for normal maps
+static ImageData PlaceholderImage(const TextureImportOptions& options) {
+    static unsigned char white[3] = { 255, 255, 255 };
+    static unsigned char flatNormal[3] = { 128, 128, 255 };
+
+    ImageData image;
+    image.width = 1;
+    image.height = 1;
+    image.channels = 3;
+    image.pixels = std::shared_ptr<unsigned char>(options.normalMap ? flatNormal : white, [](unsigned char*) {});
+    return image;
+}
+
+//AssetCache constructor; the shared pool is created first so it outlives the cache
+AssetCache::AssetCache() :
+    hits(0), misses(0), asyncLoading(false),
+    loadsQueued(0), loadsRunning(0), loadsFinished(0), shuttingDown(false) {
+    ThreadPool::Shared();
+}
+
+AssetCache::~AssetCache() {
+    Shutdown();
+}
+
+//Returns the single cache shared by every Model
+AssetCache& AssetCache::Instance() {
+    static AssetCache instance;
+    return instance;
+}
+
+//Returns the shared mesh for the file, loading it only if no live Model holds it yet.
+//The cooked .mesh next to the OBJ is used when it was made from the OBJ as it is now.
+std::shared_ptr<Mesh> AssetCache::GetMesh(const std::string& filename, const MeshImportOptions& options) {
+    std::weak_ptr<Mesh>& entry = meshes[MeshKey(filename, options)];
+    if (std::shared_ptr<Mesh> mesh = entry.lock()) {
+        hits++;
+        return mesh;
+    }
+
+    misses++;
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    entry = mesh;
+
+    QueueLoad([mesh, filename, options]() -> std::function<void()> {
+        std::string cookedFilename = MeshFile::GetCookedPath(filename, options);
+        uint64_t sourceSize = 0, sourceTime = 0;
+        bool hasSource = MappedFile::StatFile(filename, sourceSize, sourceTime);
+
+        std::shared_ptr<CookedMesh> cooked;
+        if (hasSource) {
+            cooked = MeshFile::Open(cookedFilename, options, filename, sourceSize, sourceTime);
+        }
+        if (cooked) {
+            // The GL copies straight out of the mapped pages; the mapping is released after the upload
+            return [mesh, cooked]() {
+                mesh->SetBounds(cooked->bounds);
+                mesh->Upload(cooked->vertexData, cooked->vertexCount, cooked->indexData, cooked->indexCount, cooked->indexType);
+                mesh->SetLODs(cooked->lods.data(), static_cast<int>(cooked->lods.size()));
+            };
+        }
+
+        // Missing or stale cook: import the OBJ and write a fresh .mesh for the next run
+        std::shared_ptr<MeshData> data = std::make_shared<MeshData>();
+        Model::LoadModel(filename, options, *data);
+        uint64_t sourceHash = 0;
+        if (hasSource && !data->vertices.empty() && MappedFile::HashFile(filename, sourceHash, sourceSize)) {
+            MeshFile::Write(cookedFilename, *data, options, sourceHash, sourceSize, sourceTime);
+        }
+        return [mesh, data]() {
+            mesh->Upload(*data);
+        };
+    });
+    return mesh;
+}
+
+//Returns the shared texture for the file, decoding and uploading it only if no live Model holds it yet.
+//Compressed textures come from the cooked .dds next to the image, which is rebuilt when the source changes.
+std::shared_ptr<Texture> AssetCache::GetTexture(const std::string& filename, const TextureImportOptions& options) {
+    std::weak_ptr<Texture>& entry = textures[TextureKey(filename, options)];
+    if (std::shared_ptr<Texture> texture = entry.lock()) {
+        hits++;
+        return texture;
+    }
+
+    misses++;
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    std::shared_ptr<Texture> texture = std::make_shared<Texture>(textureID);
+    entry = texture;
+
+    if (asyncLoading) {
+        Model::UploadTexture(textureID, PlaceholderImage(options), options);
+    }
+
+    // Format support is a GL query, so it is resolved here rather than on the loader thread
+    TextureFormatSupport support = TextureFormatSupport::Query();
+    bool compressed = TextureCooker::ChooseFormat(options, false, support) != TEXTURE_COMPRESSION_NONE;
+
+    QueueLoad([texture, filename, options, support, compressed]() -> std::function<void()> {
+        if (compressed) {
+            std::string cookedFilename = TextureCooker::GetCookedPath(filename, options);
+            uint64_t sourceHash = 0, sourceSize = 0;
+            bool hasSource = MappedFile::HashFile(filename, sourceHash, sourceSize);
+
+            std::shared_ptr<CookedTexture> cooked;
+            if (hasSource) {
+                cooked = TextureCooker::Open(cookedFilename, options, support, sourceHash, sourceSize);
+            }
+            if (!cooked && hasSource) {
+                // Missing or stale cook: encode the image now and write a fresh .dds for the next run
+                ImageData image;
+                if (Model::DecodeTexture(filename, image, 4)) {
+                    cooked = TextureCooker::Cook(image, options, support);
+                }
+                if (cooked) {
+                    TextureCooker::Write(cookedFilename, *cooked, options, sourceHash, sourceSize);
+                }
+            }
+            if (cooked) {
+                return [texture, cooked, options]() {
+                    TextureCooker::Upload(texture->GetID(), *cooked, options);
+                    texture->SetReady();
+                };
+            }
+        }
+
+        std::shared_ptr<ImageData> image = std::make_shared<ImageData>();
+        Model::DecodeTexture(filename, *image);
+        return [texture, image, options]() {
+            if (image->pixels) {
+                Model::UploadTexture(texture->GetID(), *image, options);
+            }
+            texture->SetReady();
+        };
+    });
+    return texture;
+}
+
+void AssetCache::QueueLoad(LoadJob job) {
+    if (!asyncLoading || ThreadPool::Shared().GetWorkerCount() == 0) {
+        std::function<void()> upload = job();
+        if (upload) upload();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(uploadMutex);
+        if (shuttingDown) return;
+        loadsQueued++;
+        loadsRunning++;
+    }
+
+    ThreadPool::Shared().Submit([this, job]() {
+        std::function<void()> upload = job();
+
+        // Block the loader while the queue is full so decoded data cannot pile up in memory
+        std::unique_lock<std::mutex> lock(uploadMutex);
+        uploadSpace.wait(lock, [this]() { return shuttingDown || uploads.size() < MAX_PENDING_UPLOADS; });
+        if (!shuttingDown) {
+            uploads.push_back(upload);
+        }
+        loadsRunning--;
+        loadsIdle.notify_all();
+    });
+}
+
+void AssetCache::ProcessUploads(double budgetMilliseconds) {
+    auto start = std::chrono::steady_clock::now();
+    for (;;) {
+        std::function<void()> upload;
+        {
+            std::lock_guard<std::mutex> lock(uploadMutex);
+            if (uploads.empty()) return;
+            upload = std::move(uploads.front());
+            uploads.pop_front();
+        }
+        uploadSpace.notify_one();
+
+        if (upload) upload();
+
+        {
+            std::lock_guard<std::mutex> lock(uploadMutex);
+            loadsFinished++;
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= budgetMilliseconds) return;
+    }
+}
+
+bool AssetCache::IsLoading() {
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    return loadsFinished < loadsQueued;
+}
+
+//Fraction of the loads queued so far whose upload has finished
+float AssetCache::GetLoadingProgress() {
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    return loadsQueued == 0 ? 1.0f : static_cast<float>(loadsFinished) / static_cast<float>(loadsQueued);
+}
+
+void AssetCache::Shutdown() {
+    std::unique_lock<std::mutex> lock(uploadMutex);
+    shuttingDown = true;
+    uploads.clear();
+    loadsQueued = loadsFinished;
+    uploadSpace.notify_all();
+    loadsIdle.wait(lock, [this]() { return loadsRunning == 0; });
+}
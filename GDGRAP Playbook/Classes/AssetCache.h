@@ -0,0 +1,88 @@
+// AssetCache.h
+
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+#include <glad/glad.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Mesh.h"
+#include "Texture.h"
+
+// Options that change the imported mesh, so they are part of the cache key
+struct MeshImportOptions {
+    bool generateTangents = true;
+    bool generateLODs = true;       // appends simplified index lists, see MeshSimplifier
+    // Applied to every texture coordinate after import as uv * xy + zw; a TextureAtlas uses it to point the
+    // mesh at its image's place in the atlas
+    glm::vec4 uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+
+    bool TransformsUVs() const { return uvTransform != glm::vec4(1.0f, 1.0f, 0.0f, 0.0f); }
+};
+
+// Options that change the uploaded texture, so they are part of the cache key
+struct TextureImportOptions {
+    bool generateMipmaps = true;
+    int mipLevels = 0;              // levels kept when generating mipmaps, counting the base; 0 for the full chain
+    bool normalMap = false;
+    GLint wrapMode = GL_REPEAT;
+    TextureCompression compression = TEXTURE_COMPRESSION_AUTO;
+};
+
+// Work run on a loader thread. It must not touch GL; it returns the upload to run later on the render thread.
+typedef std::function<std::function<void()>()> LoadJob;
+
+// Hands out shared meshes and textures so identical files are only loaded and uploaded once.
+// The cache only keeps weak references; a resource is freed when the last Model using it is destroyed.
+//
+// With async loading enabled, Get* return placeholders straight away (an empty mesh, a 1x1 texture) and the
+// decoding runs on the shared ThreadPool. Finished loads wait in a bounded queue until the render thread
+// calls ProcessUploads, which fills the same Mesh/Texture objects in place.
+class AssetCache {
+public:
+    static AssetCache& Instance();
+    ~AssetCache();
+
+    void SetAsyncLoading(bool enabled) { asyncLoading = enabled; }
+    bool IsAsyncLoading() const { return asyncLoading; }
+
+    std::shared_ptr<Mesh> GetMesh(const std::string& filename, const MeshImportOptions& options = MeshImportOptions());
+    std::shared_ptr<Texture> GetTexture(const std::string& filename, const TextureImportOptions& options = TextureImportOptions());
+
+    // Runs the job on a loader thread and queues its upload, or runs both inline when async loading is off
+    void QueueLoad(LoadJob job);
+
+    // Render thread only: runs queued uploads until the time budget is spent (at least one per call)
+    void ProcessUploads(double budgetMilliseconds);
+
+    bool IsLoading();
+    float GetLoadingProgress();
+
+    // Drops pending uploads and waits for running loads; call while the GL context is still alive
+    void Shutdown();
+
+    size_t GetHitCount() const { return hits; }
+    size_t GetMissCount() const { return misses; }
+
+private:
+    AssetCache();
+
+    std::unordered_map<std::string, std::weak_ptr<Mesh>> meshes;
+    std::unordered_map<std::string, std::weak_ptr<Texture>> textures;
+    size_t hits, misses;
+
+    bool asyncLoading;
+    std::mutex uploadMutex;
+    std::condition_variable uploadSpace;
+    std::condition_variable loadsIdle;
+    std::deque<std::function<void()>> uploads;
+    size_t loadsQueued, loadsRunning, loadsFinished;
+    bool shuttingDown;
+};
+
+#endif
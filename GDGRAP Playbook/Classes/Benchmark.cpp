@@ -0,0 +1,332 @@
+#include "Benchmark.h"
+#include "FrustumCuller.h"
+#include "MeshSimplifier.h"
+#include "ClusteredLights.h"
+#include "Model.h"
+#include "RenderQueue.h"
+#include "SceneBVH.h"
+#include "MappedFile.h"
+#include "ObjParser.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+
+// Each measurement keeps the best of this many runs
+static const int BENCHMARK_RUNS = 5;
+
+//Returns the fastest wall-clock time of the given function, in seconds
+static double BestTime(const std::function<bool()>& run, bool& ok) {
+    double best = 1e30;
+    ok = true;
+    for (int i = 0; i < BENCHMARK_RUNS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        ok = run() && ok;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+void RunObjParseBenchmark(const std::string& filename) {
+    size_t fileSize;
+    {
+        MappedFile file(filename);
+        if (!file.IsOpen()) {
+            std::cout << "Failed to open OBJ: " << filename << std::endl;
+            return;
+        }
+        fileSize = file.GetSize();
+    }
+    double megabytes = fileSize / (1024.0 * 1024.0);
+    std::printf("OBJ parse benchmark: %s (%.2f MB, best of %d)\n", filename.c_str(), megabytes, BENCHMARK_RUNS);
+
+    bool ok;
+    size_t triangleCount = 0;
+    double seconds = BestTime([&]() {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+        bool loaded = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str());
+        triangleCount = 0;
+        for (const auto& shape : shapes) triangleCount += shape.mesh.indices.size() / 3;
+        return loaded;
+    }, ok);
+    std::printf("  tinyobj::LoadObj      %8.2f ms %8.1f MB/s  %zu triangles%s\n", seconds * 1000.0, megabytes / seconds, triangleCount, ok ? "" : "  (failed)");
+    double baseline = seconds;
+
+    const size_t threadCounts[] = { 1, 2, 4, 8 };
+    for (size_t threads : threadCounts) {
+        ThreadPool pool(threads - 1);
+        seconds = BestTime([&]() {
+            tinyobj::attrib_t attrib;
+            std::vector<tinyobj::shape_t> shapes;
+            std::string err;
+            bool loaded = LoadObjParallel(filename, pool, attrib, shapes, err);
+            triangleCount = loaded ? shapes[0].mesh.indices.size() / 3 : 0;
+            return loaded;
+        }, ok);
+        std::printf("  LoadObjParallel x%zu    %8.2f ms %8.1f MB/s  %zu triangles  %.2fx%s\n", threads, seconds * 1000.0, megabytes / seconds, triangleCount, baseline / seconds, ok ? "" : "  (failed)");
+    }
+}
+
+void RunCullingBenchmark(size_t objectCount) {
+    // Boxes of 0.5-4 units scattered through a 1000-unit cube around a camera with the game's field of view
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.25f, 2.0f);
+
+    FrustumCuller culler;
+    for (size_t i = 0; i < objectCount; i++) {
+        glm::vec3 center(position(random), position(random), position(random));
+        glm::vec3 extents(size(random), size(random), size(random));
+        culler.Add(BoundingBox(center - extents, center + extents));
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::FromMatrix(projection * view);
+
+    std::printf("Frustum culling benchmark: %zu boxes (best of %d)\n", objectCount, BENCHMARK_RUNS);
+
+    const CullingKernel kernels[] = { CULLING_KERNEL_SCALAR, CULLING_KERNEL_SSE, CULLING_KERNEL_AVX };
+    double baseline = 0.0;
+    size_t baselineVisible = 0;
+    for (CullingKernel kernel : kernels) {
+        if (!FrustumCuller::IsKernelSupported(kernel)) {
+            std::printf("  %-8s  not supported\n", FrustumCuller::GetKernelName(kernel));
+            continue;
+        }
+
+        bool ok;
+        size_t visible = 0;
+        double seconds = BestTime([&]() {
+            visible = culler.Cull(frustum, kernel);
+            return true;
+        }, ok);
+        if (kernel == CULLING_KERNEL_SCALAR) {
+            baseline = seconds;
+            baselineVisible = visible;
+        }
+        std::printf("  %-8s  %8.3f ms %8.1f M boxes/s  %zu visible  %.2fx%s\n", FrustumCuller::GetKernelName(kernel), seconds * 1000.0,
+            objectCount / seconds / 1e6, visible, baseline / seconds, visible == baselineVisible ? "" : "  (mismatch)");
+    }
+}
+
+//Brute-force closest hit over every triangle (Moller-Trumbore, double sided), used to check the BVH
+static float ClosestTriangleHit(const std::vector<glm::vec3>& corners, const glm::vec3& origin, const glm::vec3& direction, float maxDistance) {
+    float closest = maxDistance;
+    for (size_t t = 0; t + 2 < corners.size(); t += 3) {
+        glm::vec3 edge1 = corners[t + 1] - corners[t];
+        glm::vec3 edge2 = corners[t + 2] - corners[t];
+        glm::vec3 p = glm::cross(direction, edge2);
+        float determinant = glm::dot(edge1, p);
+        if (std::fabs(determinant) < 1e-12f) continue;
+
+        glm::vec3 s = origin - corners[t];
+        float u = glm::dot(s, p) / determinant;
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = glm::dot(direction, q) / determinant;
+        float distance = glm::dot(edge2, q) / determinant;
+        if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance >= 0.0f && distance < closest) closest = distance;
+    }
+    return closest;
+}
+
+void RunBVHBenchmark(size_t objectCount) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.25f, 2.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<BoundingBox> boxes(objectCount);
+    std::vector<glm::vec3> corners(objectCount * 3);
+    for (size_t i = 0; i < objectCount; i++) {
+        glm::vec3 center(position(random), position(random), position(random));
+        glm::vec3 extents(size(random), size(random), size(random));
+        boxes[i] = BoundingBox(center - extents, center + extents);
+        for (int c = 0; c < 3; c++) {
+            corners[3 * i + c] = center + glm::vec3(unit(random), unit(random), unit(random)) * 2.0f;
+        }
+    }
+
+    std::printf("BVH benchmark: %zu boxes, %zu triangles (best of %d)\n", objectCount, objectCount, BENCHMARK_RUNS);
+
+    bool ok;
+    SceneBVH boxBVH, triangleBVH;
+    ThreadPool serialPool(0);
+    double serialSeconds = BestTime([&]() { boxBVH.BuildBoxes(boxes, serialPool); return boxBVH.IsBuilt(); }, ok);
+    double parallelSeconds = BestTime([&]() { boxBVH.BuildBoxes(boxes); return boxBVH.IsBuilt(); }, ok);
+    std::printf("  build boxes          %8.2f ms x1, %8.2f ms x%zu (%.2fx)  %zu nodes\n", serialSeconds * 1000.0, parallelSeconds * 1000.0,
+        ThreadPool::Shared().GetWorkerCount() + 1, serialSeconds / parallelSeconds, boxBVH.GetNodeCount());
+    serialSeconds = BestTime([&]() { triangleBVH.BuildTriangles(corners, serialPool); return triangleBVH.IsBuilt(); }, ok);
+    parallelSeconds = BestTime([&]() { triangleBVH.BuildTriangles(corners); return triangleBVH.IsBuilt(); }, ok);
+    std::printf("  build triangles      %8.2f ms x1, %8.2f ms x%zu (%.2fx)  %zu nodes\n", serialSeconds * 1000.0, parallelSeconds * 1000.0,
+        ThreadPool::Shared().GetWorkerCount() + 1, serialSeconds / parallelSeconds, triangleBVH.GetNodeCount());
+
+    const std::string filename = "bvh_benchmark.bvh";
+    double saveSeconds = BestTime([&]() { return triangleBVH.Save(filename, 1); }, ok);
+    SceneBVH loaded;
+    double loadSeconds = BestTime([&]() { return loaded.Load(filename, 1); }, ok);
+    std::printf("  save / load          %8.2f ms / %.2f ms%s\n", saveSeconds * 1000.0, loadSeconds * 1000.0, ok ? "" : "  (failed)");
+    std::remove(filename.c_str());
+
+    // Frustum queries from the origin in random directions, checked against the linear culler
+    const int frustumCount = 256;
+    std::vector<Frustum> frustums(frustumCount);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+    for (Frustum& frustum : frustums) {
+        glm::vec3 forward = glm::normalize(glm::vec3(unit(random), unit(random) * 0.5f, unit(random)));
+        frustum = Frustum::FromMatrix(projection * glm::lookAt(glm::vec3(0.0f), forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+    FrustumCuller culler;
+    for (const BoundingBox& box : boxes) culler.Add(box);
+
+    std::vector<uint32_t> visible;
+    size_t bvhVisible = 0, linearVisible = 0;
+    double bvhSeconds = BestTime([&]() {
+        bvhVisible = 0;
+        for (const Frustum& frustum : frustums) {
+            visible.clear();
+            boxBVH.CullFrustum(frustum, visible);
+            bvhVisible += visible.size();
+        }
+        return true;
+    }, ok);
+    double linearSeconds = BestTime([&]() {
+        linearVisible = 0;
+        for (const Frustum& frustum : frustums) linearVisible += culler.Cull(frustum);
+        return true;
+    }, ok);
+    std::printf("  frustum queries      %8.0f /s BVH, %8.0f /s linear %s  %zu visible%s\n", frustumCount / bvhSeconds, frustumCount / linearSeconds,
+        FrustumCuller::GetKernelName(FrustumCuller::GetBestKernel()), bvhVisible, bvhVisible == linearVisible ? "" : "  (mismatch)");
+
+    // Rays from random points in random directions; the first few are checked against a brute-force loop
+    const size_t rayCount = 100000;
+    std::vector<glm::vec3> origins(rayCount), directions(rayCount);
+    for (size_t i = 0; i < rayCount; i++) {
+        origins[i] = glm::vec3(position(random), position(random), position(random));
+        directions[i] = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 1e-4f));
+    }
+    size_t hits = 0;
+    double raySeconds = BestTime([&]() {
+        hits = 0;
+        RayHit hit;
+        for (size_t i = 0; i < rayCount; i++) {
+            if (triangleBVH.Raycast(origins[i], directions[i], 1000.0f, hit)) hits++;
+        }
+        return true;
+    }, ok);
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < 64; i++) {
+        RayHit hit;
+        bool found = triangleBVH.Raycast(origins[i], directions[i], 1000.0f, hit);
+        float reference = ClosestTriangleHit(corners, origins[i], directions[i], 1000.0f);
+        if (found != (reference < 1000.0f) || (found && std::fabs(hit.distance - reference) > 1e-3f)) mismatches++;
+    }
+    std::printf("  raycasts             %8.0f /s  %zu of %zu hit%s\n", rayCount / raySeconds, hits, rayCount, mismatches ? "  (mismatch)" : "");
+}
+
+void RunLODBenchmark(const std::string& filename, size_t gridSize) {
+    MeshImportOptions options;
+    options.generateLODs = false;
+    MeshData source;
+    Model::LoadModel(filename, options, source);
+    if (source.indices.empty()) {
+        std::cout << "Failed to load: " << filename << std::endl;
+        return;
+    }
+
+    bool ok;
+    MeshData data;
+    double seconds = BestTime([&]() {
+        data = source;
+        MeshSimplifier::BuildLODs(data);
+        return true;
+    }, ok);
+
+    std::printf("LOD benchmark: %s, %zu vertices (best of %d)\n", filename.c_str(), data.vertices.size(), BENCHMARK_RUNS);
+    std::printf("  simplify             %8.3f ms\n", seconds * 1000.0);
+    for (size_t level = 0; level < data.lods.size(); level++) {
+        size_t triangles = data.lods[level].indexCount / 3;
+        std::printf("  LOD %zu                %8zu triangles  %5.1f%%\n", level, triangles, 100.0 * triangles / data.lods[0].indexCount * 3);
+    }
+
+    // The grid recedes from a camera at the game's field of view, with a model radius of space between models
+    float spacing = 3.0f * data.bounds.sphere.radius;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    glm::vec3 eye(0.0f, spacing, 0.0f);
+    glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(0.0f, -0.2f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    RenderQueue queue;
+    queue.Begin(eye, view, projection);
+    Frustum frustum = Frustum::FromMatrix(projection * view);
+
+    size_t visible = 0, fullTriangles = 0, lodTriangles = 0, impostorTriangles = 0, impostors = 0;
+    size_t levelCounts[MAX_MESH_LODS] = {};
+    int lodCount = static_cast<int>(data.lods.size());
+    for (size_t row = 0; row < gridSize; row++) {
+        for (size_t column = 0; column < gridSize; column++) {
+            glm::vec3 offset((column - gridSize * 0.5f) * spacing, 0.0f, -(row + 1.0f) * spacing);
+            BoundingSphere sphere = data.bounds.sphere.Transform(glm::translate(glm::mat4(1.0f), offset));
+            if (!frustum.Intersects(sphere)) continue;
+
+            float screenSize = queue.GetScreenSize(sphere);
+            int level = Model::SelectLOD(screenSize, 0, lodCount);
+            visible++;
+            levelCounts[level]++;
+            fullTriangles += data.lods[0].indexCount / 3;
+            lodTriangles += data.lods[level].indexCount / 3;
+
+            // An impostor quad is two triangles
+            int impostorLevel = Model::SelectLOD(screenSize, 0, lodCount, true);
+            if (impostorLevel == lodCount) impostors++;
+            impostorTriangles += impostorLevel == lodCount ? 2 : data.lods[impostorLevel].indexCount / 3;
+        }
+    }
+    std::printf("  %zux%zu grid          %8zu in view, %zu/%zu/%zu/%zu per LOD\n", gridSize, gridSize, visible,
+        levelCounts[0], levelCounts[1], levelCounts[2], levelCounts[3]);
+    std::printf("  triangles per frame  %8zu without LOD, %zu with (%.1fx fewer)\n", fullTriangles, lodTriangles,
+        lodTriangles ? double(fullTriangles) / lodTriangles : 0.0);
+    std::printf("  with impostors       %8zu triangles (%.1fx fewer), %zu drawn as impostors\n", impostorTriangles,
+        impostorTriangles ? double(fullTriangles) / impostorTriangles : 0.0, impostors);
+}
+
+void RunClusterBenchmark(size_t maxLights) {
+    // Streetlight-sized lights scattered over a 20 x 300 unit strip ahead of a camera at the game's field of view
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> across(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> along(-300.0f, 0.0f);
+    std::vector<PointLight> lights;
+    for (size_t i = 0; i < maxLights; i++) {
+        lights.push_back(PointLight(glm::vec3(across(random), 5.0f, along(random)), glm::vec3(1.0f), 20.0f, 12.0f));
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 2.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    ThreadPool singleThread(0);
+    ClusteredLights clusters;
+
+    std::printf("Clustered lighting benchmark: %dx%dx%d clusters (best of %d)\n", CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, BENCHMARK_RUNS);
+    for (size_t count = 1; count <= maxLights; count *= 8) {
+        std::vector<PointLight> subset(lights.begin(), lights.begin() + count);
+        bool ok;
+        double oneThread = BestTime([&]() {
+            clusters.Assign(subset, view, projection, 1920, 1080, singleThread);
+            return true;
+        }, ok);
+        double pooled = BestTime([&]() {
+            clusters.Assign(subset, view, projection, 1920, 1080);
+            return true;
+        }, ok);
+        std::printf("  %4zu lights  %8.3f ms 1 thread  %8.3f ms pool  %4zu in view  %6zu indices  %3zu max per cluster\n", count,
+            oneThread * 1000.0, pooled * 1000.0, clusters.GetLightCount(), clusters.GetIndexCount(), clusters.GetMaxClusterLights());
+        if (count < maxLights && count * 8 > maxLights) count = maxLights / 8;
+    }
+}
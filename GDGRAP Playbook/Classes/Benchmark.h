@@ -0,0 +1,31 @@
+// Benchmark.h
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstddef>
+#include <string>
+
+// Command-line benchmarks, run from main() before any window is created
+
+// Reports OBJ parse throughput in MB/s for tinyobj::LoadObj and for LoadObjParallel with 1, 2, 4 and 8 threads
+void RunObjParseBenchmark(const std::string& filename);
+
+// Reports frustum-culling throughput in boxes/s for each culling kernel the CPU supports,
+// over objectCount random boxes scattered around the camera
+void RunCullingBenchmark(size_t objectCount);
+
+// Reports SceneBVH build time (one thread and the shared pool), save/load time, frustum queries/s over
+// objectCount boxes and raycasts/s over objectCount triangles
+void RunBVHBenchmark(size_t objectCount);
+
+// Reports how long MeshSimplifier takes to build the LODs of an OBJ and the triangles of each level, then
+// how many triangles a gridSize x gridSize grid of the model costs in view without LODs, with LODs, and with
+// LODs plus impostors
+void RunLODBenchmark(const std::string& filename, size_t gridSize);
+
+// Reports how long ClusteredLights takes to bin 1 to maxLights random lights along a track in front of the
+// camera, on one thread and on the shared pool, and how many lights the busiest cluster ends up with
+void RunClusterBenchmark(size_t maxLights);
+
+#endif
@@ -0,0 +1,66 @@
+// Bounds.h
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+#include <cfloat>
+#include <cmath>
+
+// Axis-aligned box; a default-constructed box is empty (min > max) until something is added to it
+struct BoundingBox {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    BoundingBox() : min(FLT_MAX), max(-FLT_MAX) {}
+    BoundingBox(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+    bool IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+    glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+    glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+
+    void Expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Expand(const BoundingBox& box) {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    // Smallest axis-aligned box around this box after an affine transform
+    BoundingBox Transform(const glm::mat4& matrix) const {
+        if (IsEmpty()) return *this;
+        glm::vec3 center = glm::vec3(matrix * glm::vec4(GetCenter(), 1.0f));
+        glm::vec3 extents = GetExtents();
+        glm::vec3 radius(0.0f);
+        for (int column = 0; column < 3; column++) {
+            radius += glm::abs(glm::vec3(matrix[column])) * extents[column];
+        }
+        return BoundingBox(center - radius, center + radius);
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = -1.0f;    // negative for an empty sphere
+
+    // Sphere around this sphere after an affine transform; non-uniform scales use the largest axis
+    BoundingSphere Transform(const glm::mat4& matrix) const {
+        BoundingSphere sphere;
+        sphere.center = glm::vec3(matrix * glm::vec4(center, 1.0f));
+        float scale = std::sqrt(glm::max(glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0])),
+            glm::max(glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1])), glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2])))));
+        sphere.radius = radius < 0.0f ? radius : radius * scale;
+        return sphere;
+    }
+};
+
+// Model-space bounds of a mesh, computed once by the importer
+struct MeshBounds {
+    BoundingBox box;
+    BoundingSphere sphere;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include "CascadedShadowMap.h"
+#include "GLState.h"
+#include "StreamBuffer.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Constant depth bias applied in sample.frag, in shadow-map depth units; the polygon offset below
+// handles the slope-dependent part while the casters are drawn
+static const float SHADOW_DEPTH_BIAS = 0.0005f;
+static const GLfloat SHADOW_POLYGON_OFFSET_FACTOR = 2.0f;
+static const GLfloat SHADOW_POLYGON_OFFSET_UNITS = 4.0f;
+
+CascadedShadowMap::CascadedShadowMap(const ShadowSettings& settings) :
+    settings(settings), depthTexture(0), framebuffer(0), constantBuffer(0), constants(),
+    depthProgram(0), lightViewProjectionUniform(-1), drawCount(0) {
+    this->settings.cascadeCount = std::min(std::max(settings.cascadeCount, 1), MAX_SHADOW_CASCADES);
+    this->settings.resolution = std::max(settings.resolution, 16);
+    for (glm::mat4& matrix : lightViewProjections) matrix = glm::mat4(1.0f);
+
+    // One layer per cascade, compared in hardware: sampler2DArrayShadow returns the lit fraction of a
+    // 2x2 footprint with linear filtering
+    glGenTextures(1, &depthTexture);
+    GLState::BindTexture(SHADOW_MAP_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, depthTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, this->settings.resolution, this->settings.resolution,
+        this->settings.cascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Shadow map framebuffer is incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Zero cascades in the block until the first Update, so sample.frag treats everything as lit. Update
+    // streams the block every frame; this buffer only backs that initial state and Disable
+    glGenBuffers(1, &constantBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, constantBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowConstants), &constants, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SHADOW_CONSTANTS_BINDING, constantBuffer);
+}
+
+CascadedShadowMap::~CascadedShadowMap() {
+    GLState::ForgetTexture(depthTexture);
+    glDeleteTextures(1, &depthTexture);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteBuffers(1, &constantBuffer);
+}
+
+//Splits the view depth range between the cascades (Zhang's practical split scheme), then fits an
+//orthographic light view around each slice's bounding sphere and snaps it to the shadow-map texels
+void CascadedShadowMap::Update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& lightDirection) {
+    // Near and far planes of the perspective projection
+    float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+    float shadowFar = std::min(farPlane, settings.maxDistance);
+
+    // World-space corners of the whole frustum; a slice's corners lie on the same edges, linear in view depth
+    glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+    glm::vec3 nearCorners[4], farCorners[4];
+    for (int i = 0; i < 4; i++) {
+        glm::vec2 ndc((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f);
+        glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+        glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+        nearCorners[i] = glm::vec3(nearPoint) / nearPoint.w;
+        farCorners[i] = glm::vec3(farPoint) / farPoint.w;
+    }
+
+    glm::vec3 direction = glm::normalize(lightDirection);
+    glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    float resolution = static_cast<float>(settings.resolution);
+    const glm::mat4 textureSpace = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+
+    int count = settings.cascadeCount;
+    float sliceNear = nearPlane;
+    for (int cascade = 0; cascade < count; cascade++) {
+        float fraction = float(cascade + 1) / count;
+        float logSplit = nearPlane * std::pow(shadowFar / nearPlane, fraction);
+        float uniformSplit = nearPlane + (shadowFar - nearPlane) * fraction;
+        float sliceFar = settings.splitLambda * logSplit + (1.0f - settings.splitLambda) * uniformSplit;
+
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int i = 0; i < 4; i++) {
+            glm::vec3 edge = farCorners[i] - nearCorners[i];
+            corners[i] = nearCorners[i] + edge * ((sliceNear - nearPlane) / (farPlane - nearPlane));
+            corners[i + 4] = nearCorners[i] + edge * ((sliceFar - nearPlane) / (farPlane - nearPlane));
+            center += corners[i] + corners[i + 4];
+        }
+        center /= 8.0f;
+
+        // A sphere keeps the cascade the same size however the camera turns; rounding the radius up
+        // stops float noise from changing the texel size frame to frame
+        float radius = 0.0f;
+        for (const glm::vec3& corner : corners) {
+            radius = std::max(radius, glm::length(corner - center));
+        }
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        glm::vec3 eye = center - direction * (radius + settings.casterDistance);
+        glm::mat4 lightView = glm::lookAt(eye, center, up);
+        glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + settings.casterDistance);
+
+        // Shift the projection so the world origin lands on a texel corner; the cascade then only ever
+        // moves in whole texels
+        glm::vec4 origin = lightProjection * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        glm::vec2 texelOrigin = glm::vec2(origin) * (resolution * 0.5f);
+        glm::vec2 offset = (glm::round(texelOrigin) - texelOrigin) * (2.0f / resolution);
+        lightProjection[3][0] += offset.x;
+        lightProjection[3][1] += offset.y;
+
+        lightViewProjections[cascade] = lightProjection * lightView;
+        constants.cascadeMatrices[cascade] = textureSpace * lightViewProjections[cascade];
+        constants.cascadeSplits[cascade] = sliceFar;
+        sliceNear = sliceFar;
+    }
+    constants.params = glm::vec4(static_cast<float>(count), 1.0f / resolution, SHADOW_DEPTH_BIAS, 0.0f);
+
+    StreamBuffer::Instance().WriteUniforms(SHADOW_CONSTANTS_BINDING, &constants, sizeof(ShadowConstants));
+}
+
+void CascadedShadowMap::Render(const std::vector<ShadowCaster>& casters, ShaderProgram& depthShader) {
+    drawCount = 0;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GLState::Viewport(0, 0, settings.resolution, settings.resolution);
+    GLState::SetDepthTest(true);
+    GLState::DepthFunc(GL_LESS);
+    GLState::DepthMask(true);
+    GLState::SetBlend(false);
+    GLState::SetPolygonOffsetFill(true);
+    GLState::PolygonOffset(SHADOW_POLYGON_OFFSET_FACTOR, SHADOW_POLYGON_OFFSET_UNITS);
+
+    depthShader.Use();
+    if (depthShader.GetID() != depthProgram) {
+        depthProgram = depthShader.GetID();
+        lightViewProjectionUniform = depthShader.FindUniform("lightViewProjection");
+    }
+
+    for (int cascade = 0; cascade < settings.cascadeCount; cascade++) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, cascade);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        if (casters.empty()) continue;
+
+        // The queue culls against the cascade's light frustum and sorts by distance from the center of its
+        // near plane, the side facing the light
+        const glm::mat4& lightViewProjection = lightViewProjections[cascade];
+        glm::vec4 nearCenter = glm::inverse(lightViewProjection) * glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
+        queue.Begin(glm::vec3(nearCenter) / nearCenter.w, lightViewProjection, glm::mat4(1.0f));
+        for (const ShadowCaster& caster : casters) {
+            InstanceData instance;
+            instance.model = caster.model;
+            instance.tint = glm::vec4(1.0f);
+            queue.Submit(depthShader, *caster.mesh, 0, 0, BLEND_OPAQUE, instance, caster.lod);
+        }
+
+        depthShader.SetMat4(lightViewProjectionUniform, lightViewProjection);
+        queue.Flush(RENDER_PASS_OPAQUE);
+        drawCount += queue.GetStats().draws;
+    }
+
+    GLState::SetPolygonOffsetFill(false);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void CascadedShadowMap::Bind(ShaderProgram& shader) const {
+    GLState::BindTexture(SHADOW_MAP_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, depthTexture);
+    shader.Use();
+    shader.SetInt(shader.GetMeshUniforms().shadowMap, static_cast<GLint>(SHADOW_MAP_TEXTURE_UNIT));
+}
+
+//Points the binding back at the static buffer; the next Update moves it onto the ring again
+void CascadedShadowMap::Disable() {
+    constants.params.x = 0.0f;
+    glBindBuffer(GL_UNIFORM_BUFFER, constantBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowConstants), &constants);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SHADOW_CONSTANTS_BINDING, constantBuffer);
+}
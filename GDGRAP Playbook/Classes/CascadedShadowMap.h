@@ -0,0 +1,90 @@
+// CascadedShadowMap.h
+
+#ifndef CASCADEDSHADOWMAP_H
+#define CASCADEDSHADOWMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Mesh.h"
+#include "ShaderProgram.h"
+#include "RenderQueue.h"
+
+// Uniform buffer binding point of the ShadowConstants block, next to FRAME_CONSTANTS_BINDING
+const GLuint SHADOW_CONSTANTS_BINDING = 1;
+// Texture unit the cascades are sampled from; units 0 and 1 hold a mesh's albedo and normal map
+const GLuint SHADOW_MAP_TEXTURE_UNIT = 2;
+// Upper bound of ShadowSettings::cascadeCount, fixed by the array sizes of the ShadowConstants block
+const int MAX_SHADOW_CASCADES = 4;
+
+// Laid out to match the std140 ShadowConstants block in sample.frag
+struct ShadowConstants {
+    glm::mat4 cascadeMatrices[MAX_SHADOW_CASCADES];    // world -> shadow map texture space [0, 1]
+    glm::vec4 cascadeSplits;                            // far view-space depth of each cascade
+    glm::vec4 params;                                   // cascade count, texel size, depth bias, unused
+};
+
+static_assert(sizeof(ShadowConstants) == MAX_SHADOW_CASCADES * 64 + 2 * 16, "ShadowConstants must match the std140 block");
+
+// Quality knobs; more cascades and texels cost shadow-pass time and memory
+struct ShadowSettings {
+    int cascadeCount = 4;           // 1 to MAX_SHADOW_CASCADES
+    int resolution = 2048;          // texels along each side of every cascade
+    float maxDistance = 100.0f;     // view depth the cascades cover, capped at the camera's far plane
+    float splitLambda = 0.75f;      // 0 spaces the splits evenly, 1 logarithmically
+    float casterDistance = 50.0f;   // how far towards the light casters outside a slice are still caught
+};
+
+// A mesh drawn into the shadow maps; lod picks a (usually coarser) level to save vertex work
+struct ShadowCaster {
+    Mesh* mesh;
+    glm::mat4 model;
+    int lod;
+};
+
+// Shadows of the directional light, split into cascades over slices of the camera frustum.
+//
+// Each cascade is an orthographic light view around the bounding sphere of its slice, so its size does not
+// change as the camera turns, and its origin is snapped to whole texels, so the edges do not shimmer as the
+// camera moves. The cascades are layers of one depth texture array sampled with hardware comparison;
+// sample.frag picks the layer per fragment from its view depth.
+class CascadedShadowMap {
+public:
+    explicit CascadedShadowMap(const ShadowSettings& settings = ShadowSettings());
+    ~CascadedShadowMap();
+
+    CascadedShadowMap(const CascadedShadowMap&) = delete;
+    CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+
+    // Fits the cascades to the camera (a perspective projection) and writes the ShadowConstants block to this frame's
+    // StreamBuffer region, so it must run every frame
+    void Update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& lightDirection);
+
+    // Queues the casters once per cascade with depthShader (Shaders/depth.vert and depth.frag), so each cascade
+    // culls them against its light frustum and draws the survivors as instanced multi-draws.
+    // Leaves framebuffer 0 bound; the caller restores the viewport.
+    void Render(const std::vector<ShadowCaster>& casters, ShaderProgram& depthShader);
+
+    // Binds the cascades to SHADOW_MAP_TEXTURE_UNIT and points the shader's shadowMap sampler at it
+    void Bind(ShaderProgram& shader) const;
+    // Marks every fragment as lit until the next Update, e.g. while baking impostors in model space
+    void Disable();
+
+    const ShadowSettings& GetSettings() const { return settings; }
+    // Caster packets drawn by the last Render, summed over the cascades
+    size_t GetDrawCount() const { return drawCount; }
+
+private:
+    ShadowSettings settings;
+    GLuint depthTexture, framebuffer, constantBuffer;
+    ShadowConstants constants;
+    glm::mat4 lightViewProjections[MAX_SHADOW_CASCADES];
+    // Reused by every cascade; casters are resubmitted after each Begin
+    RenderQueue queue;
+    // lightViewProjection's handle in the depth shader, looked up again only if another program is passed
+    GLuint depthProgram;
+    int lightViewProjectionUniform;
+    size_t drawCount;
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include "ClusteredLights.h"
+#include "GLState.h"
+#include "StreamBuffer.h"
+#include <algorithm>
+#include <cmath>
+
+// Slice 0 runs from the near plane to this depth and the exponential slices start behind it, so the
+// few centimetres in front of the camera do not take up half the slices
+static const float CLUSTER_FIRST_SLICE_DEPTH = 1.0f;
+
+// Texel formats of the light data, cluster grid and light index buffer textures, in that order
+static const GLenum CLUSTER_TEXTURE_FORMATS[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+static const GLuint CLUSTER_TEXTURE_UNITS[3] = { CLUSTER_LIGHT_DATA_TEXTURE_UNIT, CLUSTER_GRID_TEXTURE_UNIT, CLUSTER_LIGHT_INDEX_TEXTURE_UNIT };
+
+//Squared distance from a point to the nearest point of a box; zero inside it
+static float DistanceSquared(const BoundingBox& box, const glm::vec3& point) {
+    glm::vec3 outside = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.0f));
+    return glm::dot(outside, outside);
+}
+
+ClusteredLights::ClusteredLights() :
+    constants(), clusterProjection(0.0f), firstSliceDepth(CLUSTER_FIRST_SLICE_DEPTH), sliceScale(1.0f),
+    clusterBoxes(CLUSTER_COUNT), clusterGrid(CLUSTER_COUNT, glm::uvec2(0)), sliceIndices(CLUSTER_GRID_Z),
+    maxClusterLights(0), constantBuffer(0), buffers(), textures(), streamed(false), textureAlignment(16) {
+    constants.grid = glm::vec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, 0.0f);
+}
+
+ClusteredLights::~ClusteredLights() {
+    if (constantBuffer) {
+        for (GLuint texture : textures) GLState::ForgetTexture(texture);
+        glDeleteTextures(3, textures);
+        if (!streamed) glDeleteBuffers(3, buffers);
+        glDeleteBuffers(1, &constantBuffer);
+    }
+}
+
+//Fits the view-space box of every cluster; only reruns when the projection changes
+void ClusteredLights::BuildClusterBoxes(const glm::mat4& projection) {
+    clusterProjection = projection;
+    float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+    firstSliceDepth = std::min(std::max(CLUSTER_FIRST_SLICE_DEPTH, nearPlane), farPlane * 0.5f);
+    sliceScale = (CLUSTER_GRID_Z - 1) / std::log(farPlane / firstSliceDepth);
+
+    // View-space ray through each tile corner, scaled so that z = -1
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    std::vector<glm::vec3> rays((CLUSTER_GRID_X + 1) * (CLUSTER_GRID_Y + 1));
+    for (int y = 0; y <= CLUSTER_GRID_Y; y++) {
+        for (int x = 0; x <= CLUSTER_GRID_X; x++) {
+            glm::vec2 ndc(2.0f * x / CLUSTER_GRID_X - 1.0f, 2.0f * y / CLUSTER_GRID_Y - 1.0f);
+            glm::vec4 point = inverseProjection * glm::vec4(ndc, -1.0f, 1.0f);
+            glm::vec3 ray = glm::vec3(point) / point.w;
+            rays[y * (CLUSTER_GRID_X + 1) + x] = ray / -ray.z;
+        }
+    }
+
+    for (int slice = 0; slice < CLUSTER_GRID_Z; slice++) {
+        float sliceNear = slice == 0 ? nearPlane : firstSliceDepth * std::exp((slice - 1) / sliceScale);
+        float sliceFar = firstSliceDepth * std::exp(slice / sliceScale);
+        for (int y = 0; y < CLUSTER_GRID_Y; y++) {
+            for (int x = 0; x < CLUSTER_GRID_X; x++) {
+                BoundingBox box;
+                for (int corner = 0; corner < 4; corner++) {
+                    const glm::vec3& ray = rays[(y + (corner >> 1)) * (CLUSTER_GRID_X + 1) + x + (corner & 1)];
+                    box.Expand(ray * sliceNear);
+                    box.Expand(ray * sliceFar);
+                }
+                clusterBoxes[x + CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * slice)] = box;
+            }
+        }
+    }
+}
+
+//Projects each light to its cluster range, fills the slices in parallel, then joins their lists in order
+void ClusteredLights::Assign(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+    int width, int height, ThreadPool& pool) {
+    if (projection != clusterProjection) BuildClusterBoxes(projection);
+    float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+
+    auto sliceOf = [this](float depth) {
+        int slice = depth > firstSliceDepth ? 1 + static_cast<int>(std::log(depth / firstSliceDepth) * sliceScale) : 0;
+        return std::min(slice, CLUSTER_GRID_Z - 1);
+    };
+
+    lightBounds.clear();
+    lightData.clear();
+    size_t lightCount = std::min(lights.size(), static_cast<size_t>(MAX_CLUSTERED_LIGHTS));
+    for (size_t i = 0; i < lightCount; i++) {
+        const PointLight& light = lights[i];
+        if (!(light.range > 0.0f) || !(light.intensity > 0.0f)) continue;
+
+        LightBounds bounds;
+        bounds.center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        bounds.radius = light.range;
+        float minDepth = -bounds.center.z - bounds.radius;
+        float maxDepth = -bounds.center.z + bounds.radius;
+        if (maxDepth < nearPlane || minDepth > farPlane) continue;
+        bounds.minZ = sliceOf(std::max(minDepth, nearPlane));
+        bounds.maxZ = sliceOf(std::min(maxDepth, farPlane));
+
+        // The projected corners of the sphere's box bound its screen footprint, as long as the box stays
+        // in front of the near plane; otherwise it may cover any tile
+        bounds.minX = bounds.minY = 0;
+        bounds.maxX = CLUSTER_GRID_X - 1;
+        bounds.maxY = CLUSTER_GRID_Y - 1;
+        if (minDepth > nearPlane) {
+            glm::vec2 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+            for (int corner = 0; corner < 8; corner++) {
+                glm::vec3 offset((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+                glm::vec4 clip = projection * glm::vec4(bounds.center + offset * bounds.radius, 1.0f);
+                glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                ndcMin = glm::min(ndcMin, ndc);
+                ndcMax = glm::max(ndcMax, ndc);
+            }
+            if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f) continue;
+
+            glm::vec2 grid(CLUSTER_GRID_X, CLUSTER_GRID_Y);
+            glm::ivec2 minTile = glm::ivec2(glm::floor((ndcMin * 0.5f + 0.5f) * grid));
+            glm::ivec2 maxTile = glm::ivec2(glm::floor((ndcMax * 0.5f + 0.5f) * grid));
+            bounds.minX = std::max(minTile.x, 0);
+            bounds.minY = std::max(minTile.y, 0);
+            bounds.maxX = std::min(maxTile.x, CLUSTER_GRID_X - 1);
+            bounds.maxY = std::min(maxTile.y, CLUSTER_GRID_Y - 1);
+        }
+
+        lightBounds.push_back(bounds);
+        lightData.push_back(glm::vec4(light.position, light.range));
+        lightData.push_back(glm::vec4(light.color * light.intensity, 0.0f));
+    }
+
+    // Every slice writes only its own clusters and its own list, so the slices need no locking
+    pool.ParallelFor(CLUSTER_GRID_Z, 1, [this](size_t begin, size_t end) {
+        for (size_t slice = begin; slice < end; slice++) {
+            AssignSlice(static_cast<int>(slice));
+        }
+    });
+
+    lightIndices.clear();
+    maxClusterLights = 0;
+    for (int slice = 0; slice < CLUSTER_GRID_Z; slice++) {
+        GLuint base = static_cast<GLuint>(lightIndices.size());
+        for (int cluster = slice * CLUSTER_GRID_X * CLUSTER_GRID_Y; cluster < (slice + 1) * CLUSTER_GRID_X * CLUSTER_GRID_Y; cluster++) {
+            clusterGrid[cluster].x += base;
+            maxClusterLights = std::max(maxClusterLights, static_cast<size_t>(clusterGrid[cluster].y));
+        }
+        lightIndices.insert(lightIndices.end(), sliceIndices[slice].begin(), sliceIndices[slice].end());
+    }
+
+    constants.grid.w = static_cast<float>(GetLightCount());
+    constants.depth = glm::vec4(firstSliceDepth, sliceScale, 0.0f, 0.0f);
+    constants.screen = glm::vec4(1.0f / std::max(width, 1), 1.0f / std::max(height, 1), 0.0f, 0.0f);
+}
+
+//Lists, for each cluster of one depth slice, the lights whose sphere touches its box; offsets are
+//relative to the slice's own list until Assign joins them
+void ClusteredLights::AssignSlice(int slice) {
+    std::vector<uint16_t>& indices = sliceIndices[slice];
+    indices.clear();
+
+    uint16_t candidates[MAX_CLUSTERED_LIGHTS];
+    int candidateCount = 0;
+    for (size_t i = 0; i < lightBounds.size(); i++) {
+        if (lightBounds[i].minZ <= slice && slice <= lightBounds[i].maxZ) candidates[candidateCount++] = static_cast<uint16_t>(i);
+    }
+
+    for (int y = 0; y < CLUSTER_GRID_Y; y++) {
+        for (int x = 0; x < CLUSTER_GRID_X; x++) {
+            int cluster = x + CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * slice);
+            const BoundingBox& box = clusterBoxes[cluster];
+            size_t first = indices.size();
+            for (int i = 0; i < candidateCount; i++) {
+                const LightBounds& light = lightBounds[candidates[i]];
+                if (x < light.minX || x > light.maxX || y < light.minY || y > light.maxY) continue;
+                if (DistanceSquared(box, light.center) > light.radius * light.radius) continue;
+                indices.push_back(candidates[i]);
+            }
+            clusterGrid[cluster] = glm::uvec2(static_cast<GLuint>(first), static_cast<GLuint>(indices.size() - first));
+        }
+    }
+}
+
+void ClusteredLights::CreateBuffers() {
+    glGenBuffers(1, &constantBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, constantBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterConstants), &constants, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // Streamed textures get their storage on the first Upload
+    glGenTextures(3, textures);
+    streamed = GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_texture_buffer_range;
+    if (streamed) {
+        glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &textureAlignment);
+        return;
+    }
+
+    glGenBuffers(3, buffers);
+    for (int i = 0; i < 3; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        GLState::BindTexture(CLUSTER_TEXTURE_UNITS[i], GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, CLUSTER_TEXTURE_FORMATS[i], buffers[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+//Writes the arrays and the block to this frame's region of the ring and repoints the textures and the binding,
+//which is needed every frame since the offsets move. Empty arrays still get one zero texel, as a buffer
+//texture range cannot be empty.
+void ClusteredLights::Upload() {
+    if (!constantBuffer) CreateBuffers();
+
+    static const glm::vec4 EMPTY_TEXEL(0.0f);
+    const void* data[3] = { lightData.data(), clusterGrid.data(), lightIndices.data() };
+    size_t sizes[3] = { lightData.size() * sizeof(glm::vec4), clusterGrid.size() * sizeof(glm::uvec2), lightIndices.size() * sizeof(uint16_t) };
+    StreamBuffer& stream = StreamBuffer::Instance();
+    for (int i = 0; i < 3; i++) {
+        if (sizes[i] == 0) {
+            data[i] = &EMPTY_TEXEL;
+            sizes[i] = sizeof(EMPTY_TEXEL);
+        }
+        if (streamed) {
+            GLintptr offset = stream.Write(data[i], sizes[i], textureAlignment);
+            GLState::BindTexture(CLUSTER_TEXTURE_UNITS[i], GL_TEXTURE_BUFFER, textures[i]);
+            glTexBufferRange(GL_TEXTURE_BUFFER, CLUSTER_TEXTURE_FORMATS[i], stream.GetBuffer(), offset, sizes[i]);
+        }
+        else {
+            // Respecified whole, so the driver can hand out fresh storage instead of waiting on the last frame
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    stream.WriteUniforms(CLUSTER_CONSTANTS_BINDING, &constants, sizeof(ClusterConstants));
+}
+
+void ClusteredLights::Bind(ShaderProgram& shader) const {
+    for (int i = 0; i < 3; i++) {
+        GLState::BindTexture(CLUSTER_TEXTURE_UNITS[i], GL_TEXTURE_BUFFER, textures[i]);
+    }
+    const ShaderProgram::MeshUniforms& uniforms = shader.GetMeshUniforms();
+    shader.Use();
+    shader.SetInt(uniforms.lightData, static_cast<GLint>(CLUSTER_LIGHT_DATA_TEXTURE_UNIT));
+    shader.SetInt(uniforms.clusterGrid, static_cast<GLint>(CLUSTER_GRID_TEXTURE_UNIT));
+    shader.SetInt(uniforms.lightIndices, static_cast<GLint>(CLUSTER_LIGHT_INDEX_TEXTURE_UNIT));
+}
+
+void ClusteredLights::Disable() {
+    if (!constantBuffer) CreateBuffers();
+
+    // With no lights in the block the shader never reads the textures, so they can keep last frame's ranges
+    ClusterConstants disabled = constants;
+    disabled.grid.w = 0.0f;
+    glBindBuffer(GL_UNIFORM_BUFFER, constantBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ClusterConstants), &disabled);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CLUSTER_CONSTANTS_BINDING, constantBuffer);
+}
@@ -0,0 +1,112 @@
+// ClusteredLights.h
+
+#ifndef CLUSTEREDLIGHTS_H
+#define CLUSTEREDLIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "Light.h"
+#include "Bounds.h"
+#include "ShaderProgram.h"
+#include "ThreadPool.h"
+
+// Uniform buffer binding point of the ClusterConstants block, after SHADOW_CONSTANTS_BINDING
+const GLuint CLUSTER_CONSTANTS_BINDING = 2;
+// Texture units of the three buffer textures sample.frag reads, after SHADOW_MAP_TEXTURE_UNIT
+const GLuint CLUSTER_LIGHT_DATA_TEXTURE_UNIT = 3;
+const GLuint CLUSTER_GRID_TEXTURE_UNIT = 4;
+const GLuint CLUSTER_LIGHT_INDEX_TEXTURE_UNIT = 5;
+
+// Clusters across the screen, down it, and into it (exponential depth slices)
+const int CLUSTER_GRID_X = 16;
+const int CLUSTER_GRID_Y = 9;
+const int CLUSTER_GRID_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+// Lights past this many are ignored; indices are stored as 16-bit texels
+const int MAX_CLUSTERED_LIGHTS = 512;
+
+// Laid out to match the std140 ClusterConstants block in sample.frag
+struct ClusterConstants {
+    glm::vec4 grid;         // cluster counts along x, y and z, light count
+    glm::vec4 depth;        // view depth where slice 1 starts, slices per unit of log depth
+    glm::vec4 screen;       // 1 / viewport width, 1 / viewport height
+};
+
+static_assert(sizeof(ClusterConstants) == 3 * 16, "ClusterConstants must match the std140 block");
+
+// Point lights for clustered forward shading.
+//
+// The view frustum is cut into CLUSTER_GRID_X x CLUSTER_GRID_Y screen tiles and CLUSTER_GRID_Z slices
+// whose depth grows exponentially, and every cluster gets the list of lights whose range reaches its
+// view-space box. sample.frag finds its cluster from gl_FragCoord and its view depth and loops over that
+// list only, so a fragment pays for the few lights around it rather than every light in the scene.
+//
+// Assign does the CPU work and never touches GL: each light's sphere is projected to a conservative range of
+// clusters, then the depth slices are filled in parallel on the thread pool with an exact sphere-box test.
+// Upload sends three buffer textures (GLSL 330 has no storage buffers):
+//   light data     RGBA32F, two texels per light: position and range, color times intensity
+//   cluster grid   RG32UI, one texel per cluster: first index and light count
+//   light indices  R16UI, the clusters' lists back to back
+// The arrays and the ClusterConstants block are written to the StreamBuffer ring every frame and the
+// textures pointed at their ranges with glTexBufferRange. Without GL 4.3 or ARB_texture_buffer_range the
+// arrays go to buffers of their own that are orphaned every Upload instead. Disable binds a static copy of
+// the block, so it holds until the next Upload. The GL objects are created on the first Upload or Disable.
+class ClusteredLights {
+public:
+    ClusteredLights();
+    ~ClusteredLights();
+
+    ClusteredLights(const ClusteredLights&) = delete;
+    ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+    // Bins the lights into the clusters of a perspective camera with a viewport of width x height pixels
+    void Assign(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+        int width, int height, ThreadPool& pool = ThreadPool::Shared());
+    // Sends the last Assign's lights, grid and index lists to the GPU
+    void Upload();
+
+    // Binds the buffer textures to their units and points the shader's samplers at them
+    void Bind(ShaderProgram& shader) const;
+    // Leaves every fragment unlit by point lights until the next Upload, e.g. while baking impostors
+    void Disable();
+
+    size_t GetLightCount() const { return lightData.size() / 2; }
+    // Entries over all the clusters' lists; a light counts once per cluster it reaches
+    size_t GetIndexCount() const { return lightIndices.size(); }
+    // Longest list of the last Assign, i.e. the most lights any fragment loops over
+    size_t GetMaxClusterLights() const { return maxClusterLights; }
+
+private:
+    // View-space sphere of a light and the conservative range of clusters it can reach
+    struct LightBounds {
+        glm::vec3 center;
+        float radius;
+        int minX, maxX, minY, maxY, minZ, maxZ;
+    };
+
+    void BuildClusterBoxes(const glm::mat4& projection);
+    void AssignSlice(int slice);
+    void CreateBuffers();
+
+    ClusterConstants constants;
+    glm::mat4 clusterProjection;
+    float firstSliceDepth, sliceScale;
+    std::vector<BoundingBox> clusterBoxes;
+
+    std::vector<LightBounds> lightBounds;
+    std::vector<glm::vec4> lightData;
+    std::vector<glm::uvec2> clusterGrid;
+    std::vector<std::vector<uint16_t>> sliceIndices;
+    std::vector<uint16_t> lightIndices;
+    size_t maxClusterLights;
+
+    GLuint constantBuffer;          // only read while disabled
+    GLuint buffers[3];              // only used without glTexBufferRange
+    GLuint textures[3];
+    bool streamed;                  // the textures read ranges of the StreamBuffer
+    GLint textureAlignment;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "FragmentCounter.h"
+
+FragmentCounter::FragmentCounter() : queries(), pending(), current(0), lastCount(0) {
+    supported = GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_pipeline_statistics_query;
+    if (supported) glGenQueries(QUERY_COUNT, queries);
+}
+
+FragmentCounter::~FragmentCounter() {
+    if (supported) glDeleteQueries(QUERY_COUNT, queries);
+}
+
+//Collects the result this query held from QUERY_COUNT frames ago, then reuses it for this frame
+void FragmentCounter::Begin() {
+    if (!supported) return;
+
+    if (pending[current]) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &lastCount);
+        pending[current] = false;
+    }
+    glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, queries[current]);
+}
+
+void FragmentCounter::End() {
+    if (!supported) return;
+
+    glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+    pending[current] = true;
+    current = (current + 1) % QUERY_COUNT;
+}
@@ -0,0 +1,39 @@
+// FragmentCounter.h
+
+#ifndef FRAGMENTCOUNTER_H
+#define FRAGMENTCOUNTER_H
+
+#include <glad/glad.h>
+
+// Counts fragment shader invocations between Begin and End with a GL_FRAGMENT_SHADER_INVOCATIONS query
+// (GL 4.6 or ARB_pipeline_statistics_query), to measure overdraw.
+//
+// Each frame uses the next query of a small ring and the result is read when the ring comes back around,
+// a few frames later, so reading never waits on the GPU; a result that is still not ready is skipped.
+// Without driver support every call does nothing and IsSupported returns false.
+class FragmentCounter {
+public:
+    FragmentCounter();
+    ~FragmentCounter();
+
+    FragmentCounter(const FragmentCounter&) = delete;
+    FragmentCounter& operator=(const FragmentCounter&) = delete;
+
+    void Begin();
+    void End();
+
+    bool IsSupported() const { return supported; }
+    // Invocations of the latest frame whose result has come back
+    GLuint64 GetLastCount() const { return lastCount; }
+
+private:
+    static const int QUERY_COUNT = 4;
+
+    GLuint queries[QUERY_COUNT];
+    bool pending[QUERY_COUNT];
+    int current;
+    GLuint64 lastCount;
+    bool supported;
+};
+
+#endif
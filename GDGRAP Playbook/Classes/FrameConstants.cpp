@@ -0,0 +1,25 @@
+#include "FrameConstants.h"
+#include "StreamBuffer.h"
+
+void FrameConstants::SetCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position) {
+    this->view = view;
+    this->projection = projection;
+    viewProjection = projection * view;
+    cameraPosition = glm::vec4(position, 1.0f);
+}
+
+void FrameConstants::SetDirectionalLight(const glm::vec3& direction, const glm::vec3& color, float intensity) {
+    dirLightDirection = glm::vec4(direction, 0.0f);
+    dirLightColor = glm::vec4(color, intensity);
+}
+
+void FrameConstants::SetPointLight(const glm::vec3& position, const glm::vec3& color, float intensity, const glm::vec3& attenuation) {
+    pointLightPosition = glm::vec4(position, 1.0f);
+    pointLightColor = glm::vec4(color, intensity);
+    pointLightAttenuation = glm::vec4(attenuation, 0.0f);
+}
+
+//Writes a fresh copy of the block and points the binding at it; draws already issued keep reading the old one
+void FrameConstantBuffer::Update(const FrameConstants& constants) {
+    StreamBuffer::Instance().WriteUniforms(FRAME_CONSTANTS_BINDING, &constants, sizeof(FrameConstants));
+}
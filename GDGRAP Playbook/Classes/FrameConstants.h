@@ -0,0 +1,41 @@
+// FrameConstants.h
+
+#ifndef FRAMECONSTANTS_H
+#define FRAMECONSTANTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Uniform buffer binding point shared by every program that declares the FrameConstants block
+const GLuint FRAME_CONSTANTS_BINDING = 0;
+
+// Per-frame camera and lighting data, laid out to match the std140 FrameConstants block in the shaders.
+// Every member is a mat4 or vec4 so the C++ and GLSL offsets agree without manual padding;
+// the shaders declare the same block, so keep the two in sync.
+struct FrameConstants {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPosition;           // xyz position
+    glm::vec4 dirLightDirection;        // xyz direction the light travels
+    glm::vec4 dirLightColor;            // rgb color, a intensity
+    glm::vec4 pointLightPosition;       // xyz position
+    glm::vec4 pointLightColor;          // rgb color, a intensity
+    glm::vec4 pointLightAttenuation;    // constant, linear, quadratic
+
+    void SetCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position);
+    void SetDirectionalLight(const glm::vec3& direction, const glm::vec3& color, float intensity);
+    void SetPointLight(const glm::vec3& position, const glm::vec3& color, float intensity, const glm::vec3& attenuation);
+};
+
+static_assert(sizeof(FrameConstants) == 3 * 64 + 6 * 16, "FrameConstants must match the std140 block");
+
+// Feeds FRAME_CONSTANTS_BINDING from the per-frame StreamBuffer. Update it every frame before drawing, since
+// the data only lives for one frame; ShaderProgram points every program's FrameConstants block at the same
+// binding when it links.
+class FrameConstantBuffer {
+public:
+    void Update(const FrameConstants& constants);
+};
+
+#endif
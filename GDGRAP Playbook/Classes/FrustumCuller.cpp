@@ -0,0 +1,219 @@
+#include "FrustumCuller.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUMCULLER_SSE2
+#endif
+
+// MSVC compiles AVX intrinsics without /arch:AVX, so the kernel is always built there and picked at run
+// time; other compilers only build it when the whole program targets AVX
+#if defined(__AVX__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+#include <immintrin.h>
+#define FRUSTUMCULLER_AVX
+#endif
+
+#if defined(FRUSTUMCULLER_AVX) && !defined(__AVX__)
+#include <intrin.h>
+#endif
+
+// Stand-in extents for boxes with no bounds, so they are never culled
+static const float UNBOUNDED_EXTENT = 1e30f;
+
+//Signed distance test of one box against every plane
+static bool BoxVisible(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extents) {
+    for (const glm::vec4& plane : frustum.planes) {
+        glm::vec3 normal(plane);
+        if (glm::dot(normal, center) + glm::dot(glm::abs(normal), extents) + plane.w < 0.0f) return false;
+    }
+    return true;
+}
+
+//Checks that the CPU and the OS both support AVX (the OS has to save the YMM registers)
+static bool CpuSupportsAVX() {
+#if defined(__AVX__)
+    return true;
+#elif defined(FRUSTUMCULLER_AVX)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+    return false;
+#endif
+}
+
+//Scalar kernel; also finishes whatever the wide kernels leave over
+static void CullScalar(const Frustum& frustum, const float* const* soa, size_t begin, size_t end, uint8_t* visible) {
+    for (size_t i = begin; i < end; i++) {
+        glm::vec3 center(soa[0][i], soa[1][i], soa[2][i]);
+        glm::vec3 extents(soa[3][i], soa[4][i], soa[5][i]);
+        visible[i] = BoxVisible(frustum, center, extents) ? 1 : 0;
+    }
+}
+
+#ifdef FRUSTUMCULLER_SSE2
+//Four boxes per iteration; returns the index the scalar tail has to continue from
+static size_t CullSSE(const Frustum& frustum, const float* const* soa, size_t count, uint8_t* visible) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 cx = _mm_loadu_ps(soa[0] + i), cy = _mm_loadu_ps(soa[1] + i), cz = _mm_loadu_ps(soa[2] + i);
+        __m128 ex = _mm_loadu_ps(soa[3] + i), ey = _mm_loadu_ps(soa[4] + i), ez = _mm_loadu_ps(soa[5] + i);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(nx, signMask), ex), _mm_mul_ps(_mm_and_ps(ny, signMask), ey)), _mm_mul_ps(_mm_and_ps(nz, signMask), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        visible[i + 0] = uint8_t(mask & 1);
+        visible[i + 1] = uint8_t((mask >> 1) & 1);
+        visible[i + 2] = uint8_t((mask >> 2) & 1);
+        visible[i + 3] = uint8_t((mask >> 3) & 1);
+    }
+    return i;
+}
+#endif
+
+#ifdef FRUSTUMCULLER_AVX
+//Eight boxes per iteration; returns the index the scalar tail has to continue from
+static size_t CullAVX(const Frustum& frustum, const float* const* soa, size_t count, uint8_t* visible) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 cx = _mm256_loadu_ps(soa[0] + i), cy = _mm256_loadu_ps(soa[1] + i), cz = _mm256_loadu_ps(soa[2] + i);
+        __m256 ex = _mm256_loadu_ps(soa[3] + i), ey = _mm256_loadu_ps(soa[4] + i), ez = _mm256_loadu_ps(soa[5] + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (const glm::vec4& plane : frustum.planes) {
+            __m256 nx = _mm256_set1_ps(plane.x), ny = _mm256_set1_ps(plane.y), nz = _mm256_set1_ps(plane.z);
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)), _mm256_add_ps(_mm256_mul_ps(nz, cz), _mm256_set1_ps(plane.w)));
+            __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_and_ps(nx, signMask), ex), _mm256_mul_ps(_mm256_and_ps(ny, signMask), ey)), _mm256_mul_ps(_mm256_and_ps(nz, signMask), ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        for (int lane = 0; lane < 8; lane++) {
+            visible[i + lane] = uint8_t((mask >> lane) & 1);
+        }
+    }
+    return i;
+}
+#endif
+
+//Rows of the matrix combined as in Gribb & Hartmann, "Fast Extraction of Viewing Frustum Planes"
+Frustum Frustum::FromMatrix(const glm::mat4& viewProjection) {
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; row++) {
+        rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+    }
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];    // left
+    frustum.planes[1] = rows[3] - rows[0];    // right
+    frustum.planes[2] = rows[3] + rows[1];    // bottom
+    frustum.planes[3] = rows[3] - rows[1];    // top
+    frustum.planes[4] = rows[3] + rows[2];    // near
+    frustum.planes[5] = rows[3] - rows[2];    // far
+    for (glm::vec4& plane : frustum.planes) {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f) plane /= length;
+    }
+    return frustum;
+}
+
+bool Frustum::Intersects(const BoundingBox& box) const {
+    if (box.IsEmpty()) return true;
+    return BoxVisible(*this, box.GetCenter(), box.GetExtents());
+}
+
+bool Frustum::Intersects(const BoundingSphere& sphere) const {
+    if (sphere.radius < 0.0f) return true;
+    for (const glm::vec4& plane : planes) {
+        if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) return false;
+    }
+    return true;
+}
+
+void FrustumCuller::Clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+}
+
+//Empty boxes (meshes without bounds) are stored as unbounded so they always pass
+size_t FrustumCuller::Add(const BoundingBox& box) {
+    glm::vec3 center(0.0f), extents(UNBOUNDED_EXTENT);
+    if (!box.IsEmpty()) {
+        center = box.GetCenter();
+        extents = box.GetExtents();
+    }
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    extentX.push_back(extents.x);
+    extentY.push_back(extents.y);
+    extentZ.push_back(extents.z);
+    return centerX.size() - 1;
+}
+
+size_t FrustumCuller::Cull(const Frustum& frustum, CullingKernel kernel) {
+    size_t count = GetCount();
+    visible.resize(count);
+    if (count == 0) return 0;
+
+    const float* soa[6] = { centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data() };
+    size_t done = 0;
+    if (!IsKernelSupported(kernel)) kernel = GetBestKernel();
+#ifdef FRUSTUMCULLER_AVX
+    if (kernel == CULLING_KERNEL_AVX) done = CullAVX(frustum, soa, count, visible.data());
+#endif
+#ifdef FRUSTUMCULLER_SSE2
+    if (kernel == CULLING_KERNEL_SSE) done = CullSSE(frustum, soa, count, visible.data());
+#endif
+    CullScalar(frustum, soa, done, count, visible.data());
+
+    size_t visibleCount = 0;
+    for (uint8_t flag : visible) visibleCount += flag;
+    return visibleCount;
+}
+
+bool FrustumCuller::IsKernelSupported(CullingKernel kernel) {
+    switch (kernel) {
+    case CULLING_KERNEL_SCALAR: return true;
+#ifdef FRUSTUMCULLER_SSE2
+    case CULLING_KERNEL_SSE: return true;
+#endif
+#ifdef FRUSTUMCULLER_AVX
+    case CULLING_KERNEL_AVX: {
+        static const bool supported = CpuSupportsAVX();
+        return supported;
+    }
+#endif
+    default: return false;
+    }
+}
+
+CullingKernel FrustumCuller::GetBestKernel() {
+    if (IsKernelSupported(CULLING_KERNEL_AVX)) return CULLING_KERNEL_AVX;
+    if (IsKernelSupported(CULLING_KERNEL_SSE)) return CULLING_KERNEL_SSE;
+    return CULLING_KERNEL_SCALAR;
+}
+
+const char* FrustumCuller::GetKernelName(CullingKernel kernel) {
+    switch (kernel) {
+    case CULLING_KERNEL_SSE: return "SSE x4";
+    case CULLING_KERNEL_AVX: return "AVX x8";
+    default: return "scalar";
+    }
+}
@@ -0,0 +1,54 @@
+// FrustumCuller.h
+
+#ifndef FRUSTUMCULLER_H
+#define FRUSTUMCULLER_H
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Bounds.h"
+
+// The six clip planes of a projection * view matrix as (normal, distance), normalized so that
+// dot(normal, p) + distance is the signed distance of p, positive on the inside
+struct Frustum {
+    glm::vec4 planes[6];
+
+    static Frustum FromMatrix(const glm::mat4& viewProjection);
+
+    bool Intersects(const BoundingBox& box) const;
+    bool Intersects(const BoundingSphere& sphere) const;
+};
+
+// Implementations of the box test; the widest one the CPU supports is the default
+enum CullingKernel {
+    CULLING_KERNEL_SCALAR,
+    CULLING_KERNEL_SSE,     // 4 boxes per iteration
+    CULLING_KERNEL_AVX      // 8 boxes per iteration
+};
+
+// Batches world-space boxes in structure-of-arrays form and tests them against a frustum several at a
+// time. A box is kept unless it lies entirely outside one of the planes, so the test is conservative:
+// boxes near a frustum corner can pass without being on screen.
+class FrustumCuller {
+public:
+    void Clear();
+    // Returns the index to pass to IsVisible after Cull
+    size_t Add(const BoundingBox& box);
+    size_t GetCount() const { return centerX.size(); }
+
+    // Tests every added box; returns how many are visible
+    size_t Cull(const Frustum& frustum, CullingKernel kernel = GetBestKernel());
+    bool IsVisible(size_t index) const { return visible[index] != 0; }
+
+    static bool IsKernelSupported(CullingKernel kernel);
+    static CullingKernel GetBestKernel();
+    static const char* GetKernelName(CullingKernel kernel);
+
+private:
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<uint8_t> visible;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "GBuffer.h"
+#include "GLState.h"
+#include <iostream>
+
+//Allocates one render target texture with nearest filtering; the lighting pass reads it texel for texel
+static GLuint CreateTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+GBuffer::GBuffer(ShaderProgram& lightingShader) :
+    lightingShader(lightingShader), width(0), height(0), framebuffer(0), albedoTexture(0), normalTexture(0), tintTexture(0), depthTexture(0), emptyVAO(0) {
+    albedoUniform = lightingShader.FindUniform("gAlbedo");
+    normalUniform = lightingShader.FindUniform("gNormal");
+    tintUniform = lightingShader.FindUniform("gTint");
+    depthUniform = lightingShader.FindUniform("gDepth");
+    inverseViewProjectionUniform = lightingShader.FindUniform("inverseViewProjection");
+
+    // The fullscreen triangle is generated from gl_VertexID, but core profile still needs a VAO bound
+    glGenVertexArrays(1, &emptyVAO);
+}
+
+GBuffer::~GBuffer() {
+    Release();
+    GLState::ForgetVertexArray(emptyVAO);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void GBuffer::Release() {
+    if (!framebuffer) return;
+    GLuint textures[4] = { albedoTexture, normalTexture, tintTexture, depthTexture };
+    for (GLuint texture : textures) GLState::ForgetTexture(texture);
+    glDeleteTextures(4, textures);
+    glDeleteFramebuffers(1, &framebuffer);
+    framebuffer = albedoTexture = normalTexture = tintTexture = depthTexture = 0;
+}
+
+void GBuffer::Resize(int width, int height) {
+    Release();
+    this->width = width;
+    this->height = height;
+
+    albedoTexture = CreateTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    normalTexture = CreateTarget(GL_RG16_SNORM, GL_RG, GL_SHORT, width, height);
+    tintTexture = CreateTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    depthTexture = CreateTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, tintTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+    glDrawBuffers(3, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "G-buffer framebuffer is incomplete" << std::endl;
+    }
+}
+
+void GBuffer::BeginGeometry(int width, int height) {
+    if (width != this->width || height != this->height || !framebuffer) Resize(width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GLState::Viewport(0, 0, width, height);
+    GLState::DepthMask(true);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    GLState::SetDepthTest(true);
+}
+
+//One fullscreen triangle into framebuffer 0; deferred.frag discards the pixels that no geometry covered,
+//which the sky fills afterwards
+void GBuffer::Light(const glm::mat4& inverseViewProjection) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::SetDepthTest(false);
+    GLState::SetBlend(false);
+
+    GLState::BindTexture(0, GL_TEXTURE_2D, albedoTexture);
+    GLState::BindTexture(1, GL_TEXTURE_2D, normalTexture);
+    GLState::BindTexture(GBUFFER_TINT_TEXTURE_UNIT, GL_TEXTURE_2D, tintTexture);
+    GLState::BindTexture(GBUFFER_DEPTH_TEXTURE_UNIT, GL_TEXTURE_2D, depthTexture);
+    lightingShader.Use();
+    lightingShader.SetInt(albedoUniform, 0);
+    lightingShader.SetInt(normalUniform, 1);
+    lightingShader.SetInt(tintUniform, static_cast<GLint>(GBUFFER_TINT_TEXTURE_UNIT));
+    lightingShader.SetInt(depthUniform, static_cast<GLint>(GBUFFER_DEPTH_TEXTURE_UNIT));
+    lightingShader.SetMat4(inverseViewProjectionUniform, inverseViewProjection);
+
+    GLState::BindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    // Blended draws and anything after them depth test against the opaque scene
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::SetDepthTest(true);
+}
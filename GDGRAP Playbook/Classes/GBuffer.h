@@ -0,0 +1,51 @@
+// GBuffer.h
+
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "ShaderProgram.h"
+
+// Texture unit the lighting pass reads depth from, after the clustered lighting units; albedo and normals
+// take units 0 and 1, the slots of the mesh textures they were written from
+const GLuint GBUFFER_DEPTH_TEXTURE_UNIT = 6;
+// Texture unit of the tint target, after LIVERY_TEXTURE_UNIT
+const GLuint GBUFFER_TINT_TEXTURE_UNIT = 8;
+
+// Render targets of the deferred path, sized to the window:
+//   albedo   RGBA8        texture color
+//   normal   RG16_SNORM   world-space normal, octahedral encoded into two channels
+//   tint     RGBA8        instance tint, applied after lighting as the forward path does
+//   depth    DEPTH24_STENCIL8, matching the default framebuffer so it can be blitted across
+// World positions are rebuilt from depth, so the whole buffer is 16 bytes per pixel.
+//
+// The opaque pass is drawn into it with Shaders/gbuffer.frag, then Light shades every covered pixel
+// once with a fullscreen triangle (Shaders/fullscreen.vert and deferred.frag) into framebuffer 0. The sky
+// and the blended draws stay forward and come after, testing against the copied depth.
+class GBuffer {
+public:
+    // lightingShader runs the fullscreen pass; its shadow and cluster samplers are bound by their owners
+    explicit GBuffer(ShaderProgram& lightingShader);
+    ~GBuffer();
+
+    GBuffer(const GBuffer&) = delete;
+    GBuffer& operator=(const GBuffer&) = delete;
+
+    // Resizes the targets if the window changed, then binds and clears them for the geometry pass
+    void BeginGeometry(int width, int height);
+    // Shades the G-buffer into framebuffer 0 and copies its depth there. Leaves framebuffer 0 bound.
+    void Light(const glm::mat4& inverseViewProjection);
+
+private:
+    void Resize(int width, int height);
+    void Release();
+
+    ShaderProgram& lightingShader;
+    int albedoUniform, normalUniform, tintUniform, depthUniform, inverseViewProjectionUniform;
+    int width, height;
+    GLuint framebuffer, albedoTexture, normalTexture, tintTexture, depthTexture;
+    GLuint emptyVAO;
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "GLState.h"
+#include <limits>
+
+// Texture units and targets the cache tracks; binds outside this range go straight to the driver
+static const GLuint TRACKED_TEXTURE_UNITS = 16;
+static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+// Last values set through GLState; UNKNOWN (or -1 for flags, NaN for floats) forces the next call through
+struct ShadowState {
+    GLuint program;
+    GLuint vertexArray;
+    GLuint activeUnit;
+    GLuint textures2D[TRACKED_TEXTURE_UNITS];
+    GLuint texturesCube[TRACKED_TEXTURE_UNITS];
+    int blend;
+    GLenum blendSource, blendDestination, blendSourceAlpha, blendDestinationAlpha;
+    int depthTest;
+    GLenum depthFunc;
+    int depthMask;
+    int polygonOffsetFill;
+    GLfloat polygonOffset[2];
+    GLint viewport[4];
+    GLStateCounters counters;
+};
+
+//Marks every tracked value unknown so the next call for it always reaches the driver
+static void MarkUnknown(ShadowState& state) {
+    state.program = UNKNOWN;
+    state.vertexArray = UNKNOWN;
+    state.activeUnit = UNKNOWN;
+    for (GLuint unit = 0; unit < TRACKED_TEXTURE_UNITS; unit++) {
+        state.textures2D[unit] = UNKNOWN;
+        state.texturesCube[unit] = UNKNOWN;
+    }
+    state.blend = -1;
+    state.blendSource = state.blendDestination = state.blendSourceAlpha = state.blendDestinationAlpha = UNKNOWN;
+    state.depthTest = -1;
+    state.depthFunc = UNKNOWN;
+    state.depthMask = -1;
+    state.polygonOffsetFill = -1;
+    for (GLfloat& value : state.polygonOffset) value = std::numeric_limits<GLfloat>::quiet_NaN();
+    for (GLint& value : state.viewport) value = -1;
+}
+
+//Returns the shadow state, starting out with everything unknown
+static ShadowState& Shadow() {
+    static ShadowState state = []() {
+        ShadowState initial;
+        MarkUnknown(initial);
+        return initial;
+    }();
+    return state;
+}
+
+//Counts the call and returns true if the value changed (and records it)
+template <typename T>
+static bool Changed(T& shadow, T value) {
+    GLStateCounters& counters = Shadow().counters;
+    if (shadow == value) {
+        counters.skipped++;
+        return false;
+    }
+    shadow = value;
+    counters.issued++;
+    return true;
+}
+
+//Switches the active texture unit; counted as part of the bind that needed it
+static void ActivateUnit(ShadowState& state, GLuint unit) {
+    if (state.activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        state.activeUnit = unit;
+    }
+}
+
+void GLState::UseProgram(GLuint program) {
+    if (Changed(Shadow().program, program)) glUseProgram(program);
+}
+
+void GLState::BindVertexArray(GLuint vertexArray) {
+    if (Changed(Shadow().vertexArray, vertexArray)) glBindVertexArray(vertexArray);
+}
+
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint texture) {
+    ShadowState& state = Shadow();
+    GLuint* slot = nullptr;
+    if (unit < TRACKED_TEXTURE_UNITS) {
+        if (target == GL_TEXTURE_2D) slot = &state.textures2D[unit];
+        else if (target == GL_TEXTURE_CUBE_MAP) slot = &state.texturesCube[unit];
+    }
+
+    if (slot && !Changed(*slot, texture)) return;
+    if (!slot) state.counters.issued++;
+
+    ActivateUnit(state, unit);
+    glBindTexture(target, texture);
+}
+
+void GLState::SetBlend(bool enabled) {
+    if (Changed(Shadow().blend, enabled ? 1 : 0)) {
+        if (enabled) glEnable(GL_BLEND);
+        else glDisable(GL_BLEND);
+    }
+}
+
+void GLState::BlendFunc(GLenum source, GLenum destination) {
+    BlendFuncSeparate(source, destination, source, destination);
+}
+
+void GLState::BlendFuncSeparate(GLenum source, GLenum destination, GLenum sourceAlpha, GLenum destinationAlpha) {
+    ShadowState& state = Shadow();
+    if (state.blendSource == source && state.blendDestination == destination &&
+        state.blendSourceAlpha == sourceAlpha && state.blendDestinationAlpha == destinationAlpha) {
+        state.counters.skipped++;
+        return;
+    }
+    state.blendSource = source;
+    state.blendDestination = destination;
+    state.blendSourceAlpha = sourceAlpha;
+    state.blendDestinationAlpha = destinationAlpha;
+    state.counters.issued++;
+    glBlendFuncSeparate(source, destination, sourceAlpha, destinationAlpha);
+}
+
+void GLState::SetDepthTest(bool enabled) {
+    if (Changed(Shadow().depthTest, enabled ? 1 : 0)) {
+        if (enabled) glEnable(GL_DEPTH_TEST);
+        else glDisable(GL_DEPTH_TEST);
+    }
+}
+
+void GLState::DepthFunc(GLenum function) {
+    if (Changed(Shadow().depthFunc, function)) glDepthFunc(function);
+}
+
+void GLState::DepthMask(bool write) {
+    if (Changed(Shadow().depthMask, write ? 1 : 0)) glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::SetPolygonOffsetFill(bool enabled) {
+    if (Changed(Shadow().polygonOffsetFill, enabled ? 1 : 0)) {
+        if (enabled) glEnable(GL_POLYGON_OFFSET_FILL);
+        else glDisable(GL_POLYGON_OFFSET_FILL);
+    }
+}
+
+void GLState::PolygonOffset(GLfloat factor, GLfloat units) {
+    ShadowState& state = Shadow();
+    if (state.polygonOffset[0] == factor && state.polygonOffset[1] == units) {
+        state.counters.skipped++;
+        return;
+    }
+    state.polygonOffset[0] = factor;
+    state.polygonOffset[1] = units;
+    state.counters.issued++;
+    glPolygonOffset(factor, units);
+}
+
+void GLState::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    ShadowState& state = Shadow();
+    if (state.viewport[0] == x && state.viewport[1] == y && state.viewport[2] == width && state.viewport[3] == height) {
+        state.counters.skipped++;
+        return;
+    }
+    state.viewport[0] = x;
+    state.viewport[1] = y;
+    state.viewport[2] = width;
+    state.viewport[3] = height;
+    state.counters.issued++;
+    glViewport(x, y, width, height);
+}
+
+//A deleted program stays current until something else is bound, but its name may be handed out again
+void GLState::ForgetProgram(GLuint program) {
+    ShadowState& state = Shadow();
+    if (state.program == program) state.program = UNKNOWN;
+}
+
+//Deleting the bound VAO reverts the binding to 0
+void GLState::ForgetVertexArray(GLuint vertexArray) {
+    ShadowState& state = Shadow();
+    if (vertexArray && state.vertexArray == vertexArray) state.vertexArray = 0;
+}
+
+//Deleting a texture reverts every unit it was bound to back to 0
+void GLState::ForgetTexture(GLuint texture) {
+    if (!texture) return;
+    ShadowState& state = Shadow();
+    for (GLuint unit = 0; unit < TRACKED_TEXTURE_UNITS; unit++) {
+        if (state.textures2D[unit] == texture) state.textures2D[unit] = 0;
+        if (state.texturesCube[unit] == texture) state.texturesCube[unit] = 0;
+    }
+}
+
+void GLState::Invalidate() {
+    MarkUnknown(Shadow());
+}
+
+const GLStateCounters& GLState::GetCounters() {
+    return Shadow().counters;
+}
+
+void GLState::ResetCounters() {
+    Shadow().counters = GLStateCounters();
+}
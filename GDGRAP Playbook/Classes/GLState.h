@@ -0,0 +1,49 @@
+// GLState.h
+
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+#include <cstddef>
+
+// Calls that reached the driver versus calls dropped because the state already matched
+struct GLStateCounters {
+    size_t issued = 0;
+    size_t skipped = 0;
+};
+
+// Shadow copy of the GL state the renderer changes most often. Each setter compares against the last
+// value it set and only calls into the driver when it differs.
+//
+// The cache only stays correct if every change to this state goes through it, so code that binds
+// programs, VAOs or textures must use these functions, and objects must be reported with Forget*
+// before they are deleted (a deleted name can be reused for a new object). Invalidate() forgets
+// everything, e.g. after third-party code has touched the context.
+class GLState {
+public:
+    static void UseProgram(GLuint program);
+    static void BindVertexArray(GLuint vertexArray);
+
+    // unit is an index (0, 1, ...), not GL_TEXTURE0 + n; binding also makes it the active unit
+    static void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    static void SetBlend(bool enabled);
+    static void BlendFunc(GLenum source, GLenum destination);
+    static void BlendFuncSeparate(GLenum source, GLenum destination, GLenum sourceAlpha, GLenum destinationAlpha);
+    static void SetDepthTest(bool enabled);
+    static void DepthFunc(GLenum function);
+    static void DepthMask(bool write);
+    static void SetPolygonOffsetFill(bool enabled);
+    static void PolygonOffset(GLfloat factor, GLfloat units);
+    static void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    static void ForgetProgram(GLuint program);
+    static void ForgetVertexArray(GLuint vertexArray);
+    static void ForgetTexture(GLuint texture);
+    static void Invalidate();
+
+    static const GLStateCounters& GetCounters();
+    static void ResetCounters();
+};
+
+#endif
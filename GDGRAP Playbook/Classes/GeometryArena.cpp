@@ -0,0 +1,259 @@
+#include "GeometryArena.h"
+#include "Mesh.h"
+#include "GLState.h"
+#include "StreamBuffer.h"
+#include <algorithm>
+#include <cstddef>
+
+// Starting sizes, about the track props and one car
+static const GLsizei INITIAL_VERTEX_CAPACITY = 1 << 16;
+static const GLsizei INITIAL_INDEX_CAPACITY = 3 << 16;
+
+//Takes the front of the first free block that fits
+bool RangeAllocator::Allocate(GLsizei count, GLuint& offset) {
+    if (count <= 0) {
+        offset = 0;
+        return true;
+    }
+    for (size_t i = 0; i < freeBlocks.size(); i++) {
+        Block& block = freeBlocks[i];
+        if (block.count < count) continue;
+
+        offset = block.offset;
+        block.offset += count;
+        block.count -= count;
+        if (block.count == 0) freeBlocks.erase(freeBlocks.begin() + i);
+        return true;
+    }
+    return false;
+}
+
+//Inserts the block in offset order and merges it with the blocks on either side
+void RangeAllocator::Free(GLuint offset, GLsizei count) {
+    if (count <= 0) return;
+
+    std::vector<Block>::iterator next = std::lower_bound(freeBlocks.begin(), freeBlocks.end(), offset,
+        [](const Block& block, GLuint value) { return block.offset < value; });
+    Block block = { offset, count };
+    if (next != freeBlocks.end() && offset + count == next->offset) {
+        block.count += next->count;
+        next = freeBlocks.erase(next);
+    }
+    if (next != freeBlocks.begin()) {
+        Block& previous = *(next - 1);
+        if (previous.offset + previous.count == block.offset) {
+            previous.count += block.count;
+            return;
+        }
+    }
+    freeBlocks.insert(next, block);
+}
+
+void RangeAllocator::Grow(GLsizei count) {
+    GLuint offset = static_cast<GLuint>(capacity);
+    capacity += count;
+    Free(offset, count);
+}
+
+GeometryArena::GeometryArena() :
+    vertexBuffer(0), indexBuffer(0),
+    vertexArray(0), instanceArray(0),
+    instanceBuffer(0), instanceBase(0), instanceOffset(0) {
+}
+
+GeometryArena::~GeometryArena() {
+    if (!vertexArray) return;
+    GLState::ForgetVertexArray(vertexArray);
+    GLState::ForgetVertexArray(instanceArray);
+    GLuint arrays[2] = { vertexArray, instanceArray };
+    glDeleteVertexArrays(2, arrays);
+    GLuint buffers[2] = { vertexBuffer, indexBuffer };
+    glDeleteBuffers(2, buffers);
+}
+
+GeometryArena& GeometryArena::Instance() {
+    static GeometryArena arena;
+    return arena;
+}
+
+bool GeometryArena::SupportsBaseInstance() {
+    return GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_base_instance;
+}
+
+bool GeometryArena::SupportsMultiDrawIndirect() {
+    return GLAD_GL_VERSION_4_3 || (GLAD_GL_ARB_multi_draw_indirect && SupportsBaseInstance());
+}
+
+void GeometryArena::CreateBuffers() {
+    vertices.Grow(INITIAL_VERTEX_CAPACITY);
+    indices.Grow(INITIAL_INDEX_CAPACITY);
+
+    GrowBuffer(vertexBuffer, GL_ARRAY_BUFFER, 0, INITIAL_VERTEX_CAPACITY * sizeof(Vertex));
+    GrowBuffer(indexBuffer, GL_ELEMENT_ARRAY_BUFFER, 0, INITIAL_INDEX_CAPACITY * sizeof(GLuint));
+    glGenVertexArrays(1, &vertexArray);
+    glGenVertexArrays(1, &instanceArray);
+    SetVertexLayout(vertexArray);
+    SetVertexLayout(instanceArray);
+
+    // A mat4 attribute takes four consecutive locations, one column each; UploadInstances points them
+    for (GLuint location = INSTANCE_ATTRIBUTE_LOCATION; location < INSTANCE_ATTRIBUTE_LOCATION + INSTANCE_ATTRIBUTE_COUNT; location++) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    GLState::BindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//Copies through the copy targets, which belong to no vertex array
+void GeometryArena::GrowBuffer(GLuint& buffer, GLenum target, GLsizeiptr oldSize, GLsizeiptr newSize) {
+    GLuint grown;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+    if (buffer) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = grown;
+
+    // Vertex arrays keep the old buffer alive until they are pointed at the new one
+    if (!vertexArray) return;
+    GLuint arrays[2] = { vertexArray, instanceArray };
+    for (GLuint vao : arrays) {
+        if (target == GL_ARRAY_BUFFER) {
+            SetVertexLayout(vao);
+        }
+        else {
+            GLState::BindVertexArray(vao);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+        }
+    }
+    GLState::BindVertexArray(0);
+}
+
+//Binds the vertex array and points attributes 0-4 and the index buffer at the arena
+void GeometryArena::SetVertexLayout(GLuint vao) const {
+    GLState::BindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+    glEnableVertexAttribArray(2);
+
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
+    glEnableVertexAttribArray(3);
+
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
+    glEnableVertexAttribArray(4);
+}
+
+void GeometryArena::SetInstanceLayout(GLuint firstInstance) {
+    GLState::BindVertexArray(instanceArray);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    size_t base = instanceBase + size_t(firstInstance) * sizeof(InstanceData);
+    for (GLuint column = 0; column < 4; column++) {
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+            (void*)(base + offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+    }
+    glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + 4, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, tint)));
+    glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + 5, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, livery)));
+    for (GLuint column = 0; column < 3; column++) {
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + 6 + column, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+            (void*)(base + offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec3)));
+    }
+    instanceOffset = firstInstance;
+}
+
+//Widens 16-bit indices on the way in, so every draw from the arena uses GL_UNSIGNED_INT
+GeometryRange GeometryArena::Allocate(const void* vertexData, GLsizei vertexCount, const void* indexData, GLsizei indexCount, GLenum indexType) {
+    if (!vertexArray) CreateBuffers();
+
+    GeometryRange range;
+    range.vertexCount = vertexCount;
+    range.indexCount = indexCount;
+
+    GLuint vertexOffset;
+    while (!vertices.Allocate(vertexCount, vertexOffset)) {
+        GLsizei capacity = vertices.GetCapacity();
+        GLsizei added = std::max(capacity, vertexCount);
+        GrowBuffer(vertexBuffer, GL_ARRAY_BUFFER, capacity * sizeof(Vertex), (capacity + added) * sizeof(Vertex));
+        vertices.Grow(added);
+    }
+    while (!indices.Allocate(indexCount, range.firstIndex)) {
+        GLsizei capacity = indices.GetCapacity();
+        GLsizei added = std::max(capacity, indexCount);
+        GrowBuffer(indexBuffer, GL_ELEMENT_ARRAY_BUFFER, capacity * sizeof(GLuint), (capacity + added) * sizeof(GLuint));
+        indices.Grow(added);
+    }
+    range.baseVertex = static_cast<GLint>(vertexOffset);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, size_t(vertexOffset) * sizeof(Vertex), vertexCount * sizeof(Vertex), vertexData);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+    if (indexType == GL_UNSIGNED_SHORT) {
+        const GLushort* shortIndices = static_cast<const GLushort*>(indexData);
+        std::vector<GLuint> wideIndices(shortIndices, shortIndices + indexCount);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, size_t(range.firstIndex) * sizeof(GLuint), indexCount * sizeof(GLuint), wideIndices.data());
+    }
+    else {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, size_t(range.firstIndex) * sizeof(GLuint), indexCount * sizeof(GLuint), indexData);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return range;
+}
+
+void GeometryArena::Free(const GeometryRange& range) {
+    vertices.Free(static_cast<GLuint>(range.baseVertex), range.vertexCount);
+    indices.Free(range.firstIndex, range.indexCount);
+}
+
+//Writes into the frame's part of the stream buffer, which may move from one upload to the next, so the
+//instance attributes are pointed at it every time. Each instance's normal matrix is filled in on the way.
+void GeometryArena::UploadInstances(const InstanceData* instances, GLsizei count) {
+    if (!vertexArray) CreateBuffers();
+
+    StreamBuffer& stream = StreamBuffer::Instance();
+    if (count <= 0) {
+        instanceBase = stream.Write(nullptr, 0);
+    }
+    else {
+        InstanceData* destination = static_cast<InstanceData*>(stream.Map(count * sizeof(InstanceData), 16, instanceBase));
+        for (GLsizei i = 0; destination && i < count; i++) {
+            destination[i] = instances[i];
+            destination[i].normalMatrix = InstanceData::ComputeNormalMatrix(instances[i].model);
+        }
+        stream.Unmap();
+    }
+    instanceBuffer = stream.GetBuffer();
+    SetInstanceLayout(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::BindInstances(GLuint buffer, GLintptr base) {
+    if (buffer == instanceBuffer && base == instanceBase) {
+        SetInstanceOffset(0);
+        return;
+    }
+    instanceBuffer = buffer;
+    instanceBase = base;
+    SetInstanceLayout(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::SetInstanceOffset(GLuint firstInstance) {
+    if (firstInstance == instanceOffset) {
+        GLState::BindVertexArray(instanceArray);
+        return;
+    }
+    SetInstanceLayout(firstInstance);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
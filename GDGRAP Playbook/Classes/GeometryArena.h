@@ -0,0 +1,107 @@
+// GeometryArena.h
+
+#ifndef GEOMETRYARENA_H
+#define GEOMETRYARENA_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+struct InstanceData;
+
+// Where a mesh lives inside the arena: its first vertex and first index
+struct GeometryRange {
+    GLint baseVertex;
+    GLuint firstIndex;
+    GLsizei vertexCount;
+    GLsizei indexCount;
+};
+
+// First-fit allocator over a range of element slots; freed blocks merge with their neighbours
+class RangeAllocator {
+public:
+    RangeAllocator() : capacity(0) {}
+
+    // Returns false when no free block is large enough; Grow and try again
+    bool Allocate(GLsizei count, GLuint& offset);
+    void Free(GLuint offset, GLsizei count);
+    // Appends count free slots at the end
+    void Grow(GLsizei count);
+    GLsizei GetCapacity() const { return capacity; }
+
+private:
+    struct Block {
+        GLuint offset;
+        GLsizei count;
+    };
+
+    std::vector<Block> freeBlocks;  // sorted by offset, never adjacent
+    GLsizei capacity;
+};
+
+// One vertex buffer and one index buffer that every Mesh is sub-allocated from, so any mix of meshes can be drawn
+// without rebinding geometry. Indices are stored as 32-bit and relative to the mesh's base vertex.
+//
+// Two vertex arrays read the buffers:
+//   vertex array    attributes 0-4 only; a single draw takes the instance inputs from generic values
+//   instance array  attributes 0-4 plus the instance stream (in the StreamBuffer) at locations 5-10 with divisor 1
+// Instance i of a draw reads stream entry baseInstance + i, which is how RenderQueue hands every command of a
+// glMultiDrawElementsIndirect call its own transforms.
+//
+// Buffers start small and double when full, so they are copied a handful of times while the scene loads.
+// The GL objects are created on the first Allocate.
+class GeometryArena {
+public:
+    // The arena shared by every Mesh
+    static GeometryArena& Instance();
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // Copies the vertices (Vertex layout) and indices (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) into the arena
+    GeometryRange Allocate(const void* vertexData, GLsizei vertexCount, const void* indexData, GLsizei indexCount, GLenum indexType);
+    void Free(const GeometryRange& range);
+
+    GLuint GetVertexArray() const { return vertexArray; }
+    GLuint GetInstanceArray() const { return instanceArray; }
+
+    // Writes the instances to the StreamBuffer and points the instance array at them; they are good for this
+    // frame only
+    void UploadInstances(const InstanceData* instances, GLsizei count);
+    // Where the last upload went; pass both back to BindInstances to draw from it again later in the frame,
+    // after other uploads have moved the instance array
+    GLuint GetInstanceBuffer() const { return instanceBuffer; }
+    GLintptr GetInstanceBase() const { return instanceBase; }
+    // Points the instance array back at an upload of this frame and leaves it bound
+    void BindInstances(GLuint buffer, GLintptr base);
+    // Points the instance array's attributes at entry firstInstance of the bound upload; only needed where draws
+    // cannot take a base instance (see SupportsBaseInstance). The instance array is left bound.
+    void SetInstanceOffset(GLuint firstInstance);
+
+    // glDrawElementsInstancedBaseVertexBaseInstance and the baseInstance field of indirect commands (GL 4.2)
+    static bool SupportsBaseInstance();
+    // glMultiDrawElementsIndirect with base instances (GL 4.3)
+    static bool SupportsMultiDrawIndirect();
+
+    size_t GetVertexCapacity() const { return vertices.GetCapacity(); }
+    size_t GetIndexCapacity() const { return indices.GetCapacity(); }
+
+private:
+    GeometryArena();
+
+    void CreateBuffers();
+    // Moves a buffer's contents into a new one of newSize bytes
+    void GrowBuffer(GLuint& buffer, GLenum target, GLsizeiptr oldSize, GLsizeiptr newSize);
+    void SetVertexLayout(GLuint vao) const;
+    void SetInstanceLayout(GLuint firstInstance);
+
+    RangeAllocator vertices, indices;
+    GLuint vertexBuffer, indexBuffer;
+    GLuint vertexArray, instanceArray;
+    GLuint instanceBuffer;      // stream buffer written by the last UploadInstances; a later grow replaces it
+    GLintptr instanceBase;      // offset of the last UploadInstances in instanceBuffer
+    GLuint instanceOffset;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer() : queries(), pending(), current(0), elapsedSum(0), elapsedCount(0) {
+    glGenQueries(QUERY_COUNT, queries);
+}
+
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(QUERY_COUNT, queries);
+}
+
+//Collects the result this query held from QUERY_COUNT frames ago, then reuses it for this frame
+void GpuTimer::Begin() {
+    if (pending[current]) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &elapsed);
+            elapsedSum += elapsed;
+            elapsedCount++;
+        }
+        pending[current] = false;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+}
+
+void GpuTimer::End() {
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[current] = true;
+    current = (current + 1) % QUERY_COUNT;
+}
+
+double GpuTimer::TakeAverageMilliseconds() {
+    double average = elapsedCount > 0 ? elapsedSum / 1e6 / elapsedCount : 0.0;
+    elapsedSum = 0;
+    elapsedCount = 0;
+    return average;
+}
@@ -0,0 +1,38 @@
+// GpuTimer.h
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <glad/glad.h>
+
+// Measures the GPU time spent between Begin and End with a GL_TIME_ELAPSED query, so the shading paths can
+// be compared without vsync or the CPU side of the frame getting in the way.
+//
+// Like FragmentCounter, each frame uses the next query of a small ring and reads the result only when the
+// ring comes back around, so reading never waits on the GPU; a result that is still not ready is skipped.
+// Only one GL_TIME_ELAPSED query can be running at a time, so timers must not overlap.
+class GpuTimer {
+public:
+    GpuTimer();
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    void Begin();
+    void End();
+
+    // Average of the results collected since the last call, in milliseconds; 0 if none came back
+    double TakeAverageMilliseconds();
+
+private:
+    static const int QUERY_COUNT = 4;
+
+    GLuint queries[QUERY_COUNT];
+    bool pending[QUERY_COUNT];
+    int current;
+    GLuint64 elapsedSum;
+    int elapsedCount;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "ImpostorAtlas.h"
+#include "Model.h"
+#include "GLState.h"
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Transparent texels take the color of their opaque neighbours this many texels out, so mip levels
+// and bilinear taps at the silhouette blend towards the car instead of towards black
+static const int DILATION_PASSES = 4;
+
+//Spreads the color of covered texels into the uncovered ones around them; alpha is left untouched
+static void DilateColors(std::vector<unsigned char>& pixels, int width, int height) {
+    std::vector<unsigned char> covered(size_t(width) * height);
+    for (size_t i = 0; i < covered.size(); i++) {
+        covered[i] = pixels[4 * i + 3] != 0;
+    }
+
+    std::vector<unsigned char> next(covered);
+    for (int pass = 0; pass < DILATION_PASSES; pass++) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                size_t texel = size_t(y) * width + x;
+                if (covered[texel]) continue;
+
+                int sum[3] = { 0, 0, 0 }, count = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx, ny = y + dy;
+                        if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+                        size_t neighbour = size_t(ny) * width + nx;
+                        if (!covered[neighbour]) continue;
+                        for (int c = 0; c < 3; c++) sum[c] += pixels[4 * neighbour + c];
+                        count++;
+                    }
+                }
+                if (count == 0) continue;
+                for (int c = 0; c < 3; c++) pixels[4 * texel + c] = static_cast<unsigned char>(sum[c] / count);
+                next[texel] = 1;
+            }
+        }
+        covered = next;
+    }
+}
+
+ImpostorAtlas::ImpostorAtlas(ShaderProgram& shader, ShaderProgram& transparentShader) :
+    atlasTexture(0), shader(shader), transparentShader(transparentShader) {
+}
+
+ImpostorAtlas::~ImpostorAtlas() {
+    if (atlasTexture) {
+        GLState::ForgetTexture(atlasTexture);
+        glDeleteTextures(1, &atlasTexture);
+    }
+}
+
+//Renders every view into its tile, then dilates, mipmaps and wraps the atlas in the quad mesh
+bool ImpostorAtlas::Build(Model& model, ShaderProgram& meshShader, FrameConstantBuffer& frameConstantBuffer,
+    const FrameConstants& lighting, int tileSize) {
+    const MeshBounds& bounds = model.GetBounds();
+    if (IsBuilt() || !model.IsReady() || !(bounds.sphere.radius > 0.0f)) return false;
+
+    int width = IMPOSTOR_YAW_VIEWS * tileSize;
+    int height = IMPOSTOR_PITCH_VIEWS * tileSize;
+    glm::vec3 center = bounds.sphere.center;
+    float radius = bounds.sphere.radius;
+
+    GLuint texture, framebuffer, depthBuffer;
+    glGenTextures(1, &texture);
+    GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    if (complete) {
+        GLState::Viewport(0, 0, width, height);
+        GLState::DepthMask(true);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        GLState::SetDepthTest(true);
+        GLState::SetBlend(false);
+
+        // Orthographic views from two radii out, so every tile frames the whole sphere the same way
+        glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius * 0.5f, radius * 3.5f);
+        float maxPitch = glm::radians(IMPOSTOR_MAX_PITCH_DEGREES);
+        for (int row = 0; row < IMPOSTOR_PITCH_VIEWS; row++) {
+            float pitch = IMPOSTOR_PITCH_VIEWS > 1 ? maxPitch * row / (IMPOSTOR_PITCH_VIEWS - 1) : 0.0f;
+            for (int column = 0; column < IMPOSTOR_YAW_VIEWS; column++) {
+                float yaw = glm::two_pi<float>() * column / IMPOSTOR_YAW_VIEWS;
+                glm::vec3 direction(std::sin(yaw) * std::cos(pitch), std::sin(pitch), std::cos(yaw) * std::cos(pitch));
+                glm::vec3 eye = center + direction * (2.0f * radius);
+
+                FrameConstants constants = lighting;
+                constants.SetCamera(glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f)), projection, eye);
+                frameConstantBuffer.Update(constants);
+
+                GLState::Viewport(column * tileSize, row * tileSize, tileSize, tileSize);
+                model.Draw(meshShader, glm::mat4(1.0f));
+            }
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+
+    if (!complete) {
+        std::cout << "Impostor framebuffer is incomplete" << std::endl;
+        GLState::ForgetTexture(texture);
+        glDeleteTextures(1, &texture);
+        return false;
+    }
+
+    std::vector<unsigned char> pixels(size_t(width) * height * 4);
+    GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    DilateColors(pixels, width, height);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Four corners at the sphere center; impostor.vert spreads them out along the camera-facing axes
+    const glm::vec2 corners[4] = { glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f) };
+    MeshData data;
+    for (const glm::vec2& corner : corners) {
+        Vertex vertex = { center, glm::vec3(radius, 0.0f, 0.0f), corner, glm::vec3(0.0f), glm::vec3(0.0f) };
+        data.vertices.push_back(vertex);
+    }
+    data.indices = { 0, 1, 2, 2, 3, 0 };
+    data.bounds = bounds;
+    quad.reset(new Mesh(data));
+
+    atlasTexture = texture;
+    return true;
+}
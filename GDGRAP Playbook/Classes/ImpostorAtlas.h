@@ -0,0 +1,66 @@
+// ImpostorAtlas.h
+
+#ifndef IMPOSTORATLAS_H
+#define IMPOSTORATLAS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include "Mesh.h"
+#include "ShaderProgram.h"
+#include "FrameConstants.h"
+#include "RenderQueue.h"
+
+class Model;
+
+// View grid of every atlas; Shaders/impostor.vert picks tiles with the same numbers, so keep them in sync.
+// Columns are yaw angles all the way around the model, rows are pitch angles from level up to the maximum.
+const int IMPOSTOR_YAW_VIEWS = 16;
+const int IMPOSTOR_PITCH_VIEWS = 3;
+const float IMPOSTOR_MAX_PITCH_DEGREES = 50.0f;
+
+// Pre-rendered views of one Model, drawn in its place once it is only a few pixels tall.
+//
+// Build renders the model with its normal shader from IMPOSTOR_YAW_VIEWS x IMPOSTOR_PITCH_VIEWS directions
+// into one RGBA atlas (orthographic, framed on the bounding sphere, alpha = coverage). At draw time every
+// instance becomes a camera-facing quad at the sphere's center that samples the tile nearest to the
+// direction it is seen from, so a distant car costs two triangles and a texture lookup.
+//
+// The quad is an ordinary Mesh whose four vertices all sit at the model-space sphere center, with the
+// corner in texCoord and the radius in normal.x, so it goes through the RenderQueue (culling, sorting,
+// instancing) like any other mesh; its bounds are the model's. Impostors keep the blend mode the model was
+// submitted with: an opaque model's are alpha-tested in the opaque pass, a translucent model's (the ghost
+// cars) go through the transparent pass with the coverage still cut out.
+class ImpostorAtlas {
+public:
+    // shader draws the quads alpha-tested in the opaque pass (Shaders/impostor.vert and impostor.frag, or
+    // impostor_gbuffer.frag when the opaque pass fills the deferred path's G-buffer);
+    // transparentShader draws the impostors of translucent models into the TransparencyBuffer
+    // (impostor.vert and impostor_transparent.frag). Both may be shared by every atlas.
+    ImpostorAtlas(ShaderProgram& shader, ShaderProgram& transparentShader);
+    ~ImpostorAtlas();
+
+    ImpostorAtlas(const ImpostorAtlas&) = delete;
+    ImpostorAtlas& operator=(const ImpostorAtlas&) = delete;
+
+    // Renders the atlas; the model must have finished loading, textures included. Leaves framebuffer 0
+    // bound with the viewport at the last tile and the frame constants overwritten, so call it before the
+    // frame sets them. lighting supplies the lights the views are shaded with.
+    bool Build(Model& model, ShaderProgram& meshShader, FrameConstantBuffer& frameConstantBuffer,
+        const FrameConstants& lighting, int tileSize = 128);
+    bool IsBuilt() const { return atlasTexture != 0; }
+
+    // The impostor shader for packets submitted with the given blend mode, which is the model's own
+    ShaderProgram& GetShader(BlendMode blend) { return blend == BLEND_TRANSPARENT ? transparentShader : shader; }
+
+    Mesh& GetQuad() { return *quad; }
+    GLuint GetTextureID() const { return atlasTexture; }
+
+private:
+    std::unique_ptr<Mesh> quad;
+    GLuint atlasTexture;
+    ShaderProgram& shader;
+    ShaderProgram& transparentShader;
+};
+
+#endif
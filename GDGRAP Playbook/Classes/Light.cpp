@@ -3,8 +3,8 @@
 Light::Light(const glm::vec3& color, float intensity) : color(color), intensity(intensity) {}
 
 //Point Light 
-PointLight::PointLight(const glm::vec3& pos, const glm::vec3& color, float intensity)
-    : Light(color, intensity), position(pos) {} 
+PointLight::PointLight(const glm::vec3& pos, const glm::vec3& color, float intensity, float range)
+    : Light(color, intensity), position(pos), range(range) {} 
 
 glm::vec3 PointLight::GetPosition() const {
     return position;
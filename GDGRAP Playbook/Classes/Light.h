@@ -19,8 +19,10 @@ public:
 class PointLight : public Light {
 public:
     glm::vec3 position;
+    // Distance at which the light has faded out completely; clustered shading skips it beyond this
+    float range;
 
-    PointLight(const glm::vec3& pos, const glm::vec3& color = glm::vec3(1.0f), float intensity = 1.0f);
+    PointLight(const glm::vec3& pos, const glm::vec3& color = glm::vec3(1.0f), float intensity = 1.0f, float range = 10.0f);
 
     glm::vec3 GetPosition() const override;
 };
@@ -0,0 +1,106 @@
+#include "LiveryArray.h"
+#include "AssetCache.h"
+#include "Model.h"
+#include "GLState.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+//Allocates every layer of the array at the given size and sets its sampling state
+static void AllocateLayers(GLuint texture, int width, int height, int layerCount) {
+    GLState::BindTexture(LIVERY_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+//Fills one layer's top level with white
+static void ClearLayer(int width, int height, int layer) {
+    std::vector<unsigned char> white(size_t(width) * height * 4, 255);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, white.data());
+}
+
+LiveryArray::LiveryArray(const std::vector<LiveryLayer>& layers) : layerCount(static_cast<int>(layers.size())) {
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    texture = std::make_shared<Texture>(textureID);
+
+    for (const LiveryLayer& layer : layers) {
+        hueShifts.push_back(layer.hueShift);
+    }
+
+    AllocateLayers(textureID, 1, 1, std::max(layerCount, 1));
+    for (int layer = 0; layer < layerCount; layer++) {
+        ClearLayer(1, 1, layer);
+    }
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    if (layers.empty()) return;
+
+    // The upload holds the texture, not this object, so a late upload never outlives what it writes to
+    std::shared_ptr<Texture> target = texture;
+    AssetCache::Instance().QueueLoad([target, layers]() -> std::function<void()> {
+        std::shared_ptr<std::vector<ImageData>> images = std::make_shared<std::vector<ImageData>>(layers.size());
+        for (size_t i = 0; i < layers.size(); i++) {
+            ImageData& image = (*images)[i];
+            if (!Model::DecodeTexture(layers[i].filename, image, 4)) continue;
+            if (layers[i].hueShift != 0.0f) ShiftHue(image, layers[i].hueShift);
+        }
+
+        std::vector<std::string> filenames;
+        for (const LiveryLayer& layer : layers) {
+            filenames.push_back(layer.filename);
+        }
+        return [target, images, filenames]() {
+            const ImageData& first = (*images)[0];
+            if (!first.pixels) return;
+
+            int layerCount = static_cast<int>(images->size());
+            AllocateLayers(target->GetID(), first.width, first.height, layerCount);
+            for (int layer = 0; layer < layerCount; layer++) {
+                const ImageData& image = (*images)[layer];
+                if (image.pixels && image.width == first.width && image.height == first.height) {
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, image.width, image.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.get());
+                    continue;
+                }
+                if (image.pixels) {
+                    std::cout << "Livery " << filenames[layer] << " is " << image.width << "x" << image.height << ", not " <<
+                        first.width << "x" << first.height << " like the first layer" << std::endl;
+                }
+                ClearLayer(first.width, first.height, layer);
+            }
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            target->SetReady();
+        };
+    });
+}
+
+float LiveryArray::GetHueShift(float layer) const {
+    int index = static_cast<int>(layer);
+    return layer >= 0.0f && index < layerCount ? hueShifts[index] : 0.0f;
+}
+
+//Rodrigues rotation about (1, 1, 1) / sqrt(3), folded into one 3x3 matrix
+void LiveryArray::ShiftHue(ImageData& image, float degrees) {
+    if (!image.pixels || image.channels < 3) return;
+
+    float angle = glm::radians(degrees);
+    float c = std::cos(angle);
+    float s = std::sin(angle) / std::sqrt(3.0f);
+    float t = (1.0f - c) / 3.0f;
+    glm::mat3 rotation(
+        c + t, t + s, t - s,
+        t - s, c + t, t + s,
+        t + s, t - s, c + t);
+
+    unsigned char* pixel = image.pixels.get();
+    size_t count = size_t(image.width) * image.height;
+    for (size_t i = 0; i < count; i++, pixel += image.channels) {
+        glm::vec3 color = rotation * glm::vec3(pixel[0], pixel[1], pixel[2]);
+        for (int channel = 0; channel < 3; channel++) {
+            pixel[channel] = static_cast<unsigned char>(std::min(std::max(color[channel], 0.0f), 255.0f) + 0.5f);
+        }
+    }
+}
@@ -0,0 +1,51 @@
+// LiveryArray.h
+
+#ifndef LIVERYARRAY_H
+#define LIVERYARRAY_H
+
+#include <glad/glad.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Texture.h"
+
+// Texture unit of the livery array, after GBUFFER_DEPTH_TEXTURE_UNIT
+const GLuint LIVERY_TEXTURE_UNIT = 7;
+
+// One paint job: an image file, optionally repainted
+struct LiveryLayer {
+    std::string filename;
+    float hueShift = 0.0f;      // degrees every color is rotated by around the grey axis; greys keep theirs
+};
+
+// The paint jobs of one car mesh in a single GL_TEXTURE_2D_ARRAY, so cars in different liveries still share
+// one material and go out in one instanced draw. Each instance picks its layer with InstanceData::livery;
+// Shaders/albedo.glsl samples it.
+//
+// The images are decoded on a loader thread through the AssetCache, as RGBA8 with mipmaps, and must all be
+// the size of the first; a layer that is not is reported and left white. Until they arrive every layer is
+// a 1x1 white placeholder.
+//
+// Impostors are baked from the model's base texture, so they reproduce a layer's hue shift (passed per instance
+// in place of the layer) but not a different image; layers meant for cars that turn into impostors should be
+// repaints of the base texture.
+class LiveryArray {
+public:
+    explicit LiveryArray(const std::vector<LiveryLayer>& layers);
+
+    GLuint GetID() const { return texture->GetID(); }
+    int GetLayerCount() const { return layerCount; }
+    // hueShift of the given layer, 0 for -1 or any other index out of range
+    float GetHueShift(float layer) const;
+    bool IsReady() const { return texture->IsReady(); }
+
+    // Rotates every pixel's color around the grey axis of RGB space, which turns the hue and keeps greys
+    static void ShiftHue(ImageData& image, float degrees);
+
+private:
+    std::shared_ptr<Texture> texture;
+    int layerCount;
+    std::vector<float> hueShifts;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+//Maps the file with CreateFileMapping; leaves the object closed if the file is missing or empty
+MappedFile::MappedFile(const std::string& filename) :
+    data(nullptr), size(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr) {
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) return;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) return;
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle) return;
+
+    data = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (data) {
+        size = static_cast<size_t>(fileSize.QuadPart);
+    }
+}
+
+//Unmaps the view and closes both handles
+MappedFile::~MappedFile() {
+    if (data) UnmapViewOfFile(data);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+}
+
+//Reads the attributes from the directory entry; the write time counts 100 ns intervals
+bool MappedFile::StatFile(const std::string& filename, uint64_t& size, uint64_t& modifiedTime) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes)) return false;
+
+    size = (uint64_t(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    modifiedTime = (uint64_t(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+#else
+
+//Maps the file with mmap; leaves the object closed if the file is missing or empty
+MappedFile::MappedFile(const std::string& filename) :
+    data(nullptr), size(0), fileDescriptor(-1) {
+    fileDescriptor = open(filename.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) return;
+
+    struct stat fileInfo;
+    if (fstat(fileDescriptor, &fileInfo) != 0 || fileInfo.st_size == 0) return;
+
+    void* view = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (view != MAP_FAILED) {
+        data = static_cast<const unsigned char*>(view);
+        size = static_cast<size_t>(fileInfo.st_size);
+    }
+}
+
+//Unmaps the view and closes the descriptor
+MappedFile::~MappedFile() {
+    if (data) munmap(const_cast<unsigned char*>(data), size);
+    if (fileDescriptor >= 0) close(fileDescriptor);
+}
+
+//Reads the attributes with stat; the write time counts seconds
+bool MappedFile::StatFile(const std::string& filename, uint64_t& size, uint64_t& modifiedTime) {
+    struct stat fileInfo;
+    if (stat(filename.c_str(), &fileInfo) != 0) return false;
+
+    size = static_cast<uint64_t>(fileInfo.st_size);
+    modifiedTime = static_cast<uint64_t>(fileInfo.st_mtime);
+    return true;
+}
+
+#endif
+
+bool MappedFile::HashFile(const std::string& filename, uint64_t& hash, uint64_t& size) {
+    MappedFile source(filename);
+    if (!source.IsOpen()) return false;
+
+    hash = HashBytes(source.GetData(), source.GetSize());
+    size = source.GetSize();
+    return true;
+}
+
+uint64_t MappedFile::HashBytes(const void* data, size_t size, uint64_t hash) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,42 @@
+// MappedFile.h
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file; the view stays valid until the object is destroyed
+class MappedFile {
+public:
+    MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool IsOpen() const { return data != nullptr; }
+    const unsigned char* GetData() const { return data; }
+    size_t GetSize() const { return size; }
+
+    // Size and last-write time of a file without reading it; the time is in the platform's own units and only
+    // good for comparing against an earlier call. Returns false if the file does not exist.
+    static bool StatFile(const std::string& filename, uint64_t& size, uint64_t& modifiedTime);
+    // FNV-1a hash of a whole file, used by the cookers to detect a changed source; returns false if it cannot be read
+    static bool HashFile(const std::string& filename, uint64_t& hash, uint64_t& size);
+    // FNV-1a over a block of memory; pass a previous result as hash to chain several blocks
+    static uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+private:
+    const unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fileDescriptor;
+#endif
+};
+
+#endif
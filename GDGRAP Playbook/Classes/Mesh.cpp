@@ -0,0 +1,92 @@
+#include "Mesh.h"
+#include "GLState.h"
+
+//Mesh constructor for a placeholder with no geometry in the arena yet
+Mesh::Mesh() : uploaded(false), lodCount(0) {
+    range.baseVertex = 0;
+    range.firstIndex = 0;
+    range.vertexCount = 0;
+    range.indexCount = 0;
+    SetLODs(nullptr, 0);
+}
+
+//Mesh constructor uploads the welded vertices and the index buffer
+Mesh::Mesh(const MeshData& data) : Mesh() {
+    Upload(data);
+}
+
+//Mesh constructor for vertex and index arrays that are already in their final GPU layout
+Mesh::Mesh(const void* vertexData, GLsizei vertexCount, const void* indexData, GLsizei indexCount, GLenum indexType) : Mesh() {
+    Upload(vertexData, vertexCount, indexData, indexCount, indexType);
+}
+
+//Uploads welded vertices and indices
+void Mesh::Upload(const MeshData& data) {
+    bounds = data.bounds;
+    Upload(data.vertices.data(), static_cast<GLsizei>(data.vertices.size()), data.indices.data(), static_cast<GLsizei>(data.indices.size()), GL_UNSIGNED_INT);
+    SetLODs(data.lods.data(), static_cast<int>(data.lods.size()));
+}
+
+//Levels beyond MAX_MESH_LODS are dropped
+void Mesh::SetLODs(const MeshLOD* levels, int count) {
+    lodCount = 0;
+    for (int i = 0; i < count && i < MAX_MESH_LODS; i++) {
+        lods[lodCount++] = levels[i];
+    }
+    if (lodCount == 0) {
+        lods[0].firstIndex = 0;
+        lods[0].indexCount = range.indexCount;
+        lodCount = 1;
+    }
+}
+
+//Copies the geometry into the arena
+void Mesh::Upload(const void* vertexData, GLsizei vertexCount, const void* indexData, GLsizei indexCount, GLenum indexType) {
+    if (uploaded) return;
+
+    range = GeometryArena::Instance().Allocate(vertexData, vertexCount, indexData, indexCount, indexType);
+    uploaded = true;
+    SetLODs(nullptr, 0);
+}
+
+//Mesh destructor returns its range once the last Model referencing it is gone
+Mesh::~Mesh() {
+    if (uploaded) GeometryArena::Instance().Free(range);
+}
+
+//Draws the mesh with whatever program and textures are currently bound; the arena's vertex array is left bound
+void Mesh::Draw(int lod) const {
+    if (!uploaded) return;
+
+    GLState::BindVertexArray(GeometryArena::Instance().GetVertexArray());
+    glDrawElementsBaseVertex(GL_TRIANGLES, GetLOD(lod).indexCount, GL_UNSIGNED_INT, GetIndexOffset(lod), range.baseVertex);
+}
+
+void Mesh::DrawInstanced(const InstanceData* instances, GLsizei count, int lod) {
+    if (!uploaded || count <= 0) return;
+
+    GeometryArena& arena = GeometryArena::Instance();
+    arena.UploadInstances(instances, count);
+    arena.SetInstanceOffset(0);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, GetLOD(lod).indexCount, GL_UNSIGNED_INT, GetIndexOffset(lod), count, range.baseVertex);
+}
+
+//Cofactor matrix of the upper 3x3, which is the inverse transpose scaled by the determinant; the sign of the
+//determinant is put back so mirrored transforms keep their normals facing out, and no division can blow up
+glm::mat3 InstanceData::ComputeNormalMatrix(const glm::mat4& model) {
+    glm::vec3 x(model[0]), y(model[1]), z(model[2]);
+    glm::mat3 cofactor(glm::cross(y, z), glm::cross(z, x), glm::cross(x, y));
+    return glm::dot(x, cofactor[0]) < 0.0f ? -cofactor : cofactor;
+}
+
+void Mesh::SetInstanceAttributes(const InstanceData& instance) {
+    for (GLuint column = 0; column < 4; column++) {
+        glVertexAttrib4fv(INSTANCE_ATTRIBUTE_LOCATION + column, &instance.model[column][0]);
+    }
+    glVertexAttrib4fv(INSTANCE_ATTRIBUTE_LOCATION + 4, &instance.tint[0]);
+    glVertexAttrib1f(INSTANCE_ATTRIBUTE_LOCATION + 5, instance.livery);
+    glm::mat3 normalMatrix = InstanceData::ComputeNormalMatrix(instance.model);
+    for (GLuint column = 0; column < 3; column++) {
+        glVertexAttrib3fv(INSTANCE_ATTRIBUTE_LOCATION + 6 + column, &normalMatrix[column][0]);
+    }
+}
@@ -0,0 +1,114 @@
+// Mesh.h
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Bounds.h"
+#include "GeometryArena.h"
+
+// Interleaved vertex layout shared by the OBJ importer and the vertex shader (14 floats)
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+    glm::vec3 tangent;
+    glm::vec3 bitangent;
+};
+
+static_assert(sizeof(Vertex) == 14 * sizeof(GLfloat), "Vertex must stay tightly packed");
+
+// First attribute location of the per-instance data (model matrix columns at 5-8, tint at 9, livery at 10,
+// normal matrix columns at 11-13)
+const GLuint INSTANCE_ATTRIBUTE_LOCATION = 5;
+
+// Per-instance attributes read by sample.vert
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 tint;    // rgb multiplies the lit color, a is the output alpha
+    float livery = -1.0f;   // layer of the model's LiveryArray, or -1 for its own texture
+    glm::mat3 normalMatrix = glm::mat3(1.0f);   // set from model when the instance is uploaded; callers leave it
+
+    // Transforms normals so they stay perpendicular under non-uniform scale, up to a positive factor the
+    // shader's normalize removes. Computed once per instance here rather than per vertex in sample.vert.
+    static glm::mat3 ComputeNormalMatrix(const glm::mat4& model);
+};
+
+// Number of consecutive attribute locations InstanceData takes from INSTANCE_ATTRIBUTE_LOCATION
+const GLuint INSTANCE_ATTRIBUTE_COUNT = 9;
+
+// Number of detail levels a mesh can carry, the full-detail one included
+const int MAX_MESH_LODS = 4;
+
+// One detail level: a range of the mesh's index buffer over the shared vertices
+struct MeshLOD {
+    GLuint firstIndex;
+    GLsizei indexCount;
+};
+
+// CPU-side indexed geometry produced by the importer
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;    // every LOD's indices, back to back
+    MeshBounds bounds;
+    std::vector<MeshLOD> lods;      // finest first; empty means one level covering all indices
+};
+
+// GPU-side indexed vertex data shared by every Model that uses the same OBJ. The vertices and indices live in
+// the shared GeometryArena; the mesh only owns its range of it.
+class Mesh {
+public:
+    // An empty mesh draws nothing until Upload is called (used as a placeholder while loading)
+    Mesh();
+    Mesh(const MeshData& data);
+    // Uploads already-packed vertex and index arrays (e.g. straight from a mapped .mesh file)
+    Mesh(const void* vertexData, GLsizei vertexCount, const void* indexData, GLsizei indexCount, GLenum indexType);
+    ~Mesh();
+
+    // 16-bit indices are used whenever every vertex is addressable with them (the arena widens them on upload)
+    static GLenum ChooseIndexType(size_t vertexCount) { return vertexCount <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT; }
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    void Upload(const MeshData& data);
+    void Upload(const void* vertexData, GLsizei vertexCount, const void* indexData, GLsizei indexCount, GLenum indexType);
+
+    // The per-instance attributes come from their current generic values (see SetInstanceAttributes)
+    void Draw(int lod = 0) const;
+    // Streams the instances into the arena's instance buffer and draws them with one call
+    void DrawInstanced(const InstanceData* instances, GLsizei count, int lod = 0);
+
+    // Sets the generic attribute values a non-instanced Draw reads for the instance inputs
+    static void SetInstanceAttributes(const InstanceData& instance);
+    bool IsReady() const { return uploaded; }
+
+    GLsizei GetVertexCount() const { return range.vertexCount; }
+    GLsizei GetIndexCount() const { return range.indexCount; }
+    // Position in the arena's buffers; LOD index ranges are relative to GetFirstIndex
+    GLint GetBaseVertex() const { return range.baseVertex; }
+    GLuint GetFirstIndex() const { return range.firstIndex; }
+
+    // Detail levels, finest first; out-of-range levels clamp to the coarsest one
+    int GetLODCount() const { return lodCount; }
+    const MeshLOD& GetLOD(int lod) const { return lods[lod < 0 ? 0 : (lod < lodCount ? lod : lodCount - 1)]; }
+    // Replaces the levels after a raw upload; an empty list means one level covering every index
+    void SetLODs(const MeshLOD* levels, int count);
+
+    // Model-space bounds; Upload(MeshData) takes them from the data, raw uploads have them set separately
+    const MeshBounds& GetBounds() const { return bounds; }
+    void SetBounds(const MeshBounds& bounds) { this->bounds = bounds; }
+
+private:
+    const void* GetIndexOffset(int lod) const { return (void*)(size_t(range.firstIndex + GetLOD(lod).firstIndex) * sizeof(GLuint)); }
+
+    GeometryRange range;
+    bool uploaded;
+    MeshBounds bounds;
+    MeshLOD lods[MAX_MESH_LODS];
+    int lodCount;
+};
+
+#endif
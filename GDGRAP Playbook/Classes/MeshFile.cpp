@@ -0,0 +1,208 @@
+#include "MeshFile.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+static const char MESH_FILE_MAGIC[4] = { 'G', 'D', 'M', 'S' };
+
+//Packs the import options that change the cooked output into a bitmask
+static uint32_t GetImportFlags(const MeshImportOptions& options) {
+    return (options.generateTangents ? 1u : 0u) | (options.generateLODs ? 2u : 0u) | (options.TransformsUVs() ? 4u : 0u);
+}
+
+//Folds the UV transform into 32 bits; a cook is only reused for the atlas layout it was made for
+static uint32_t HashUVTransform(const MeshImportOptions& options) {
+    if (!options.TransformsUVs()) return 0;
+    uint64_t hash = MappedFile::HashBytes(&options.uvTransform, sizeof(options.uvTransform));
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+//Rounds an offset up so the arrays after the header stay 16-byte aligned
+static uint64_t AlignOffset(uint64_t offset) {
+    return (offset + 15) & ~uint64_t(15);
+}
+
+std::string MeshFile::GetCookedPath(const std::string& sourceFilename, const MeshImportOptions& options) {
+    size_t dot = sourceFilename.find_last_of('.');
+    size_t slash = sourceFilename.find_last_of("/\\");
+    std::string base = (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? sourceFilename.substr(0, dot) : sourceFilename;
+    return base + (options.generateTangents ? "" : ".notangents") + (options.generateLODs ? "" : ".nolods") + (options.TransformsUVs() ? ".atlas" : "") + ".mesh";
+}
+
+//Whether an array of size bytes at offset sits aligned, after the header and within the file, without overflowing
+static bool InsideFile(uint64_t offset, uint64_t size, uint64_t fileSize) {
+    return offset >= sizeof(MeshFileHeader) && AlignOffset(offset) == offset && offset <= fileSize && size <= fileSize - offset;
+}
+
+template <typename Index>
+static bool IndicesBelow(const Index* indices, uint32_t count, uint32_t vertexCount) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (indices[i] >= vertexCount) return false;
+    }
+    return true;
+}
+
+//Whether the cook was made from the source as it is now. Matching size and time settle it without reading the
+//source; otherwise it is hashed, and a touched but unchanged source (e.g. after a checkout) has its new time
+//written back, so the next load is settled without the hash again.
+static bool SourceMatches(const std::string& cookedFilename, const std::string& sourceFilename, uint64_t sourceSize, uint64_t sourceTime) {
+    MeshFileHeader header;
+    {
+        std::ifstream in(cookedFilename, std::ios::binary);
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    }
+    if (std::memcmp(header.magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC)) != 0 ||
+        header.version != MESH_FILE_VERSION ||
+        header.sourceSize != sourceSize) {
+        return false;
+    }
+    if (header.sourceTime == sourceTime) return true;
+
+    uint64_t hash = 0, size = 0;
+    if (!MappedFile::HashFile(sourceFilename, hash, size) || hash != header.sourceHash || size != sourceSize) return false;
+
+    std::fstream out(cookedFilename, std::ios::binary | std::ios::in | std::ios::out);
+    out.seekp(offsetof(MeshFileHeader, sourceTime));
+    out.write(reinterpret_cast<const char*>(&sourceTime), sizeof(sourceTime));
+    return true;
+}
+
+std::unique_ptr<CookedMesh> MeshFile::Open(const std::string& cookedFilename, const MeshImportOptions& options,
+    const std::string& sourceFilename, uint64_t sourceSize, uint64_t sourceTime) {
+    if (!SourceMatches(cookedFilename, sourceFilename, sourceSize, sourceTime)) return nullptr;
+
+    std::unique_ptr<MappedFile> file(new MappedFile(cookedFilename));
+    if (!file->IsOpen() || file->GetSize() < sizeof(MeshFileHeader)) return nullptr;
+
+    MeshFileHeader header;
+    std::memcpy(&header, file->GetData(), sizeof(header));
+
+    if (std::memcmp(header.magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC)) != 0 ||
+        header.version != MESH_FILE_VERSION ||
+        header.vertexStride != sizeof(Vertex) ||
+        header.vertexLayout != MESH_LAYOUT_DEFAULT ||
+        header.importFlags != GetImportFlags(options) ||
+        header.uvTransformHash != HashUVTransform(options)) {
+        return nullptr;
+    }
+
+    GLenum indexType = header.indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    uint64_t vertexBytes = uint64_t(header.vertexCount) * header.vertexStride;
+    uint64_t indexBytes = uint64_t(header.indexCount) * header.indexSize;
+    if ((header.indexSize != sizeof(GLushort) && header.indexSize != sizeof(GLuint)) ||
+        header.vertexCount > uint32_t(INT32_MAX) || header.indexCount > uint32_t(INT32_MAX) ||
+        indexType != Mesh::ChooseIndexType(header.vertexCount) ||
+        !InsideFile(header.vertexOffset, vertexBytes, file->GetSize()) ||
+        !InsideFile(header.indexOffset, indexBytes, file->GetSize()) ||
+        header.lodCount == 0 || header.lodCount > MAX_MESH_LODS) {
+        return nullptr;
+    }
+
+    // The levels must tile the index array exactly
+    std::vector<MeshLOD> lods(header.lodCount);
+    uint64_t firstIndex = 0;
+    for (uint32_t i = 0; i < header.lodCount; i++) {
+        lods[i].firstIndex = static_cast<GLuint>(firstIndex);
+        lods[i].indexCount = static_cast<GLsizei>(header.lodIndexCounts[i]);
+        firstIndex += header.lodIndexCounts[i];
+    }
+    if (firstIndex != header.indexCount) return nullptr;
+
+    // Every index must name a vertex of the array, or a draw would read past it
+    const unsigned char* indexData = file->GetData() + header.indexOffset;
+    bool indicesValid = indexType == GL_UNSIGNED_SHORT ?
+        IndicesBelow(reinterpret_cast<const GLushort*>(indexData), header.indexCount, header.vertexCount) :
+        IndicesBelow(reinterpret_cast<const GLuint*>(indexData), header.indexCount, header.vertexCount);
+    if (!indicesValid) return nullptr;
+
+    std::unique_ptr<CookedMesh> cooked(new CookedMesh());
+    cooked->vertexData = file->GetData() + header.vertexOffset;
+    cooked->vertexCount = static_cast<GLsizei>(header.vertexCount);
+    cooked->indexData = indexData;
+    cooked->indexCount = static_cast<GLsizei>(header.indexCount);
+    cooked->indexType = indexType;
+    cooked->bounds.box = BoundingBox(glm::vec3(header.boxMin[0], header.boxMin[1], header.boxMin[2]), glm::vec3(header.boxMax[0], header.boxMax[1], header.boxMax[2]));
+    cooked->bounds.sphere.center = glm::vec3(header.sphereCenter[0], header.sphereCenter[1], header.sphereCenter[2]);
+    cooked->bounds.sphere.radius = header.sphereRadius;
+    cooked->lods.swap(lods);
+    cooked->file = std::move(file);
+    return cooked;
+}
+
+bool MeshFile::Write(const std::string& cookedFilename, const MeshData& data, const MeshImportOptions& options,
+    uint64_t sourceHash, uint64_t sourceSize, uint64_t sourceTime) {
+    GLenum indexType = Mesh::ChooseIndexType(data.vertices.size());
+
+    MeshFileHeader header = {};
+    std::memcpy(header.magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC));
+    header.version = MESH_FILE_VERSION;
+    header.vertexStride = sizeof(Vertex);
+    header.vertexLayout = MESH_LAYOUT_DEFAULT;
+    header.vertexCount = static_cast<uint32_t>(data.vertices.size());
+    header.indexCount = static_cast<uint32_t>(data.indices.size());
+    header.indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    header.importFlags = GetImportFlags(options);
+    header.uvTransformHash = HashUVTransform(options);
+    header.sourceSize = sourceSize;
+    header.sourceHash = sourceHash;
+    header.sourceTime = sourceTime;
+    header.vertexOffset = AlignOffset(sizeof(MeshFileHeader));
+    header.indexOffset = AlignOffset(header.vertexOffset + uint64_t(header.vertexCount) * header.vertexStride);
+    for (int axis = 0; axis < 3; axis++) {
+        header.boxMin[axis] = data.bounds.box.min[axis];
+        header.boxMax[axis] = data.bounds.box.max[axis];
+        header.sphereCenter[axis] = data.bounds.sphere.center[axis];
+    }
+    header.sphereRadius = data.bounds.sphere.radius;
+    if (data.lods.empty()) {
+        header.lodCount = 1;
+        header.lodIndexCounts[0] = header.indexCount;
+    }
+    else {
+        header.lodCount = static_cast<uint32_t>(std::min<size_t>(data.lods.size(), MAX_MESH_LODS));
+        for (uint32_t i = 0; i < header.lodCount; i++) {
+            header.lodIndexCounts[i] = static_cast<uint32_t>(data.lods[i].indexCount);
+        }
+    }
+
+    // Write to a temporary file first so an interrupted cook never leaves a truncated .mesh behind
+    std::string tempFilename = cookedFilename + ".tmp";
+    bool written;
+    {
+        std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cout << "Failed to write cooked mesh: " << cookedFilename << std::endl;
+            return false;
+        }
+
+        const char padding[16] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(padding, header.vertexOffset - sizeof(header));
+        out.write(reinterpret_cast<const char*>(data.vertices.data()), data.vertices.size() * sizeof(Vertex));
+        out.write(padding, header.indexOffset - (header.vertexOffset + data.vertices.size() * sizeof(Vertex)));
+
+        if (indexType == GL_UNSIGNED_SHORT) {
+            std::vector<GLushort> shortIndices(data.indices.begin(), data.indices.end());
+            out.write(reinterpret_cast<const char*>(shortIndices.data()), shortIndices.size() * sizeof(GLushort));
+        }
+        else {
+            out.write(reinterpret_cast<const char*>(data.indices.data()), data.indices.size() * sizeof(GLuint));
+        }
+
+        out.close();
+        written = !out.fail();
+    }
+
+    if (!written) {
+        std::cout << "Failed to write cooked mesh: " << cookedFilename << std::endl;
+        std::remove(tempFilename.c_str());
+        return false;
+    }
+
+    std::remove(cookedFilename.c_str());
+    return std::rename(tempFilename.c_str(), cookedFilename.c_str()) == 0;
+}
@@ -0,0 +1,86 @@
+// MeshFile.h
+
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "AssetCache.h"
+#include "MappedFile.h"
+
+// Bump whenever the header or the payload layout changes; older cooks are then rebuilt
+const uint32_t MESH_FILE_VERSION = 5;
+
+// Attributes present in each cooked vertex
+enum MeshVertexLayout : uint32_t {
+    MESH_LAYOUT_POSITION = 1 << 0,
+    MESH_LAYOUT_NORMAL = 1 << 1,
+    MESH_LAYOUT_TEXCOORD = 1 << 2,
+    MESH_LAYOUT_TANGENT = 1 << 3,
+    MESH_LAYOUT_BITANGENT = 1 << 4,
+    MESH_LAYOUT_DEFAULT = MESH_LAYOUT_POSITION | MESH_LAYOUT_NORMAL | MESH_LAYOUT_TEXCOORD | MESH_LAYOUT_TANGENT | MESH_LAYOUT_BITANGENT
+};
+
+// Fixed 136-byte header at the start of a cooked .mesh file, ending with the importer's model-space bounds,
+// the detail levels, a hash of the UV transform the texture coordinates were cooked with (0 for none) and the
+// source's last-write time. The vertex array and the (already narrowed) index array follow at the given
+// offsets; the levels' index lists are stored back to back in that order.
+struct MeshFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t vertexLayout;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize;
+    uint32_t importFlags;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    float boxMin[3];
+    float boxMax[3];
+    float sphereCenter[3];
+    float sphereRadius;
+    uint32_t lodCount;
+    uint32_t lodIndexCounts[MAX_MESH_LODS];
+    uint32_t uvTransformHash;
+    uint64_t sourceTime;
+};
+
+static_assert(sizeof(MeshFileHeader) == 136, "MeshFileHeader must stay 136 bytes");
+
+// A validated cooked file, kept mapped until its arrays have been uploaded
+struct CookedMesh {
+    std::unique_ptr<MappedFile> file;
+    const void* vertexData;
+    GLsizei vertexCount;
+    const void* indexData;
+    GLsizei indexCount;
+    GLenum indexType;
+    MeshBounds bounds;
+    std::vector<MeshLOD> lods;
+};
+
+// Cooks imported OBJ geometry into a binary .mesh file and loads it back through a memory mapping
+class MeshFile {
+public:
+    // Path of the cooked file for an OBJ, e.g. 3D/Car2.obj -> 3D/Car2.mesh (3D/Car2.notangents.nolods.mesh
+    // when both are turned off, 3D/Car2.atlas.mesh when its UVs point into an atlas)
+    static std::string GetCookedPath(const std::string& sourceFilename, const MeshImportOptions& options);
+
+    // Maps and validates the cooked file without touching GL, so it can run on a loader thread.
+    // Returns null if the file is missing, corrupt, or was cooked from a different source. The source's size
+    // and time (from MappedFile::StatFile) settle that when they match the cook's; only when they do not is
+    // the source read and hashed.
+    static std::unique_ptr<CookedMesh> Open(const std::string& cookedFilename, const MeshImportOptions& options,
+        const std::string& sourceFilename, uint64_t sourceSize, uint64_t sourceTime);
+
+    static bool Write(const std::string& cookedFilename, const MeshData& data, const MeshImportOptions& options,
+        uint64_t sourceHash, uint64_t sourceSize, uint64_t sourceTime);
+};
+
+#endif
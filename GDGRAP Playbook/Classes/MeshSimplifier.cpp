@@ -0,0 +1,409 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+// Fraction of the original triangles each coarser LOD aims for, and the error it may reach as a
+// fraction of the mesh's bounding radius
+static const float LOD_TRIANGLE_RATIOS[MAX_MESH_LODS - 1] = { 0.5f, 0.25f, 0.1f };
+static const float LOD_ERROR_RATIOS[MAX_MESH_LODS - 1] = { 0.01f, 0.03f, 0.08f };
+// A level that keeps more than this fraction of the previous one is not worth a draw-time switch
+static const float LOD_MIN_REDUCTION = 0.9f;
+
+// Border and seam edges get a perpendicular plane with this much more weight than the surface,
+// so sliding along them is cheap but pulling them sideways is not
+static const double BOUNDARY_WEIGHT = 10.0;
+// Collapses that turn a surviving triangle by more than 60 degrees (cosine of old and new normal) are rejected
+static const float MIN_NORMAL_DOT = 0.5f;
+
+// How a position may move: freely, only along its border or seam, or not at all
+enum SimplifyVertexKind : uint8_t {
+    SIMPLIFY_MANIFOLD,
+    SIMPLIFY_BORDER,
+    SIMPLIFY_SEAM,
+    SIMPLIFY_LOCKED
+};
+
+// Symmetric 4x4 quadric stored as its 10 distinct coefficients
+struct Quadric {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+
+    Quadric() : a00(0), a01(0), a02(0), a11(0), a12(0), a22(0), b0(0), b1(0), b2(0), c(0) {}
+
+    //Squared distance to the plane dot(normal, p) + distance = 0, times weight
+    static Quadric FromPlane(const glm::dvec3& normal, double distance, double weight) {
+        Quadric q;
+        q.a00 = weight * normal.x * normal.x;
+        q.a01 = weight * normal.x * normal.y;
+        q.a02 = weight * normal.x * normal.z;
+        q.a11 = weight * normal.y * normal.y;
+        q.a12 = weight * normal.y * normal.z;
+        q.a22 = weight * normal.z * normal.z;
+        q.b0 = weight * normal.x * distance;
+        q.b1 = weight * normal.y * distance;
+        q.b2 = weight * normal.z * distance;
+        q.c = weight * distance * distance;
+        return q;
+    }
+
+    void Add(const Quadric& q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02;
+        a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+    }
+
+    double Evaluate(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double result = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + a11 * y * y + 2.0 * a12 * y * z + a22 * z * z +
+            2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return result > 0.0 ? result : 0.0;
+    }
+};
+
+// A candidate collapse of position from onto position to, valid while both versions still match
+struct Collapse {
+    double cost;
+    uint32_t from, to;
+    uint32_t fromVersion, toVersion;
+
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+// Hash of a position's exact bit pattern, so vertices split only by normal or uv share a position id
+struct PositionHash {
+    size_t operator()(const glm::vec3& p) const {
+        // Adding zero turns -0 into +0, which compares equal and so has to hash equal
+        glm::vec3 canonical = p + glm::vec3(0.0f);
+        uint32_t bits[3];
+        std::memcpy(bits, &canonical, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+static uint64_t EdgeKey(uint32_t a, uint32_t b) {
+    return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+// Working state of one Simplify call
+struct SimplifyState {
+    const std::vector<Vertex>* vertices;
+    std::vector<GLuint> triangles;                      // vertex indices, 3 per triangle
+    std::vector<uint8_t> triangleAlive;
+    std::vector<uint32_t> vertexPosition;               // vertex -> position id
+    std::vector<glm::vec3> positions;
+    std::vector<std::vector<uint32_t>> positionTriangles;
+    std::vector<SimplifyVertexKind> kinds;
+    std::vector<Quadric> quadrics;
+    std::vector<double> quadricWeights;
+    std::vector<uint32_t> versions;
+    std::vector<uint8_t> positionAlive;
+    std::unordered_map<uint64_t, uint8_t> boundaryEdges;    // border or seam edges, keyed by position pair
+
+    uint32_t TrianglePosition(uint32_t triangle, int corner) const { return vertexPosition[triangles[3 * triangle + corner]]; }
+    bool TriangleHas(uint32_t triangle, uint32_t position) const {
+        return TrianglePosition(triangle, 0) == position || TrianglePosition(triangle, 1) == position || TrianglePosition(triangle, 2) == position;
+    }
+};
+
+//Welds positions, classifies every edge and position, and accumulates the surface and boundary quadrics
+static void Prepare(SimplifyState& state, const std::vector<GLuint>& indices) {
+    const std::vector<Vertex>& vertices = *state.vertices;
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> positionIds;
+    state.vertexPosition.resize(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++) {
+        auto inserted = positionIds.emplace(vertices[v].position, static_cast<uint32_t>(state.positions.size()));
+        if (inserted.second) state.positions.push_back(vertices[v].position);
+        state.vertexPosition[v] = inserted.first->second;
+    }
+
+    size_t positionCount = state.positions.size();
+    size_t triangleCount = indices.size() / 3;
+    state.triangles.assign(indices.begin(), indices.begin() + triangleCount * 3);
+    state.triangleAlive.assign(triangleCount, 1);
+    state.positionTriangles.resize(positionCount);
+    state.kinds.assign(positionCount, SIMPLIFY_MANIFOLD);
+    state.quadrics.resize(positionCount);
+    state.quadricWeights.assign(positionCount, 0.0);
+    state.versions.assign(positionCount, 0);
+    state.positionAlive.assign(positionCount, 1);
+
+    // Each positional edge: how many triangles use it, and the vertex pair of the first one to spot seams
+    struct EdgeInfo {
+        uint32_t triangleCount;
+        GLuint vertexA, vertexB;
+        bool seam;
+        uint32_t triangle;
+    };
+    std::unordered_map<uint64_t, EdgeInfo> edges;
+    edges.reserve(indices.size());
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (int corner = 0; corner < 3; corner++) {
+            state.positionTriangles[state.TrianglePosition(t, corner)].push_back(t);
+        }
+
+        const glm::vec3& p0 = state.positions[state.TrianglePosition(t, 0)];
+        const glm::vec3& p1 = state.positions[state.TrianglePosition(t, 1)];
+        const glm::vec3& p2 = state.positions[state.TrianglePosition(t, 2)];
+        glm::dvec3 cross = glm::cross(glm::dvec3(p1 - p0), glm::dvec3(p2 - p0));
+        double length = glm::length(cross);
+        if (length > 0.0) {
+            glm::dvec3 normal = cross / length;
+            double area = 0.5 * length;
+            Quadric plane = Quadric::FromPlane(normal, -glm::dot(normal, glm::dvec3(p0)), area);
+            for (int corner = 0; corner < 3; corner++) {
+                uint32_t position = state.TrianglePosition(t, corner);
+                state.quadrics[position].Add(plane);
+                state.quadricWeights[position] += area;
+            }
+        }
+
+        for (int corner = 0; corner < 3; corner++) {
+            GLuint a = state.triangles[3 * t + corner], b = state.triangles[3 * t + (corner + 1) % 3];
+            uint32_t pa = state.vertexPosition[a], pb = state.vertexPosition[b];
+            if (pa == pb) continue;
+            if (pa > pb) {
+                std::swap(pa, pb);
+                std::swap(a, b);
+            }
+            auto inserted = edges.emplace(EdgeKey(pa, pb), EdgeInfo{ 1, a, b, false, t });
+            if (!inserted.second) {
+                EdgeInfo& edge = inserted.first->second;
+                edge.triangleCount++;
+                if (edge.vertexA != a || edge.vertexB != b) edge.seam = true;
+            }
+        }
+    }
+
+    // Positions on more than two border or seam edges are junctions and stay put, as do both ends of
+    // non-manifold edges and positions that are on a border and a seam at once
+    std::vector<uint8_t> borderEdgeCount(positionCount, 0), seamEdgeCount(positionCount, 0);
+    for (const auto& entry : edges) {
+        uint32_t pa = uint32_t(entry.first >> 32), pb = uint32_t(entry.first & 0xFFFFFFFF);
+        const EdgeInfo& edge = entry.second;
+        if (edge.triangleCount > 2) {
+            state.kinds[pa] = state.kinds[pb] = SIMPLIFY_LOCKED;
+            continue;
+        }
+        bool border = edge.triangleCount == 1;
+        if (!border && !edge.seam) continue;
+
+        std::vector<uint8_t>& counts = border ? borderEdgeCount : seamEdgeCount;
+        counts[pa] = uint8_t(std::min(counts[pa] + 1, 255));
+        counts[pb] = uint8_t(std::min(counts[pb] + 1, 255));
+        state.boundaryEdges[entry.first] = border ? SIMPLIFY_BORDER : SIMPLIFY_SEAM;
+
+        // Plane through the edge, perpendicular to the triangle that owns it
+        const glm::vec3& a = state.positions[pa];
+        const glm::vec3& b = state.positions[pb];
+        uint32_t t = edge.triangle;
+        glm::dvec3 faceNormal = glm::cross(glm::dvec3(state.positions[state.TrianglePosition(t, 1)] - state.positions[state.TrianglePosition(t, 0)]),
+            glm::dvec3(state.positions[state.TrianglePosition(t, 2)] - state.positions[state.TrianglePosition(t, 0)]));
+        glm::dvec3 edgeVector = glm::dvec3(b - a);
+        glm::dvec3 normal = glm::cross(edgeVector, faceNormal);
+        double length = glm::length(normal);
+        if (length <= 0.0) continue;
+        normal /= length;
+        double weight = BOUNDARY_WEIGHT * glm::dot(edgeVector, edgeVector);
+        Quadric plane = Quadric::FromPlane(normal, -glm::dot(normal, glm::dvec3(a)), weight);
+        state.quadrics[pa].Add(plane);
+        state.quadrics[pb].Add(plane);
+    }
+
+    for (size_t p = 0; p < positionCount; p++) {
+        if (state.kinds[p] == SIMPLIFY_LOCKED) continue;
+        bool border = borderEdgeCount[p] > 0, seam = seamEdgeCount[p] > 0;
+        if ((border && seam) || borderEdgeCount[p] > 2 || seamEdgeCount[p] > 2 || borderEdgeCount[p] == 1 || seamEdgeCount[p] == 1) {
+            state.kinds[p] = SIMPLIFY_LOCKED;
+        }
+        else if (border) state.kinds[p] = SIMPLIFY_BORDER;
+        else if (seam) state.kinds[p] = SIMPLIFY_SEAM;
+    }
+}
+
+//Average squared distance the surface around from would move if from collapsed onto to
+static double CollapseCost(const SimplifyState& state, uint32_t from, uint32_t to) {
+    double weight = std::max(state.quadricWeights[from], 1e-12);
+    return state.quadrics[from].Evaluate(state.positions[to]) / weight;
+}
+
+//Queues the collapse if the kind of from allows moving along that edge
+static void PushCandidate(const SimplifyState& state, std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>>& heap, uint32_t from, uint32_t to) {
+    SimplifyVertexKind kind = state.kinds[from];
+    if (kind == SIMPLIFY_LOCKED) return;
+    if (kind != SIMPLIFY_MANIFOLD) {
+        auto edge = state.boundaryEdges.find(EdgeKey(from, to));
+        if (edge == state.boundaryEdges.end() || edge->second != kind) return;
+    }
+    heap.push({ CollapseCost(state, from, to), from, to, state.versions[from], state.versions[to] });
+}
+
+//Works out which vertex at to replaces each vertex at from; fails if a vertex of from has no single
+//partner across the collapsing edge (it would have to jump across a seam)
+static bool MapVertices(const SimplifyState& state, uint32_t from, uint32_t to, std::unordered_map<GLuint, GLuint>& remap) {
+    remap.clear();
+    for (uint32_t t : state.positionTriangles[from]) {
+        if (!state.triangleAlive[t] || !state.TriangleHas(t, to)) continue;
+        GLuint fromVertex = 0, toVertex = 0;
+        for (int corner = 0; corner < 3; corner++) {
+            uint32_t position = state.TrianglePosition(t, corner);
+            if (position == from) fromVertex = state.triangles[3 * t + corner];
+            if (position == to) toVertex = state.triangles[3 * t + corner];
+        }
+        auto inserted = remap.emplace(fromVertex, toVertex);
+        if (!inserted.second && inserted.first->second != toVertex) return false;
+    }
+
+    for (uint32_t t : state.positionTriangles[from]) {
+        if (!state.triangleAlive[t]) continue;
+        for (int corner = 0; corner < 3; corner++) {
+            if (state.TrianglePosition(t, corner) == from && remap.find(state.triangles[3 * t + corner]) == remap.end()) return false;
+        }
+    }
+    return true;
+}
+
+//Rejects collapses that would flip or flatten one of the triangles that survive it
+static bool KeepsOrientation(const SimplifyState& state, uint32_t from, uint32_t to) {
+    for (uint32_t t : state.positionTriangles[from]) {
+        if (!state.triangleAlive[t] || state.TriangleHas(t, to)) continue;
+
+        glm::vec3 before[3], after[3];
+        for (int corner = 0; corner < 3; corner++) {
+            uint32_t position = state.TrianglePosition(t, corner);
+            before[corner] = state.positions[position];
+            after[corner] = position == from ? state.positions[to] : before[corner];
+        }
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+        if (!(lengths > 0.0f) || glm::dot(normalBefore, normalAfter) < MIN_NORMAL_DOT * lengths) return false;
+    }
+    return true;
+}
+
+std::vector<GLuint> MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+    size_t targetIndexCount, float maxError, float* resultError) {
+    if (resultError) *resultError = 0.0f;
+    if (indices.size() <= targetIndexCount) return indices;
+
+    SimplifyState state;
+    state.vertices = &vertices;
+    Prepare(state, indices);
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+    for (uint32_t t = 0; t < state.triangleAlive.size(); t++) {
+        for (int corner = 0; corner < 3; corner++) {
+            uint32_t a = state.TrianglePosition(t, corner), b = state.TrianglePosition(t, (corner + 1) % 3);
+            if (a == b) continue;
+            PushCandidate(state, heap, a, b);
+            PushCandidate(state, heap, b, a);
+        }
+    }
+
+    size_t aliveIndices = state.triangles.size();
+    double maxCost = double(maxError) * double(maxError);
+    double reachedCost = 0.0;
+    std::unordered_map<GLuint, GLuint> remap;
+    std::vector<uint32_t> neighbours;
+
+    while (aliveIndices > targetIndexCount && !heap.empty()) {
+        Collapse collapse = heap.top();
+        heap.pop();
+        if (collapse.cost > maxCost) break;
+
+        uint32_t from = collapse.from, to = collapse.to;
+        if (!state.positionAlive[from] || !state.positionAlive[to] ||
+            collapse.fromVersion != state.versions[from] || collapse.toVersion != state.versions[to]) {
+            continue;
+        }
+        if (!MapVertices(state, from, to, remap) || remap.empty() || !KeepsOrientation(state, from, to)) continue;
+
+        // Triangles on the collapsed edge disappear; the rest move onto the matching vertices of to
+        std::vector<uint32_t>& toTriangles = state.positionTriangles[to];
+        for (uint32_t t : state.positionTriangles[from]) {
+            if (!state.triangleAlive[t]) continue;
+            if (state.TriangleHas(t, to)) {
+                state.triangleAlive[t] = 0;
+                aliveIndices -= 3;
+                continue;
+            }
+            for (int corner = 0; corner < 3; corner++) {
+                GLuint& vertex = state.triangles[3 * t + corner];
+                if (state.vertexPosition[vertex] == from) vertex = remap[vertex];
+            }
+            toTriangles.push_back(t);
+        }
+
+        state.positionTriangles[from].clear();
+        state.positionAlive[from] = 0;
+        state.quadrics[to].Add(state.quadrics[from]);
+        state.quadricWeights[to] += state.quadricWeights[from];
+        state.versions[to]++;
+        reachedCost = std::max(reachedCost, collapse.cost);
+
+        // Drop dead triangles from the list of to, then requeue every edge around it
+        toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [&state](uint32_t t) { return !state.triangleAlive[t]; }), toTriangles.end());
+        neighbours.clear();
+        for (uint32_t t : toTriangles) {
+            for (int corner = 0; corner < 3; corner++) {
+                uint32_t position = state.TrianglePosition(t, corner);
+                if (position != to) neighbours.push_back(position);
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        for (uint32_t neighbour : neighbours) {
+            // A border or seam that ran through from now runs through to
+            auto edge = state.boundaryEdges.find(EdgeKey(from, neighbour));
+            if (edge != state.boundaryEdges.end()) {
+                uint8_t kind = edge->second;
+                state.boundaryEdges[EdgeKey(to, neighbour)] = kind;
+            }
+            state.versions[neighbour]++;
+        }
+        for (uint32_t neighbour : neighbours) {
+            PushCandidate(state, heap, to, neighbour);
+            PushCandidate(state, heap, neighbour, to);
+        }
+    }
+
+    std::vector<GLuint> result;
+    result.reserve(aliveIndices);
+    for (uint32_t t = 0; t < state.triangleAlive.size(); t++) {
+        if (!state.triangleAlive[t]) continue;
+        result.insert(result.end(), state.triangles.begin() + 3 * t, state.triangles.begin() + 3 * t + 3);
+    }
+    if (resultError) *resultError = static_cast<float>(std::sqrt(reachedCost));
+    return result;
+}
+
+void MeshSimplifier::BuildLODs(MeshData& data) {
+    data.lods.clear();
+    MeshLOD base;
+    base.firstIndex = 0;
+    base.indexCount = static_cast<GLsizei>(data.indices.size());
+    data.lods.push_back(base);
+    if (data.indices.empty()) return;
+
+    float radius = std::max(data.bounds.sphere.radius, 0.0f);
+    std::vector<GLuint> previous(data.indices);
+    for (int level = 0; level < MAX_MESH_LODS - 1; level++) {
+        size_t target = size_t(base.indexCount * LOD_TRIANGLE_RATIOS[level]) / 3 * 3;
+        std::vector<GLuint> simplified = Simplify(data.vertices, previous, target, radius * LOD_ERROR_RATIOS[level]);
+        if (simplified.empty() || simplified.size() > previous.size() * LOD_MIN_REDUCTION) break;
+
+        MeshLOD lod;
+        lod.firstIndex = static_cast<GLuint>(data.indices.size());
+        lod.indexCount = static_cast<GLsizei>(simplified.size());
+        data.indices.insert(data.indices.end(), simplified.begin(), simplified.end());
+        data.lods.push_back(lod);
+        previous.swap(simplified);
+    }
+}
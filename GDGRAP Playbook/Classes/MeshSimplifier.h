@@ -0,0 +1,30 @@
+// MeshSimplifier.h
+
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <cstddef>
+#include <vector>
+#include "Mesh.h"
+
+// Quadric error metric edge-collapse simplifier (Garland & Heckbert) for the importer's welded meshes.
+//
+// Collapses are vertex-restricted: a vertex only ever moves onto a neighbouring vertex, so every LOD is
+// just another index list over the original vertex buffer. Positions shared by several vertices (UV or
+// normal seams) only slide along their seam, and each of their vertices is remapped to the vertex on the
+// same side of the seam, so texture coordinates never get stretched across it. Open borders likewise
+// only slide along the border, and seam/border junctions never move.
+class MeshSimplifier {
+public:
+    // Collapses edges, cheapest first, until at most targetIndexCount indices remain or the next collapse
+    // would move the surface by more than maxError (in model units). Returns the remaining triangles;
+    // resultError receives the largest error of the collapses that were made.
+    static std::vector<GLuint> Simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+        size_t targetIndexCount, float maxError, float* resultError = nullptr);
+
+    // Appends up to MAX_MESH_LODS - 1 successively coarser index lists to data.indices and describes every
+    // level, the original included, in data.lods. Levels that barely reduce the previous one are dropped.
+    static void BuildLODs(MeshData& data);
+};
+
+#endif
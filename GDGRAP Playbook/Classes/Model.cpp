@@ -1,170 +1,360 @@
 #include "Model.h"
+#include "MeshSimplifier.h"
+#include "ObjParser.h"
+#include "ThreadPool.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "../stb_image.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "../tiny_obj_loader.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <glm/gtc/type_ptr.hpp>
+#include <unordered_map>
+
+// Screen size (see RenderQueue::GetScreenSize) below which each coarser LOD takes over
+static const float LOD_SCREEN_SIZES[MAX_MESH_LODS - 1] = { 0.25f, 0.12f, 0.05f };
+// Screen size below which a model with an impostor switches from its coarsest LOD to the impostor
+static const float IMPOSTOR_SCREEN_SIZE = 0.03f;
+// Shadow maps are low resolution next to the screen, so casters draw this LOD (clamped to the coarsest)
+static const int SHADOW_CASTER_LOD = 1;
+// A threshold is only crossed once the size is this fraction past it, in either direction
+static const float LOD_HYSTERESIS = 0.15f;
+
+//Options for normal map textures (placeholder is a flat normal instead of white)
+static TextureImportOptions NormalMapOptions() {
+    TextureImportOptions options;
+    options.normalMap = true;
+    return options;
+}
+
+//Options for the pages of a texture atlas; deeper levels would blend neighbouring images
+static TextureImportOptions AtlasOptions(TextureImportOptions options) {
+    options.mipLevels = TEXTURE_ATLAS_MIP_LEVELS;
+    return options;
+}
 
-//Model constructor initializes the models texture, data, and normal mapping
+//Model constructor fetches the shared mesh, texture, and normal map from the asset cache
 Model::Model(const std::string& filename, const std::string& textureFilename, const std::string& normalMapFilename) :
-    textureID(LoadTexture(textureFilename)),
-    normalMapTextureID(normalMapFilename.empty() ? 0 : LoadTexture(normalMapFilename)) {
-    LoadModel(filename);
+    mesh(AssetCache::Instance().GetMesh(filename)),
+    texture(AssetCache::Instance().GetTexture(textureFilename)),
+    normalMap(normalMapFilename.empty() ? nullptr : AssetCache::Instance().GetTexture(normalMapFilename, NormalMapOptions())),
+    impostor(nullptr),
+    liveries(nullptr),
+    lod(0) {
+}
 
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+//Model constructor for an atlas entry; only packed entries get the transformed mesh and the atlas textures
+Model::Model(const TextureAtlas& atlas, const std::string& filename) :
+    impostor(nullptr),
+    liveries(nullptr),
+    lod(0) {
+    AssetCache& cache = AssetCache::Instance();
+    if (atlas.IsPacked(filename)) {
+        MeshImportOptions options;
+        options.uvTransform = atlas.GetUVTransform(filename);
+        mesh = cache.GetMesh(filename, options);
+        texture = cache.GetTexture(atlas.GetTextureFilename(), AtlasOptions(TextureImportOptions()));
+        normalMap = cache.GetTexture(atlas.GetNormalMapFilename(), AtlasOptions(NormalMapOptions()));
+        return;
+    }
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+    const AtlasEntry* entry = atlas.FindEntry(filename);
+    if (!entry) {
+        std::cout << filename << " is not an entry of the texture atlas" << std::endl;
+    }
+    mesh = cache.GetMesh(filename);
+    texture = cache.GetTexture(entry ? entry->textureFilename : "");
+    if (entry && !entry->normalMapFilename.empty()) {
+        normalMap = cache.GetTexture(entry->normalMapFilename, NormalMapOptions());
+    }
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(GLfloat), (void*)0);
-    glEnableVertexAttribArray(0);
+//Draws the model
+void Model::Draw(ShaderProgram& shader, glm::mat4 modelMatrix, const glm::vec4& tint) {
+    InstanceData instance;
+    instance.model = modelMatrix;
+    instance.tint = tint;
+
+    BindMaterial(shader);
+    Mesh::SetInstanceAttributes(instance);
+    mesh->Draw();
+}
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
+void Model::DrawInstanced(ShaderProgram& shader, const InstanceData* instances, GLsizei count) {
+    BindMaterial(shader);
+    mesh->DrawInstanced(instances, count);
+}
 
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 14 * sizeof(GLfloat), (void*)(6 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(2);
+void Model::Submit(RenderQueue& queue, ShaderProgram& shader, const glm::mat4& modelMatrix, BlendMode blend, const glm::vec4& tint) {
+    InstanceData instance;
+    instance.model = modelMatrix;
+    instance.tint = tint;
+    bool useImpostor = HasImpostor();
+    lod = SelectLOD(queue.GetScreenSize(mesh->GetBounds().sphere.Transform(modelMatrix)), lod, mesh->GetLODCount(), useImpostor);
+    if (useImpostor && lod == mesh->GetLODCount()) {
+        instance.livery = GetHueShift(instance.livery);
+        queue.Submit(impostor->GetShader(blend), impostor->GetQuad(), impostor->GetTextureID(), 0, blend, instance);
+        return;
+    }
+    queue.Submit(shader, *mesh, texture->GetID(), GetNormalMapTextureID(), blend, instance, lod, GetLiveriesID());
+}
 
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(GLfloat), (void*)(8 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(3);
+//Splits the instances by LOD and queues one instanced packet per level in use
+void Model::SubmitInstanced(RenderQueue& queue, ShaderProgram& shader, const std::vector<InstanceData>& instances, BlendMode blend) {
+    int lodCount = mesh->GetLODCount();
+    bool useImpostor = HasImpostor();
+    if (lodCount <= 1 && !useImpostor) {
+        queue.SubmitInstanced(shader, *mesh, texture->GetID(), GetNormalMapTextureID(), blend, instances.data(), static_cast<GLsizei>(instances.size()), 0, GetLiveriesID());
+        return;
+    }
 
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(GLfloat), (void*)(11 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(4);
+    instanceLods.resize(instances.size(), 0);
+    for (std::vector<InstanceData>& group : lodInstances) {
+        group.clear();
+    }
+    for (size_t i = 0; i < instances.size(); i++) {
+        float screenSize = queue.GetScreenSize(mesh->GetBounds().sphere.Transform(instances[i].model));
+        instanceLods[i] = static_cast<uint8_t>(SelectLOD(screenSize, instanceLods[i], lodCount, useImpostor));
+        lodInstances[instanceLods[i]].push_back(instances[i]);
+    }
+    for (int level = 0; level < lodCount; level++) {
+        const std::vector<InstanceData>& group = lodInstances[level];
+        if (group.empty()) continue;
+        queue.SubmitInstanced(shader, *mesh, texture->GetID(), GetNormalMapTextureID(), blend, group.data(), static_cast<GLsizei>(group.size()), level, GetLiveriesID());
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // The impostors of every distant instance go out as one more instanced packet
+    std::vector<InstanceData>& distant = lodInstances[lodCount];
+    if (useImpostor && !distant.empty()) {
+        for (InstanceData& instance : distant) {
+            instance.livery = GetHueShift(instance.livery);
+        }
+        queue.SubmitInstanced(impostor->GetShader(blend), impostor->GetQuad(), impostor->GetTextureID(), 0, blend, distant.data(), static_cast<GLsizei>(distant.size()));
+    }
+}
 
+void Model::AddShadowCaster(std::vector<ShadowCaster>& casters, const glm::mat4& modelMatrix) const {
+    ShadowCaster caster;
+    caster.mesh = mesh.get();
+    caster.model = modelMatrix;
+    caster.lod = SHADOW_CASTER_LOD;
+    casters.push_back(caster);
 }
 
-//Model desctructor initializes the models texture, data, and normal mapping
-Model::~Model() {
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteTextures(1, &textureID);
-    if (normalMapTextureID) {
-        glDeleteTextures(1, &normalMapTextureID);
+int Model::SelectLOD(float screenSize, int current, int lodCount, bool impostor) {
+    int lastLevel = impostor ? lodCount : lodCount - 1;
+    int level = std::min(std::max(current, 0), lastLevel);
+    // Screen size below which the level after the given one takes over
+    auto threshold = [lodCount](int level) { return level + 1 < lodCount ? LOD_SCREEN_SIZES[level] : IMPOSTOR_SCREEN_SIZE; };
+    while (level < lastLevel && screenSize < threshold(level) * (1.0f - LOD_HYSTERESIS)) {
+        level++;
+    }
+    while (level > 0 && screenSize > threshold(level - 1) * (1.0f + LOD_HYSTERESIS)) {
+        level--;
     }
+    return level;
 }
 
-//Draws the model
-void Model::Draw(GLuint shaderProgram, glm::mat4 modelMatrix) {
-    glUseProgram(shaderProgram);
+//Binds the program and this model's textures
+void Model::BindMaterial(ShaderProgram& shader) {
+    const ShaderProgram::MeshUniforms& uniforms = shader.GetMeshUniforms();
+    shader.Use();
+
+    GLState::BindTexture(0, GL_TEXTURE_2D, texture->GetID());
+    shader.SetInt(uniforms.tex0, 0);
+
+    if (normalMap) {
+        GLState::BindTexture(1, GL_TEXTURE_2D, normalMap->GetID());
+        shader.SetInt(uniforms.normalMap, 1);
+    }
+
+    // Always pointed at its own unit, since a sampler array left on unit 0 would clash with tex0
+    shader.SetInt(uniforms.liveries, static_cast<GLint>(LIVERY_TEXTURE_UNIT));
+    if (liveries) {
+        GLState::BindTexture(LIVERY_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, liveries->GetID());
+    }
+}
 
-    GLuint modelLoc = glGetUniformLocation(shaderProgram, "MVP");
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+// A corner is welded with an existing vertex when its position, normal and uv match exactly
+struct VertexKey {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glUniform1i(glGetUniformLocation(shaderProgram, "tex0"), 0);
+    bool operator==(const VertexKey& other) const {
+        return position == other.position && normal == other.normal && texCoord == other.texCoord;
+    }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        // FNV-1a over the float bits; adding zero turns -0 into +0, which compares equal and so has to hash equal
+        VertexKey canonical = { key.position + glm::vec3(0.0f), key.normal + glm::vec3(0.0f), key.texCoord + glm::vec2(0.0f) };
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&canonical);
+        size_t hash = 2166136261u;
+        for (size_t i = 0; i < sizeof(VertexKey); i++) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+};
+
+//Reads the attributes of one face corner, tolerating OBJs without normals or uvs
+static VertexKey ReadCorner(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index) {
+    VertexKey key = {};
+    key.position = glm::vec3(attrib.vertices[3 * index.vertex_index + 0], attrib.vertices[3 * index.vertex_index + 1], attrib.vertices[3 * index.vertex_index + 2]);
+    if (index.normal_index >= 0) {
+        key.normal = glm::vec3(attrib.normals[3 * index.normal_index + 0], attrib.normals[3 * index.normal_index + 1], attrib.normals[3 * index.normal_index + 2]);
+    }
+    if (index.texcoord_index >= 0) {
+        key.texCoord = glm::vec2(attrib.texcoords[2 * index.texcoord_index + 0], attrib.texcoords[2 * index.texcoord_index + 1]);
+    }
+    return key;
+}
 
-    if (normalMapTextureID) {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, normalMapTextureID);
-        glUniform1i(glGetUniformLocation(shaderProgram, "normalMap"), 1);
+//Box around every vertex, and a sphere centered on the box that reaches the farthest vertex
+static MeshBounds ComputeBounds(const std::vector<Vertex>& vertices) {
+    MeshBounds bounds;
+    for (const Vertex& vertex : vertices) {
+        bounds.box.Expand(vertex.position);
     }
+    if (bounds.box.IsEmpty()) return bounds;
 
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 14);
-    glBindVertexArray(0);
+    float radiusSquared = 0.0f;
+    bounds.sphere.center = bounds.box.GetCenter();
+    for (const Vertex& vertex : vertices) {
+        glm::vec3 offset = vertex.position - bounds.sphere.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    bounds.sphere.radius = std::sqrt(radiusSquared);
+    return bounds;
 }
 
-//Loads the model
-void Model::LoadModel(const std::string& filename) {
+//Loads the model, welding identical corners into a shared vertex set with an index buffer.
+//Parsing and the per-triangle tangent pass run on the shared thread pool; welding stays serial and
+//accumulates the tangents of every triangle using a vertex.
+void Model::LoadModel(const std::string& filename, const MeshImportOptions& options, MeshData& data) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
+    std::string err;
+    ThreadPool& pool = ThreadPool::Shared();
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str())) {
+    if (!LoadObjParallel(filename, pool, attrib, shapes, err)) {
         std::cerr << err << std::endl;
         return;
     }
 
-    std::vector<glm::vec3> tangents;
-    std::vector<glm::vec3> bitangents;
-
+    // Flatten every shape into one triangle list so the work splits evenly across threads
+    std::vector<const tinyobj::index_t*> triangles;
     for (const auto& shape : shapes) {
-        for (size_t i = 0; i < shape.mesh.indices.size(); i += 3) {
-            tinyobj::index_t idx1 = shape.mesh.indices[i];
-            tinyobj::index_t idx2 = shape.mesh.indices[i + 1];
-            tinyobj::index_t idx3 = shape.mesh.indices[i + 2];
-
-            glm::vec3 v1 = { attrib.vertices[3 * idx1.vertex_index + 0], attrib.vertices[3 * idx1.vertex_index + 1], attrib.vertices[3 * idx1.vertex_index + 2] };
-            glm::vec3 v2 = { attrib.vertices[3 * idx2.vertex_index + 0], attrib.vertices[3 * idx2.vertex_index + 1], attrib.vertices[3 * idx2.vertex_index + 2] };
-            glm::vec3 v3 = { attrib.vertices[3 * idx3.vertex_index + 0], attrib.vertices[3 * idx3.vertex_index + 1], attrib.vertices[3 * idx3.vertex_index + 2] };
-
-            glm::vec2 uv1 = { attrib.texcoords[2 * idx1.texcoord_index + 0], attrib.texcoords[2 * idx1.texcoord_index + 1] };
-            glm::vec2 uv2 = { attrib.texcoords[2 * idx2.texcoord_index + 0], attrib.texcoords[2 * idx2.texcoord_index + 1] };
-            glm::vec2 uv3 = { attrib.texcoords[2 * idx3.texcoord_index + 0], attrib.texcoords[2 * idx3.texcoord_index + 1] };
-
-            glm::vec3 deltaPos1 = v2 - v1;
-            glm::vec3 deltaPos2 = v3 - v1;
-            glm::vec2 deltaUV1 = uv2 - uv1;
-            glm::vec2 deltaUV2 = uv3 - uv1;
-
-            float r = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-            glm::vec3 tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
-            glm::vec3 bitangent = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * r;
-
-            tangents.push_back(tangent);
-            tangents.push_back(tangent);
-            tangents.push_back(tangent);
-            bitangents.push_back(bitangent);
-            bitangents.push_back(bitangent);
-            bitangents.push_back(bitangent);
+        for (size_t i = 0; i + 2 < shape.mesh.indices.size(); i += 3) {
+            triangles.push_back(&shape.mesh.indices[i]);
         }
+    }
 
-        for (const auto& index : shape.mesh.indices) {
-            vertices.push_back(attrib.vertices[3 * index.vertex_index + 0]);
-            vertices.push_back(attrib.vertices[3 * index.vertex_index + 1]);
-            vertices.push_back(attrib.vertices[3 * index.vertex_index + 2]);
+    std::vector<VertexKey> corners(triangles.size() * 3);
+    std::vector<glm::vec3> tangents(triangles.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> bitangents(triangles.size(), glm::vec3(0.0f));
+
+    pool.ParallelFor(triangles.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            VertexKey* corner = &corners[3 * t];
+            corner[0] = ReadCorner(attrib, triangles[t][0]);
+            corner[1] = ReadCorner(attrib, triangles[t][1]);
+            corner[2] = ReadCorner(attrib, triangles[t][2]);
+
+            if (!options.generateTangents) continue;
+
+            glm::vec3 deltaPos1 = corner[1].position - corner[0].position;
+            glm::vec3 deltaPos2 = corner[2].position - corner[0].position;
+            glm::vec2 deltaUV1 = corner[1].texCoord - corner[0].texCoord;
+            glm::vec2 deltaUV2 = corner[2].texCoord - corner[0].texCoord;
+
+            float det = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
+            if (det != 0.0f) {
+                float r = 1.0f / det;
+                tangents[t] = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
+                bitangents[t] = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * r;
+            }
+        }
+    });
+
+    std::unordered_map<VertexKey, GLuint, VertexKeyHash> lookup;
+    lookup.reserve(corners.size());
+    data.vertices.reserve(corners.size() / 3);
+    data.indices.reserve(corners.size());
+
+    for (size_t c = 0; c < corners.size(); c++) {
+        const VertexKey& corner = corners[c];
+        auto inserted = lookup.emplace(corner, static_cast<GLuint>(data.vertices.size()));
+        if (inserted.second) {
+            Vertex vertex = { corner.position, corner.normal, corner.texCoord, glm::vec3(0.0f), glm::vec3(0.0f) };
+            data.vertices.push_back(vertex);
+        }
 
-            vertices.push_back(attrib.normals[3 * index.normal_index + 0]);
-            vertices.push_back(attrib.normals[3 * index.normal_index + 1]);
-            vertices.push_back(attrib.normals[3 * index.normal_index + 2]);
+        GLuint index = inserted.first->second;
+        data.vertices[index].tangent += tangents[c / 3];
+        data.vertices[index].bitangent += bitangents[c / 3];
+        data.indices.push_back(index);
+    }
 
-            vertices.push_back(attrib.texcoords[2 * index.texcoord_index + 0]);
-            vertices.push_back(attrib.texcoords[2 * index.texcoord_index + 1]);
+    for (Vertex& vertex : data.vertices) {
+        if (glm::dot(vertex.tangent, vertex.tangent) > 0.0f) {
+            vertex.tangent = glm::normalize(vertex.tangent);
+        }
+        if (glm::dot(vertex.bitangent, vertex.bitangent) > 0.0f) {
+            vertex.bitangent = glm::normalize(vertex.bitangent);
+        }
+    }
 
-            vertices.push_back(tangents[index.vertex_index].x);
-            vertices.push_back(tangents[index.vertex_index].y);
-            vertices.push_back(tangents[index.vertex_index].z);
+    data.bounds = ComputeBounds(data.vertices);
+    if (options.generateLODs) MeshSimplifier::BuildLODs(data);
 
-            vertices.push_back(bitangents[index.vertex_index].x);
-            vertices.push_back(bitangents[index.vertex_index].y);
-            vertices.push_back(bitangents[index.vertex_index].z);
+    // Last, so the tangents and the simplifier's seam checks see the mesh's own UVs; LODs share the vertices
+    if (options.TransformsUVs()) {
+        glm::vec2 scale(options.uvTransform.x, options.uvTransform.y);
+        glm::vec2 offset(options.uvTransform.z, options.uvTransform.w);
+        for (Vertex& vertex : data.vertices) {
+            vertex.texCoord = vertex.texCoord * scale + offset;
         }
     }
 }
 
-//Loads the texture of the model
-GLuint Model::LoadTexture(const std::string& filename) {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+//Decodes an image file into memory; safe to call from a loader thread
+bool Model::DecodeTexture(const std::string& filename, ImageData& image, int desiredChannels) {
+    unsigned char* data = stbi_load(filename.c_str(), &image.width, &image.height, &image.channels, desiredChannels);
+    if (!data) {
+        std::cout << "Failed to load texture: " << filename << std::endl;
+        return false;
+    }
+    if (desiredChannels) {
+        image.channels = desiredChannels;
+    }
+    image.pixels = std::shared_ptr<unsigned char>(data, stbi_image_free);
+    return true;
+}
+
+//Uploads decoded pixels into the given texture object and sets its sampling state
+void Model::UploadTexture(GLuint textureID, const ImageData& image, const TextureImportOptions& options) {
+    GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, options.wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, options.wrapMode);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
-    if (data) {
-        if (nrChannels == 3) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        }
-        else if (nrChannels == 4) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        }
-        glGenerateMipmap(GL_TEXTURE_2D);
+    if (!image.pixels) return;
+
+    if (image.channels == 3) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.pixels.get());
     }
-    else {
-        std::cout << "Failed to load texture: " << filename << std::endl;
+    else if (image.channels == 4) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.get());
+    }
+    if (options.generateMipmaps) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        // glGenerateMipmap stops at the max level, so a capped chain is never built past it
+        if (options.mipLevels > 0) glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, options.mipLevels - 1);
+        glGenerateMipmap(GL_TEXTURE_2D);
     }
-    stbi_image_free(data);
-    return textureID;
 }
@@ -5,26 +5,87 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
+#include "AssetCache.h"
+#include "ShaderProgram.h"
+#include "RenderQueue.h"
+#include "ImpostorAtlas.h"
+#include "CascadedShadowMap.h"
+#include "LiveryArray.h"
+#include "TextureAtlas.h"
 
+// A cheap drawable instance; the mesh and textures are shared through the AssetCache
 class Model {
 public:
     Model(const std::string& filename, const std::string& textureFilename, const std::string& normalMapFilename = "");
-    ~Model();
+    // A prop from the atlas: the mesh's UVs are moved into its rect and it shares the atlas textures with
+    // every other packed prop. One the atlas left out loads the entry's own textures instead.
+    Model(const TextureAtlas& atlas, const std::string& filename);
 
-    void Draw(GLuint shaderProgram, glm::mat4 modelMatrix);
+    // modelMatrix is the world transform; view and projection come from the FrameConstants buffer
+    void Draw(ShaderProgram& shader, glm::mat4 modelMatrix, const glm::vec4& tint = glm::vec4(1.0f));
+    // Draws every instance of this model's mesh and textures with a single instanced call
+    void DrawInstanced(ShaderProgram& shader, const InstanceData* instances, GLsizei count);
+    void DrawInstanced(ShaderProgram& shader, const std::vector<InstanceData>& instances) {
+        DrawInstanced(shader, instances.data(), static_cast<GLsizei>(instances.size()));
+    }
 
-    GLuint GetTextureID() const { return textureID; }
-    GLuint GetNormalMapTextureID() const { return normalMapTextureID; }
+    // Records the draw in the queue instead of issuing it; the queue orders and executes it on Flush.
+    // The mesh LOD follows the model's size on screen, with hysteresis so it does not flicker at a threshold.
+    // A Model keeps one LOD for Submit, so draw a model placed several times through SubmitInstanced,
+    // which keeps one per instance (instances are matched by their index in the array).
+    void Submit(RenderQueue& queue, ShaderProgram& shader, const glm::mat4& modelMatrix, BlendMode blend = BLEND_OPAQUE, const glm::vec4& tint = glm::vec4(1.0f));
+    void SubmitInstanced(RenderQueue& queue, ShaderProgram& shader, const std::vector<InstanceData>& instances, BlendMode blend = BLEND_OPAQUE);
+
+    // Draws instances that have shrunk below a few pixels as billboards from the atlas instead of the mesh.
+    // The atlas is not owned and only takes over once it has been built.
+    void SetImpostor(ImpostorAtlas* impostor) { this->impostor = impostor; }
+    bool HasImpostor() const { return impostor && impostor->IsBuilt(); }
+
+    // Lets instances pick a paint job from the array with InstanceData::livery instead of using the model's
+    // texture. The array is not owned; impostors keep the baked base texture, with the layer's hue shift.
+    void SetLiveries(LiveryArray* liveries) { this->liveries = liveries; }
+
+    // Steps current towards the level for screenSize (see RenderQueue::GetScreenSize), only crossing a
+    // threshold once the size is past it by the hysteresis margin. With impostor set, level lodCount
+    // stands for the impostor and follows the coarsest mesh level.
+    static int SelectLOD(float screenSize, int current, int lodCount, bool impostor = false);
+
+    // Adds this model at modelMatrix to the shadow casters, using a coarser LOD when the mesh has one
+    void AddShadowCaster(std::vector<ShadowCaster>& casters, const glm::mat4& modelMatrix) const;
+
+    // Bounds are only known once the mesh has finished loading
+    bool IsReady() const { return mesh->IsReady(); }
+    const MeshBounds& GetBounds() const { return mesh->GetBounds(); }
+
+    GLuint GetTextureID() const { return texture->GetID(); }
+    GLuint GetNormalMapTextureID() const { return normalMap ? normalMap->GetID() : 0; }
+    GLuint GetLiveriesID() const { return liveries ? liveries->GetID() : 0; }
+
+    // Loaders used by the AssetCache on a cache miss; the Load/Decode steps never touch GL
+    static void LoadModel(const std::string& filename, const MeshImportOptions& options, MeshData& data);
+    // desiredChannels = 0 keeps the file's own channel count
+    static bool DecodeTexture(const std::string& filename, ImageData& image, int desiredChannels = 0);
+    static void UploadTexture(GLuint textureID, const ImageData& image, const TextureImportOptions& options);
 
 private:
-    std::vector<GLfloat> vertices;
-    GLuint VAO, VBO, EBO;
-    GLuint textureID, normalMapTextureID;
+    void BindMaterial(ShaderProgram& shader);
+    // What impostor instances carry in place of a livery layer (see Shaders/impostor.vert)
+    float GetHueShift(float livery) const { return liveries ? liveries->GetHueShift(livery) : 0.0f; }
+
+    std::shared_ptr<Mesh> mesh;
+    std::shared_ptr<Texture> texture, normalMap;
+
+    ImpostorAtlas* impostor;
+    LiveryArray* liveries;
 
-    void LoadModel(const std::string& filename);
-    GLuint LoadTexture(const std::string& filename);
+    // LOD hysteresis state of Submit and of each SubmitInstanced instance; the extra group is the impostor
+    int lod;
+    std::vector<uint8_t> instanceLods;
+    std::vector<InstanceData> lodInstances[MAX_MESH_LODS + 1];
 };
 
-#endif
\ No newline at end of file
+#endif
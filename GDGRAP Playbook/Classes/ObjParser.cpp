@@ -0,0 +1,305 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Chunks smaller than this are not worth a task of their own
+static const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+// A face corner as parsed inside a chunk. Indices are 0-based; those written as negative (relative)
+// indices in the file are local to the chunk and flagged so the merge can rebase them.
+struct ObjCorner {
+    int vertex, texcoord, normal;
+    unsigned char relative;
+};
+
+enum ObjCornerRelative : unsigned char {
+    RELATIVE_VERTEX = 1 << 0,
+    RELATIVE_TEXCOORD = 1 << 1,
+    RELATIVE_NORMAL = 1 << 2
+};
+
+// Geometry parsed from one chunk
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+    std::vector<tinyobj::real_t> vertices;
+    std::vector<tinyobj::real_t> normals;
+    std::vector<tinyobj::real_t> texcoords;
+    std::vector<ObjCorner> indices;
+    std::string err;
+};
+
+static bool IsSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Powers of ten a double holds exactly
+static const double EXACT_POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+// Significant digits a 64-bit mantissa holds; later ones are far below float precision
+static const int MAX_MANTISSA_DIGITS = 19;
+
+//Parses a decimal float with optional sign, fraction and exponent, advancing the cursor.
+//The digits are gathered into one integer mantissa and scaled by a single power of ten, so the only
+//rounding is that one multiply or divide (exact when both fit a double, as they do for any OBJ coordinate).
+static tinyobj::real_t ParseReal(const char*& p, const char* end) {
+    while (p < end && IsSpace(*p)) p++;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) digits++;
+        }
+        else {
+            exponent++;
+        }
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < MAX_MANTISSA_DIGITS) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            p++;
+        }
+        int written = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (written < 10000) written = written * 10 + (*p - '0');
+            p++;
+        }
+        exponent += negativeExponent ? -written : written;
+    }
+
+    double value = static_cast<double>(mantissa);
+    int magnitude = std::abs(exponent);
+    double power = 1.0;
+    while (magnitude > 22) {
+        power *= EXACT_POWERS_OF_TEN[22];
+        magnitude -= 22;
+    }
+    power *= EXACT_POWERS_OF_TEN[magnitude];
+    value = exponent < 0 ? value / power : value * power;
+    return static_cast<tinyobj::real_t>(negative ? -value : value);
+}
+
+//Parses a signed integer, advancing the cursor; returns false if there are no digits
+static bool ParseInt(const char*& p, const char* end, int& value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p >= end || *p < '0' || *p > '9') return false;
+
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    if (negative) value = -value;
+    return true;
+}
+
+//Converts a 1-based or negative OBJ index to 0-based, flagging relative ones
+static int ConvertIndex(int index, size_t localCount, unsigned char flag, unsigned char& relative) {
+    if (index > 0) return index - 1;
+    relative |= flag;
+    return static_cast<int>(localCount) + index;
+}
+
+//Parses one "v", "v/vt", "v//vn" or "v/vt/vn" face element; missing attributes are -1
+static bool ParseFaceElement(const char*& p, const char* end, const ObjChunk& chunk, ObjCorner& out) {
+    int value;
+    out.texcoord = out.normal = -1;
+    out.relative = 0;
+
+    if (!ParseInt(p, end, value) || value == 0) return false;
+    out.vertex = ConvertIndex(value, chunk.vertices.size() / 3, RELATIVE_VERTEX, out.relative);
+
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/') {
+            if (!ParseInt(p, end, value) || value == 0) return false;
+            out.texcoord = ConvertIndex(value, chunk.texcoords.size() / 2, RELATIVE_TEXCOORD, out.relative);
+        }
+        if (p < end && *p == '/') {
+            p++;
+            if (!ParseInt(p, end, value) || value == 0) return false;
+            out.normal = ConvertIndex(value, chunk.normals.size() / 3, RELATIVE_NORMAL, out.relative);
+        }
+    }
+    return true;
+}
+
+//Parses every line of one chunk into its local attribute and index arrays
+static void ParseChunk(ObjChunk& chunk) {
+    const char* p = chunk.begin;
+    const char* end = chunk.end;
+    std::vector<ObjCorner> polygon;
+
+    while (p < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!lineEnd) lineEnd = end;
+
+        while (p < lineEnd && IsSpace(*p)) p++;
+
+        if (lineEnd - p >= 2 && p[0] == 'v' && IsSpace(p[1])) {
+            p += 2;
+            for (int i = 0; i < 3; i++) chunk.vertices.push_back(ParseReal(p, lineEnd));
+        }
+        else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2])) {
+            p += 3;
+            for (int i = 0; i < 3; i++) chunk.normals.push_back(ParseReal(p, lineEnd));
+        }
+        else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't' && IsSpace(p[2])) {
+            p += 3;
+            for (int i = 0; i < 2; i++) chunk.texcoords.push_back(ParseReal(p, lineEnd));
+        }
+        else if (lineEnd - p >= 2 && p[0] == 'f' && IsSpace(p[1])) {
+            p += 2;
+            polygon.clear();
+            for (;;) {
+                while (p < lineEnd && IsSpace(*p)) p++;
+                if (p >= lineEnd || *p == '\r' || *p == '#') break;
+
+                ObjCorner element;
+                if (!ParseFaceElement(p, lineEnd, chunk, element)) {
+                    chunk.err = "Malformed face element in OBJ";
+                    return;
+                }
+                polygon.push_back(element);
+            }
+
+            // Fan triangulation around the first corner
+            for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                chunk.indices.push_back(polygon[0]);
+                chunk.indices.push_back(polygon[i]);
+                chunk.indices.push_back(polygon[i + 1]);
+            }
+        }
+
+        p = lineEnd + 1;
+    }
+}
+
+//Rebases a chunk-local index onto the merged attribute array when it was relative
+static int ResolveIndex(int index, bool relative, size_t chunkBase) {
+    return relative ? static_cast<int>(chunkBase) + index : index;
+}
+
+bool ParseObjParallel(const char* text, size_t size, ThreadPool& pool, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes, std::string& err) {
+    size_t threadCount = pool.GetWorkerCount() + 1;
+    size_t chunkCount = std::max<size_t>(1, std::min(threadCount * 4, size / MIN_CHUNK_SIZE));
+
+    // Cut the text into chunks that each end just after a newline
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* textEnd = text + size;
+    const char* chunkBegin = text;
+    for (size_t i = 0; i < chunkCount; i++) {
+        const char* chunkEnd = i + 1 == chunkCount ? textEnd : std::max(chunkBegin, text + size * (i + 1) / chunkCount);
+        if (chunkEnd < textEnd) {
+            const char* newline = static_cast<const char*>(memchr(chunkEnd, '\n', textEnd - chunkEnd));
+            chunkEnd = newline ? newline + 1 : textEnd;
+        }
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    pool.ParallelFor(chunkCount, 1, [&chunks](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) ParseChunk(chunks[i]);
+    });
+
+    // Prefix sums give each chunk its offset into the merged arrays
+    std::vector<size_t> vertexBase(chunkCount), normalBase(chunkCount), texcoordBase(chunkCount), indexBase(chunkCount);
+    size_t vertexTotal = 0, normalTotal = 0, texcoordTotal = 0, indexTotal = 0;
+    for (size_t i = 0; i < chunkCount; i++) {
+        if (!chunks[i].err.empty()) {
+            err = chunks[i].err;
+            return false;
+        }
+        vertexBase[i] = vertexTotal;
+        normalBase[i] = normalTotal;
+        texcoordBase[i] = texcoordTotal;
+        indexBase[i] = indexTotal;
+        vertexTotal += chunks[i].vertices.size();
+        normalTotal += chunks[i].normals.size();
+        texcoordTotal += chunks[i].texcoords.size();
+        indexTotal += chunks[i].indices.size();
+    }
+
+    attrib.vertices.resize(vertexTotal);
+    attrib.normals.resize(normalTotal);
+    attrib.texcoords.resize(texcoordTotal);
+    shapes.assign(1, tinyobj::shape_t());
+    shapes[0].name = "default";
+    std::vector<tinyobj::index_t>& indices = shapes[0].mesh.indices;
+    indices.resize(indexTotal);
+    shapes[0].mesh.num_face_vertices.assign(indexTotal / 3, 3);
+
+    std::atomic<bool> valid(true);
+    pool.ParallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const ObjChunk& chunk = chunks[i];
+            std::copy(chunk.vertices.begin(), chunk.vertices.end(), attrib.vertices.begin() + vertexBase[i]);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), attrib.normals.begin() + normalBase[i]);
+            std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib.texcoords.begin() + texcoordBase[i]);
+
+            for (size_t j = 0; j < chunk.indices.size(); j++) {
+                const ObjCorner& corner = chunk.indices[j];
+                tinyobj::index_t index;
+                index.vertex_index = ResolveIndex(corner.vertex, (corner.relative & RELATIVE_VERTEX) != 0, vertexBase[i] / 3);
+                index.texcoord_index = ResolveIndex(corner.texcoord, (corner.relative & RELATIVE_TEXCOORD) != 0, texcoordBase[i] / 2);
+                index.normal_index = ResolveIndex(corner.normal, (corner.relative & RELATIVE_NORMAL) != 0, normalBase[i] / 3);
+
+                bool texcoordValid = corner.texcoord == -1 || (index.texcoord_index >= 0 && index.texcoord_index < static_cast<int>(texcoordTotal / 2));
+                bool normalValid = corner.normal == -1 || (index.normal_index >= 0 && index.normal_index < static_cast<int>(normalTotal / 3));
+                if (index.vertex_index < 0 || index.vertex_index >= static_cast<int>(vertexTotal / 3) || !texcoordValid || !normalValid) {
+                    valid = false;
+                }
+                indices[indexBase[i] + j] = index;
+            }
+        }
+    });
+
+    if (!valid) {
+        err = "Face index out of range";
+        return false;
+    }
+    return true;
+}
+
+bool LoadObjParallel(const std::string& filename, ThreadPool& pool, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes, std::string& err) {
+    MappedFile file(filename);
+    if (!file.IsOpen()) {
+        err = "Cannot open file: " + filename;
+        return false;
+    }
+    return ParseObjParallel(reinterpret_cast<const char*>(file.GetData()), file.GetSize(), pool, attrib, shapes, err);
+}
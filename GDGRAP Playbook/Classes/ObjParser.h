@@ -0,0 +1,20 @@
+// ObjParser.h
+
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "../tiny_obj_loader.h"
+#include "ThreadPool.h"
+
+// Parses OBJ text in line-aligned chunks on a thread pool and merges the results into tinyobj structures.
+// Only the geometry the importer uses is read (v, vt, vn, f); polygons are fan-triangulated and every
+// face ends up in a single shape. Materials, groups and smoothing groups are ignored.
+bool ParseObjParallel(const char* text, size_t size, ThreadPool& pool, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes, std::string& err);
+
+// Maps the file and parses it with ParseObjParallel
+bool LoadObjParallel(const std::string& filename, ThreadPool& pool, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes, std::string& err);
+
+#endif
@@ -26,13 +26,22 @@ void Player::Update(float deltaTime) {
     }
 }
 
-// Draws the player's model to the screen
-void Player::Draw(GLuint shaderProgram, glm::mat4 projection, glm::mat4 view) {
+// Queues the player's model for this frame
+void Player::Submit(RenderQueue& queue, ShaderProgram& shader) {
+    model.Submit(queue, shader, GetTransform());
+}
+
+// Adds the player's car to this frame's shadow casters
+void Player::AddShadowCaster(std::vector<ShadowCaster>& casters) const {
+    model.AddShadowCaster(casters, GetTransform());
+}
+
+// World transform of the car model
+glm::mat4 Player::GetTransform() const {
     glm::mat4 carTransform = glm::mat4(1.0f);
     carTransform = glm::translate(carTransform, position);
     carTransform = glm::rotate(carTransform, glm::radians(rotationY), glm::vec3(0, 1, 0));
-    glm::mat4 carMVP = projection * view * carTransform;
-    model.Draw(shaderProgram, carMVP);
+    return carTransform;
 }
 
 // Returns the current position of the player
@@ -40,6 +49,11 @@ glm::vec3 Player::GetPosition() const {
     return position;
 }
 
+// Rests the player on the ground found below it
+void Player::SetGroundHeight(float height) {
+    position.y = height;
+}
+
 // Returns the current rotation of the player around the Y-axis
 float Player::GetRotationY() const {
     return rotationY;
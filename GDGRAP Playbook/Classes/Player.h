@@ -14,9 +14,12 @@ public:
     ~Player();
 
     void Update(float deltaTime);
-    void Draw(GLuint shaderProgram, glm::mat4 projection, glm::mat4 view);
+    void Submit(RenderQueue& queue, ShaderProgram& shader);
+    void AddShadowCaster(std::vector<ShadowCaster>& casters) const;
+    glm::mat4 GetTransform() const;
 
     glm::vec3 GetPosition() const;
+    void SetGroundHeight(float height);
     float GetRotationY() const;
     void SetRotationY(float rotationY);
     float GetVelocity() const;
@@ -0,0 +1,382 @@
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "GeometryArena.h"
+#include "StreamBuffer.h"
+#include "LiveryArray.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//Bit pattern of a non-negative float; orders the same way as the value itself
+static uint32_t DepthBits(float depth) {
+    if (!(depth > 0.0f)) return 0;
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits;
+}
+
+//Depth bucket that doubles in size each step: [0,1), [1,3), [3,7), ...
+static uint64_t DepthBucket(float depth) {
+    if (!(depth > 0.0f)) return 0;
+    int bucket = static_cast<int>(std::log2(1.0f + depth));
+    return static_cast<uint64_t>(bucket < 15 ? bucket : 15);
+}
+
+//Applies one of the queue's blend modes
+static void ApplyBlend(BlendMode blend) {
+    if (blend == BLEND_OPAQUE) {
+        GLState::SetBlend(false);
+        return;
+    }
+    // Color adds up in both targets and alpha multiplies into the revealage; see TransparencyBuffer.h
+    GLState::SetBlend(true);
+    GLState::BlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+//Stable LSD radix sort on the 64-bit keys, one byte per pass; passes where every key shares the byte are skipped
+static void RadixSort(std::vector<RenderSortEntry>& entries, std::vector<RenderSortEntry>& scratch) {
+    scratch.resize(entries.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {};
+        for (const RenderSortEntry& entry : entries) {
+            offsets[(entry.key >> shift) & 0xFF]++;
+        }
+        if (offsets[(entries[0].key >> shift) & 0xFF] == entries.size()) continue;
+
+        size_t total = 0;
+        for (size_t& offset : offsets) {
+            size_t count = offset;
+            offset = total;
+            total += count;
+        }
+        for (const RenderSortEntry& entry : entries) {
+            scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+RenderQueue::RenderQueue() :
+    cameraPosition(0.0f), projectionScale(1.0f), frustum(Frustum::FromMatrix(glm::mat4(1.0f))),
+    instanceBuffer(0), indirectBuffer(0), instanceBase(0), indirectOffset(0), sorted(false), prepassShader(nullptr) {
+}
+
+void RenderQueue::Begin(const glm::vec3& cameraPosition, const glm::mat4& view, const glm::mat4& projection) {
+    this->cameraPosition = cameraPosition;
+    projectionScale = std::abs(projection[1][1]);
+    frustum = Frustum::FromMatrix(projection * view);
+    packets.clear();
+    instances.clear();
+    culler.Clear();
+    entries.clear();
+    programIds.clear();
+    textureIds.clear();
+    materialIds.clear();
+    meshIds.clear();
+    sorted = false;
+    prepassShader = nullptr;
+}
+
+//Projected diameter over the viewport height (2 NDC units); the distance is to the sphere's center
+float RenderQueue::GetScreenSize(const BoundingSphere& sphere) const {
+    if (sphere.radius < 0.0f) return 1.0f;
+    float distance = glm::length(sphere.center - cameraPosition);
+    if (distance <= sphere.radius) return 1.0f;
+    return sphere.radius * projectionScale / distance;
+}
+
+void RenderQueue::Submit(ShaderProgram& shader, Mesh& mesh, GLuint texture, GLuint normalMap, BlendMode blend, const InstanceData& instance, int lod, GLuint liveries) {
+    if (!mesh.IsReady()) return;
+
+    const MeshLOD& level = mesh.GetLOD(lod);
+    DrawPacket packet;
+    packet.shader = &shader;
+    packet.mesh = &mesh;
+    packet.texture = texture;
+    packet.normalMap = normalMap;
+    packet.liveries = liveries;
+    packet.blend = blend;
+    packet.depth = glm::length(glm::vec3(instance.model[3]) - cameraPosition);
+    packet.firstIndex = level.firstIndex;
+    packet.indexCount = level.indexCount;
+    packet.firstInstance = instances.size();
+    packet.instanceCount = 1;
+
+    instances.push_back(instance);
+    culler.Add(mesh.GetBounds().box.Transform(instance.model));
+    Add(packet);
+}
+
+//Copies the instances so the caller's array only has to live until this returns
+void RenderQueue::SubmitInstanced(ShaderProgram& shader, Mesh& mesh, GLuint texture, GLuint normalMap, BlendMode blend, const InstanceData* instances, GLsizei count, int lod, GLuint liveries) {
+    if (!mesh.IsReady() || count <= 0) return;
+
+    const MeshLOD& level = mesh.GetLOD(lod);
+    // Sorted as one packet at the instances' average distance
+    glm::vec3 center(0.0f);
+    for (GLsizei i = 0; i < count; i++) {
+        center += glm::vec3(instances[i].model[3]);
+    }
+    center /= static_cast<float>(count);
+
+    DrawPacket packet;
+    packet.shader = &shader;
+    packet.mesh = &mesh;
+    packet.texture = texture;
+    packet.normalMap = normalMap;
+    packet.liveries = liveries;
+    packet.blend = blend;
+    packet.depth = glm::length(center - cameraPosition);
+    packet.firstIndex = level.firstIndex;
+    packet.indexCount = level.indexCount;
+    packet.firstInstance = this->instances.size();
+    packet.instanceCount = count;
+
+    this->instances.insert(this->instances.end(), instances, instances + count);
+    for (GLsizei i = 0; i < count; i++) {
+        culler.Add(mesh.GetBounds().box.Transform(instances[i].model));
+    }
+    Add(packet);
+}
+
+void RenderQueue::Add(const DrawPacket& packet) {
+    RenderSortEntry entry;
+    entry.key = MakeSortKey(packet);
+    entry.packet = static_cast<uint32_t>(packets.size());
+    entries.push_back(entry);
+    packets.push_back(packet);
+}
+
+//Hands out small ids in submission order so the key fields stay dense
+uint32_t RenderQueue::GetId(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t value) {
+    std::unordered_map<uint64_t, uint32_t>::iterator it = ids.find(value);
+    if (it != ids.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(ids.size());
+    ids.emplace(value, id);
+    return id;
+}
+
+uint64_t RenderQueue::MakeSortKey(const DrawPacket& packet) {
+    uint64_t program = GetId(programIds, packet.shader->GetID());
+    // The texture pair fills all 64 bits of its lookup, so it is compacted first and the livery array gets the
+    // low half of the material lookup to itself
+    uint64_t textures = GetId(textureIds, (uint64_t(packet.texture) << 32) | packet.normalMap);
+    uint64_t material = GetId(materialIds, (textures << 32) | packet.liveries);
+    uint64_t mesh = GetId(meshIds, reinterpret_cast<uintptr_t>(packet.mesh));
+    uint64_t depth = packet.blend == BLEND_TRANSPARENT ? 0 : DepthBits(packet.depth);
+
+    if (packet.blend == BLEND_OPAQUE) {
+        return (DepthBucket(packet.depth) << 59) |
+            ((program & 0xFF) << 51) |
+            ((material & 0xFFFF) << 35) |
+            ((mesh & 0xFFFF) << 19) |
+            (depth >> 13);
+    }
+    return (uint64_t(1) << 63) |
+        ((~depth & 0xFFFFFFFF) << 31) |
+        ((uint64_t(packet.blend) & 0x7) << 28) |
+        ((program & 0xFF) << 20) |
+        ((material & 0xFFF) << 8) |
+        (mesh & 0xFF);
+}
+
+//Tests every instance at once, then packs each packet's visible instances to the front of its range
+//and drops the sort entries of packets with nothing left
+void RenderQueue::Cull() {
+    culler.Cull(frustum);
+
+    size_t kept = 0;
+    for (const RenderSortEntry& entry : entries) {
+        DrawPacket& packet = packets[entry.packet];
+        GLsizei visibleCount = 0;
+        for (GLsizei i = 0; i < packet.instanceCount; i++) {
+            size_t index = packet.firstInstance + i;
+            if (culler.IsVisible(index)) {
+                instances[packet.firstInstance + visibleCount++] = instances[index];
+            }
+        }
+
+        stats.culled += packet.instanceCount - visibleCount;
+        packet.instanceCount = visibleCount;
+        if (visibleCount > 0) entries[kept++] = entry;
+    }
+    entries.resize(kept);
+}
+
+void RenderQueue::Sort() {
+    if (sorted) return;
+    stats = RenderStats();
+    Cull();
+    if (!entries.empty()) RadixSort(entries, scratch);
+
+    commands.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        const DrawPacket& packet = packets[entries[i].packet];
+        DrawElementsIndirectCommand& command = commands[i];
+        command.count = static_cast<GLuint>(packet.indexCount);
+        command.instanceCount = static_cast<GLuint>(packet.instanceCount);
+        command.firstIndex = packet.mesh->GetFirstIndex() + packet.firstIndex;
+        command.baseVertex = packet.mesh->GetBaseVertex();
+        command.baseInstance = static_cast<GLuint>(packet.firstInstance);
+    }
+    if (!entries.empty()) Upload();
+    sorted = true;
+}
+
+void RenderQueue::Upload() {
+    GeometryArena& arena = GeometryArena::Instance();
+    arena.UploadInstances(instances.data(), static_cast<GLsizei>(instances.size()));
+    instanceBuffer = arena.GetInstanceBuffer();
+    instanceBase = arena.GetInstanceBase();
+    if (!GeometryArena::SupportsMultiDrawIndirect()) return;
+
+    StreamBuffer& stream = StreamBuffer::Instance();
+    indirectOffset = stream.Write(commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+    indirectBuffer = stream.GetBuffer();
+}
+
+//Blended keys have the top bit set, so the opaque packets are the sorted prefix
+void RenderQueue::GetPassRange(RenderPass pass, const RenderSortEntry*& begin, const RenderSortEntry*& end) const {
+    begin = entries.data();
+    end = begin + entries.size();
+    const RenderSortEntry* firstBlended = std::find_if(begin, end, [](const RenderSortEntry& entry) { return (entry.key >> 63) != 0; });
+    if (pass == RENDER_PASS_OPAQUE) end = firstBlended;
+    else if (pass == RENDER_PASS_BLENDED) begin = firstBlended;
+}
+
+void RenderQueue::Flush(RenderPass pass) {
+    Sort();
+    if (entries.empty()) return;
+
+    const RenderSortEntry* begin;
+    const RenderSortEntry* end;
+    GetPassRange(pass, begin, end);
+    if (begin == end) return;
+    GeometryArena::Instance().BindInstances(instanceBuffer, instanceBase);
+    Draw(begin, end);
+}
+
+void RenderQueue::FlushDepthPrepass(const ShaderProgram& sceneShader, ShaderProgram& depthShader) {
+    Sort();
+    prepassShader = &sceneShader;
+    if (entries.empty()) return;
+
+    const RenderSortEntry* begin;
+    const RenderSortEntry* end;
+    GetPassRange(RENDER_PASS_OPAQUE, begin, end);
+    if (begin == end) return;
+    GeometryArena::Instance().BindInstances(instanceBuffer, instanceBase);
+
+    depthShader.Use();
+    GLState::SetBlend(false);
+    GLState::SetDepthTest(true);
+    GLState::DepthFunc(GL_LESS);
+    GLState::DepthMask(true);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    // Runs of consecutive pre-passed packets share one call
+    const RenderSortEntry* run = begin;
+    for (const RenderSortEntry* entry = begin; entry != end; entry++) {
+        if (packets[entry->packet].shader != prepassShader) {
+            Issue(run - entries.data(), static_cast<GLsizei>(entry - run));
+            run = entry + 1;
+            continue;
+        }
+        stats.prepassDraws++;
+    }
+    Issue(run - entries.data(), static_cast<GLsizei>(end - run));
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+//Issues a sorted run of packets, changing only the state that differs from the previous packet and merging the
+//packets between changes into one call
+void RenderQueue::Draw(const RenderSortEntry* begin, const RenderSortEntry* end) {
+    ShaderProgram* currentShader = nullptr;
+    GLuint currentTextures[3] = { 0, 0, 0 };
+    BlendMode currentBlend = BLEND_OPAQUE;
+    bool currentPrepassed = false;
+    GLState::SetBlend(false);
+    stats.meshChanges++;
+
+    const RenderSortEntry* run = begin;
+    for (const RenderSortEntry* entry = begin; entry != end; entry++) {
+        const DrawPacket& packet = packets[entry->packet];
+        // Pre-passed packets only shade the fragments whose depth they already wrote
+        bool prepassed = prepassShader && packet.shader == prepassShader && packet.blend == BLEND_OPAQUE;
+        // Models without a normal map or liveries leave whatever was bound, as Model::Draw does
+        bool normalMapChanged = packet.normalMap && packet.normalMap != currentTextures[1];
+        bool liveriesChanged = packet.liveries && packet.liveries != currentTextures[2];
+
+        if (entry == begin || packet.shader != currentShader || packet.blend != currentBlend || prepassed != currentPrepassed ||
+            packet.texture != currentTextures[0] || normalMapChanged || liveriesChanged) {
+            Issue(run - entries.data(), static_cast<GLsizei>(entry - run));
+            run = entry;
+        }
+
+        if (packet.shader != currentShader) {
+            currentShader = packet.shader;
+            currentShader->Use();
+            currentShader->SetInt(currentShader->GetMeshUniforms().tex0, 0);
+            currentShader->SetInt(currentShader->GetMeshUniforms().normalMap, 1);
+            currentShader->SetInt(currentShader->GetMeshUniforms().liveries, static_cast<GLint>(LIVERY_TEXTURE_UNIT));
+            stats.programChanges++;
+        }
+        if (packet.blend != currentBlend) {
+            currentBlend = packet.blend;
+            ApplyBlend(currentBlend);
+            stats.blendChanges++;
+        }
+        if (prepassed != currentPrepassed) {
+            currentPrepassed = prepassed;
+            GLState::DepthFunc(prepassed ? GL_EQUAL : GL_LESS);
+            GLState::DepthMask(!prepassed);
+        }
+        if (packet.texture != currentTextures[0]) {
+            currentTextures[0] = packet.texture;
+            GLState::BindTexture(0, GL_TEXTURE_2D, packet.texture);
+            stats.textureChanges++;
+        }
+        if (normalMapChanged) {
+            currentTextures[1] = packet.normalMap;
+            GLState::BindTexture(1, GL_TEXTURE_2D, packet.normalMap);
+            stats.textureChanges++;
+        }
+        if (liveriesChanged) {
+            currentTextures[2] = packet.liveries;
+            GLState::BindTexture(LIVERY_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, packet.liveries);
+            stats.textureChanges++;
+        }
+
+        stats.draws++;
+        stats.triangles += size_t(packet.indexCount / 3) * packet.instanceCount;
+    }
+    Issue(run - entries.data(), static_cast<GLsizei>(end - run));
+
+    GLState::SetBlend(false);
+    if (currentPrepassed) {
+        GLState::DepthFunc(GL_LESS);
+        GLState::DepthMask(true);
+    }
+}
+
+void RenderQueue::Issue(size_t first, GLsizei count) {
+    if (count <= 0) return;
+
+    GeometryArena& arena = GeometryArena::Instance();
+    if (GeometryArena::SupportsMultiDrawIndirect()) {
+        GLState::BindVertexArray(arena.GetInstanceArray());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(indirectOffset + first * sizeof(DrawElementsIndirectCommand)), count, 0);
+        stats.drawCalls++;
+        return;
+    }
+
+    for (size_t i = first; i < first + count; i++) {
+        const DrawElementsIndirectCommand& command = commands[i];
+        arena.SetInstanceOffset(command.baseInstance);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT, (void*)(size_t(command.firstIndex) * sizeof(GLuint)),
+            command.instanceCount, command.baseVertex);
+        stats.drawCalls++;
+    }
+}
@@ -0,0 +1,153 @@
+// RenderQueue.h
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Mesh.h"
+#include "ShaderProgram.h"
+#include "FrustumCuller.h"
+
+// How a packet is composited; anything but BLEND_OPAQUE is drawn after the opaque pass
+enum BlendMode {
+    BLEND_OPAQUE,
+    BLEND_TRANSPARENT   // weighted blended OIT into a TransparencyBuffer, in any order; used by the ghost cars
+};
+
+// Which packets a Flush draws; the deferred path lights the opaque ones before the blended ones are drawn
+enum RenderPass {
+    RENDER_PASS_OPAQUE = 1,
+    RENDER_PASS_BLENDED = 2,
+    RENDER_PASS_ALL = RENDER_PASS_OPAQUE | RENDER_PASS_BLENDED
+};
+
+// One draw recorded for the current frame. Every packet, single or instanced, points into the queue's own
+// instance storage.
+struct DrawPacket {
+    ShaderProgram* shader;
+    Mesh* mesh;
+    GLuint texture;
+    GLuint normalMap;
+    GLuint liveries;        // GL_TEXTURE_2D_ARRAY of a LiveryArray, or 0
+    BlendMode blend;
+    float depth;
+    GLuint firstIndex;      // index range of the mesh LOD being drawn, relative to the mesh
+    GLsizei indexCount;
+    size_t firstInstance;
+    GLsizei instanceCount;
+};
+
+// Layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Sort key and the index of the packet it belongs to
+struct RenderSortEntry {
+    uint64_t key;
+    uint32_t packet;
+};
+
+// Culling results and state changes issued by the last Flush
+struct RenderStats {
+    size_t culled = 0;      // instances dropped by the frustum test
+    size_t draws = 0;
+    size_t drawCalls = 0;   // GL draw calls of both passes; one per run of packets sharing state with multi-draw indirect
+    size_t prepassDraws = 0;    // depth-only draws of FlushDepthPrepass, not counted in draws
+    size_t triangles = 0;   // summed over every instance drawn
+    size_t programChanges = 0;
+    size_t textureChanges = 0;
+    size_t meshChanges = 0;
+    size_t blendChanges = 0;
+
+    size_t GetStateChanges() const { return programChanges + textureChanges + meshChanges + blendChanges; }
+};
+
+// Collects the frame's draws, culls every instance against the view frustum, sorts what is left by a
+// packed 64-bit key and issues it with only the state changes that differ between neighbours.
+//
+// Opaque keys: [63] 0 | [62:59] log2 depth bucket | [58:51] program | [50:35] material | [34:19] mesh | [18:0] depth
+// Blended keys: [63] 1 | [62:31] inverted depth | [30:28] blend mode | [27:20] program | [19:8] material | [7:0] mesh
+//
+// Opaque packets therefore run roughly front to back (coarse buckets), grouped by state inside each bucket;
+// blended packets run strictly back to front, except BLEND_TRANSPARENT ones, which do not depend on order and
+// leave the depth field zero so they only group by state. Program/material/mesh fields are small per-frame ids, so a
+// wrapped id only costs a redundant state change, never a wrong one.
+//
+// Every mesh lives in the shared GeometryArena, so geometry never has to be rebound between packets. After
+// sorting, each packet becomes one indirect command whose base instance selects its transforms in the arena's
+// instance stream; both are written to the per-frame StreamBuffer. Each run of packets with the same program,
+// blend mode and textures goes out as one glMultiDrawElementsIndirect call. Without GL 4.3 the commands are
+// issued one by one with the instance attributes moved to each command's base instance.
+class RenderQueue {
+public:
+    RenderQueue();
+
+    // Starts a new frame; depth is measured from the camera position and instances outside
+    // the view frustum are dropped on Flush
+    void Begin(const glm::vec3& cameraPosition, const glm::mat4& view, const glm::mat4& projection);
+
+    // lod picks one of the mesh's detail levels (see Mesh::GetLOD); liveries is the texture array the instances'
+    // livery layers index, part of the material like the textures
+    void Submit(ShaderProgram& shader, Mesh& mesh, GLuint texture, GLuint normalMap, BlendMode blend, const InstanceData& instance, int lod = 0, GLuint liveries = 0);
+    void SubmitInstanced(ShaderProgram& shader, Mesh& mesh, GLuint texture, GLuint normalMap, BlendMode blend, const InstanceData* instances, GLsizei count, int lod = 0, GLuint liveries = 0);
+
+    // Height of a world-space sphere on screen as a fraction of the viewport height (about 1 when it fills
+    // the view vertically); used to pick mesh LODs. Empty spheres and spheres around the camera return 1.
+    float GetScreenSize(const BoundingSphere& sphere) const;
+
+    // Draws the packets of the given pass submitted since Begin. The first Flush of a frame culls, sorts and uploads
+    // everything (and resets the stats), so the opaque and blended passes can be flushed separately.
+    void Flush(RenderPass pass = RENDER_PASS_ALL);
+
+    // Depth pre-pass: draws the opaque packets that use sceneShader with depthShader (Shaders/prepass.vert
+    // and depth.frag) and color writes off. The opaque Flush after it draws those packets with GL_EQUAL and
+    // depth writes off, so sceneShader runs about once per covered pixel. Packets with other programs, such
+    // as alpha-tested impostors, are left to the normal depth test.
+    void FlushDepthPrepass(const ShaderProgram& sceneShader, ShaderProgram& depthShader);
+
+    const RenderStats& GetStats() const { return stats; }
+
+private:
+    void Add(const DrawPacket& packet);
+    void Cull();
+    // Culls, sorts, builds the indirect commands and uploads them on the first call of a frame
+    void Sort();
+    // Writes the instances and commands to the StreamBuffer once per Begin; each Flush re-points the instance
+    // array at them, since immediate draws between passes share the instance stream
+    void Upload();
+    void GetPassRange(RenderPass pass, const RenderSortEntry*& begin, const RenderSortEntry*& end) const;
+    void Draw(const RenderSortEntry* begin, const RenderSortEntry* end);
+    // Draws commands [first, first + count) with whatever program is bound
+    void Issue(size_t first, GLsizei count);
+    uint64_t MakeSortKey(const DrawPacket& packet);
+    uint32_t GetId(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t value);
+
+    glm::vec3 cameraPosition;
+    float projectionScale;      // projection[1][1], cot(fovy / 2) for a perspective projection
+    Frustum frustum;
+    // One box per entry of instances, in the same order
+    FrustumCuller culler;
+    std::vector<DrawPacket> packets;
+    std::vector<InstanceData> instances;
+    std::vector<RenderSortEntry> entries, scratch;
+    std::vector<DrawElementsIndirectCommand> commands;     // one per entry, in sorted order
+    // Where Upload wrote the instances and commands; the stream buffer can be replaced by a later grow, so the
+    // buffer names are kept with the offsets
+    GLuint instanceBuffer, indirectBuffer;
+    GLintptr instanceBase, indirectOffset;
+    std::unordered_map<uint64_t, uint32_t> programIds, textureIds, materialIds, meshIds;
+    RenderStats stats;
+    bool sorted;
+    const ShaderProgram* prepassShader;     // set by FlushDepthPrepass until the next Begin
+};
+
+#endif
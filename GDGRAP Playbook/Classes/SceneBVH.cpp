@@ -0,0 +1,583 @@
+#include "SceneBVH.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char BVH_FILE_MAGIC[4] = { 'G', 'D', 'B', 'V' };
+
+// Binned SAH parameters: bins per axis, the largest leaf the SAH may choose, and a depth cap that keeps
+// the fixed traversal stacks below from overflowing
+static const int SAH_BIN_COUNT = 16;
+static const uint32_t MAX_LEAF_SIZE = 8;
+static const int MAX_DEPTH = 48;
+static const int TRAVERSAL_STACK_SIZE = 64;
+static_assert(MAX_DEPTH + 1 <= TRAVERSAL_STACK_SIZE, "A tree at the depth cap must fit the traversal stacks");
+
+// Builds over fewer primitives than this stay on the calling thread
+static const size_t PARALLEL_BUILD_MIN = 4096;
+
+// Fixed 32-byte header; the nodes, the leaf order and the primitives follow in that order
+struct BVHFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t primitiveType;
+    uint32_t nodeCount;
+    uint32_t primitiveCount;
+    uint32_t inputCount;
+    uint64_t sourceHash;
+};
+
+static_assert(sizeof(BVHFileHeader) == 32, "BVHFileHeader must stay 32 bytes");
+static_assert(sizeof(BoundingBox) == 6 * sizeof(float) && sizeof(glm::vec3) == 3 * sizeof(float), "Primitives are written as raw floats");
+
+// A subtree left for the parallel phase: its node slot is already allocated in the top of the tree
+struct BVHBuildTask {
+    uint32_t node;
+    uint32_t begin, end;
+    int depth;
+};
+
+struct BVHBin {
+    BoundingBox bounds;
+    uint32_t count = 0;
+};
+
+// Inputs shared by every thread of a build; each node partitions its own range of the order in place
+struct BVHBuilder {
+    const std::vector<BoundingBox>* boxes;
+    std::vector<glm::vec3> centroids;
+    std::vector<uint32_t>* order;
+    int deferDepth;
+
+    void BuildNode(std::vector<BVHNode>& nodes, uint32_t nodeIndex, uint32_t begin, uint32_t end, int depth, std::vector<BVHBuildTask>* deferred);
+};
+
+static float SurfaceArea(const BoundingBox& box) {
+    glm::vec3 size = box.max - box.min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static void SetNodeBounds(BVHNode& node, const BoundingBox& box) {
+    for (int axis = 0; axis < 3; axis++) {
+        node.boundsMin[axis] = box.min[axis];
+        node.boundsMax[axis] = box.max[axis];
+    }
+}
+
+static BoundingBox GetNodeBounds(const BVHNode& node) {
+    return BoundingBox(glm::vec3(node.boundsMin[0], node.boundsMin[1], node.boundsMin[2]), glm::vec3(node.boundsMax[0], node.boundsMax[1], node.boundsMax[2]));
+}
+
+static int GetBin(float centroid, float minimum, float scale) {
+    int bin = static_cast<int>((centroid - minimum) * scale);
+    return std::min(std::max(bin, 0), SAH_BIN_COUNT - 1);
+}
+
+//Splits the node along the cheapest of the binned SAH candidates, or makes it a leaf when that is cheaper.
+//With deferred set, children at deferDepth are queued as tasks instead of being built here.
+void BVHBuilder::BuildNode(std::vector<BVHNode>& nodes, uint32_t nodeIndex, uint32_t begin, uint32_t end, int depth, std::vector<BVHBuildTask>* deferred) {
+    std::vector<uint32_t>& ids = *order;
+    BoundingBox bounds, centroidBounds;
+    for (uint32_t i = begin; i < end; i++) {
+        bounds.Expand((*boxes)[ids[i]]);
+        centroidBounds.Expand(centroids[ids[i]]);
+    }
+
+    BVHNode node;
+    SetNodeBounds(node, bounds);
+    node.firstChildOrPrimitive = begin;
+    node.primitiveCount = end - begin;
+
+    uint32_t count = end - begin;
+    if (count == 1 || depth >= MAX_DEPTH) {
+        nodes[nodeIndex] = node;
+        return;
+    }
+
+    float bestCost = FLT_MAX;
+    int bestAxis = -1, bestSplit = 0;
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    for (int axis = 0; axis < 3; axis++) {
+        if (!(extent[axis] > 0.0f)) continue;
+
+        BVHBin bins[SAH_BIN_COUNT];
+        float scale = SAH_BIN_COUNT / extent[axis];
+        for (uint32_t i = begin; i < end; i++) {
+            BVHBin& bin = bins[GetBin(centroids[ids[i]][axis], centroidBounds.min[axis], scale)];
+            bin.bounds.Expand((*boxes)[ids[i]]);
+            bin.count++;
+        }
+
+        // Sweep from the right to get the cost of every right side, then from the left to finish each candidate
+        float rightCosts[SAH_BIN_COUNT - 1];
+        BoundingBox accumulated;
+        uint32_t accumulatedCount = 0;
+        for (int b = SAH_BIN_COUNT - 1; b > 0; b--) {
+            accumulated.Expand(bins[b].bounds);
+            accumulatedCount += bins[b].count;
+            rightCosts[b - 1] = accumulatedCount ? SurfaceArea(accumulated) * accumulatedCount : 0.0f;
+        }
+
+        accumulated = BoundingBox();
+        accumulatedCount = 0;
+        for (int b = 0; b < SAH_BIN_COUNT - 1; b++) {
+            accumulated.Expand(bins[b].bounds);
+            accumulatedCount += bins[b].count;
+            if (accumulatedCount == 0 || accumulatedCount == count) continue;
+            float cost = SurfaceArea(accumulated) * accumulatedCount + rightCosts[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    // Traversal costs 1, each primitive test costs 1
+    float area = SurfaceArea(bounds);
+    float splitCost = area > 0.0f ? 1.0f + bestCost / area : FLT_MAX;
+    if (count <= MAX_LEAF_SIZE && (bestAxis < 0 || splitCost >= float(count))) {
+        nodes[nodeIndex] = node;
+        return;
+    }
+
+    // With every centroid in the same place any split is as good as another, so that case halves the range
+    uint32_t middle = begin + count / 2;
+    if (bestAxis >= 0) {
+        float scale = SAH_BIN_COUNT / extent[bestAxis];
+        float minimum = centroidBounds.min[bestAxis];
+        std::vector<uint32_t>::iterator split = std::partition(ids.begin() + begin, ids.begin() + end, [&](uint32_t id) {
+            return GetBin(centroids[id][bestAxis], minimum, scale) <= bestSplit;
+        });
+        middle = static_cast<uint32_t>(split - ids.begin());
+    }
+
+    uint32_t left = static_cast<uint32_t>(nodes.size());
+    nodes.resize(nodes.size() + 2);
+    node.firstChildOrPrimitive = left;
+    node.primitiveCount = 0;
+    nodes[nodeIndex] = node;
+
+    if (deferred && depth + 1 >= deferDepth) {
+        deferred->push_back({ left, begin, middle, depth + 1 });
+        deferred->push_back({ left + 1, middle, end, depth + 1 });
+        return;
+    }
+    BuildNode(nodes, left, begin, middle, depth + 1, deferred);
+    BuildNode(nodes, left + 1, middle, end, depth + 1, deferred);
+}
+
+//Signed distance tests of a box against the planes still set in mask. Returns false if the box is outside
+//one of them; planes the box is entirely inside are cleared from mask, since no child can cross them.
+static bool FrustumTest(const Frustum& frustum, const BoundingBox& box, uint32_t& mask) {
+    glm::vec3 center = box.GetCenter();
+    glm::vec3 extents = box.GetExtents();
+    for (int p = 0; p < 6; p++) {
+        if (!(mask & (1u << p))) continue;
+        const glm::vec4& plane = frustum.planes[p];
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+        if (distance + radius < 0.0f) return false;
+        if (distance - radius >= 0.0f) mask &= ~(1u << p);
+    }
+    return true;
+}
+
+//Slab test; returns the entry distance, or FLT_MAX if the ray misses the box before maxDistance.
+//axis receives the slab the ray entered through (-1 if the origin is inside).
+static float RayBoxEntry(const float boxMin[3], const float boxMax[3], const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, int& axis) {
+    float nearest = 0.0f, farthest = maxDistance;
+    axis = -1;
+    for (int a = 0; a < 3; a++) {
+        float t0 = (boxMin[a] - origin[a]) * inverseDirection[a];
+        float t1 = (boxMax[a] - origin[a]) * inverseDirection[a];
+        if (t0 > t1) std::swap(t0, t1);
+        if (t0 > nearest) {
+            nearest = t0;
+            axis = a;
+        }
+        if (t1 < farthest) farthest = t1;
+    }
+    return nearest <= farthest ? nearest : FLT_MAX;
+}
+
+//Moller-Trumbore, double sided; returns the hit distance or FLT_MAX
+static float RayTriangle(const glm::vec3* corner, const glm::vec3& origin, const glm::vec3& direction) {
+    glm::vec3 edge1 = corner[1] - corner[0];
+    glm::vec3 edge2 = corner[2] - corner[0];
+    glm::vec3 p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (std::fabs(determinant) < 1e-12f) return FLT_MAX;
+
+    float inverse = 1.0f / determinant;
+    glm::vec3 s = origin - corner[0];
+    float u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f) return FLT_MAX;
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f) return FLT_MAX;
+
+    float t = glm::dot(edge2, q) * inverse;
+    return t >= 0.0f ? t : FLT_MAX;
+}
+
+SceneBVH::SceneBVH() : type(BVH_PRIMITIVE_BOX), inputCount(0) {
+}
+
+void SceneBVH::BuildBoxes(const std::vector<BoundingBox>& boxes, ThreadPool& pool) {
+    Clear();
+    type = BVH_PRIMITIVE_BOX;
+    Build(boxes, pool);
+
+    this->boxes.resize(primitiveIds.size());
+    for (size_t i = 0; i < primitiveIds.size(); i++) {
+        this->boxes[i] = boxes[primitiveIds[i]];
+    }
+}
+
+void SceneBVH::BuildTriangles(const std::vector<glm::vec3>& corners, ThreadPool& pool) {
+    Clear();
+    type = BVH_PRIMITIVE_TRIANGLE;
+
+    size_t triangleCount = corners.size() / 3;
+    std::vector<BoundingBox> triangleBoxes(triangleCount);
+    pool.ParallelFor(triangleCount, 16384, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            BoundingBox& box = triangleBoxes[t];
+            box.Expand(corners[3 * t + 0]);
+            box.Expand(corners[3 * t + 1]);
+            box.Expand(corners[3 * t + 2]);
+        }
+    });
+    Build(triangleBoxes, pool);
+
+    this->corners.resize(primitiveIds.size() * 3);
+    for (size_t i = 0; i < primitiveIds.size(); i++) {
+        for (int c = 0; c < 3; c++) {
+            this->corners[3 * i + c] = corners[3 * primitiveIds[i] + c];
+        }
+    }
+}
+
+//Builds the top of the tree on the calling thread until there are a few subtrees per thread,
+//then builds those on the pool and splices them in behind the top nodes
+void SceneBVH::Build(const std::vector<BoundingBox>& primitiveBoxes, ThreadPool& pool) {
+    BVHBuilder builder;
+    builder.boxes = &primitiveBoxes;
+    builder.order = &primitiveIds;
+    inputCount = static_cast<uint32_t>(primitiveBoxes.size());
+    builder.centroids.resize(primitiveBoxes.size());
+    for (size_t i = 0; i < primitiveBoxes.size(); i++) {
+        if (primitiveBoxes[i].IsEmpty()) continue;
+        builder.centroids[i] = primitiveBoxes[i].GetCenter();
+        primitiveIds.push_back(static_cast<uint32_t>(i));
+    }
+    if (primitiveIds.empty()) return;
+
+    size_t threads = pool.GetWorkerCount() + 1;
+    bool parallel = threads > 1 && primitiveIds.size() >= PARALLEL_BUILD_MIN;
+    builder.deferDepth = 0;
+    while ((size_t(1) << builder.deferDepth) < threads * 4) builder.deferDepth++;
+
+    std::vector<BVHBuildTask> tasks;
+    nodes.reserve(primitiveIds.size() * 2);
+    nodes.resize(1);
+    builder.BuildNode(nodes, 0, 0, static_cast<uint32_t>(primitiveIds.size()), 0, parallel ? &tasks : nullptr);
+
+    std::vector<std::vector<BVHNode>> subtrees(tasks.size());
+    pool.ParallelFor(tasks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            subtrees[t].reserve((tasks[t].end - tasks[t].begin) * 2);
+            subtrees[t].resize(1);
+            builder.BuildNode(subtrees[t], 0, tasks[t].begin, tasks[t].end, tasks[t].depth, nullptr);
+        }
+    });
+
+    // A subtree's root replaces its placeholder; its other nodes are appended with their child links moved
+    for (size_t t = 0; t < tasks.size(); t++) {
+        const std::vector<BVHNode>& subtree = subtrees[t];
+        uint32_t base = static_cast<uint32_t>(nodes.size()) - 1;
+        for (size_t i = 0; i < subtree.size(); i++) {
+            BVHNode node = subtree[i];
+            if (!node.IsLeaf()) node.firstChildOrPrimitive += base;
+            if (i == 0) nodes[tasks[t].node] = node;
+            else nodes.push_back(node);
+        }
+    }
+}
+
+void SceneBVH::Clear() {
+    nodes.clear();
+    primitiveIds.clear();
+    inputCount = 0;
+    boxes.clear();
+    corners.clear();
+}
+
+BoundingBox SceneBVH::GetPrimitiveBox(size_t leafIndex) const {
+    if (type == BVH_PRIMITIVE_BOX) return boxes[leafIndex];
+    BoundingBox box;
+    box.Expand(corners[3 * leafIndex + 0]);
+    box.Expand(corners[3 * leafIndex + 1]);
+    box.Expand(corners[3 * leafIndex + 2]);
+    return box;
+}
+
+//Appends every primitive below a node without testing anything
+void SceneBVH::AppendSubtree(uint32_t node, std::vector<uint32_t>& primitives) const {
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = node;
+    while (stackSize > 0) {
+        const BVHNode& current = nodes[stack[--stackSize]];
+        if (current.IsLeaf()) {
+            primitives.insert(primitives.end(), primitiveIds.begin() + current.firstChildOrPrimitive,
+                primitiveIds.begin() + current.firstChildOrPrimitive + current.primitiveCount);
+            continue;
+        }
+        stack[stackSize++] = current.firstChildOrPrimitive + 1;
+        stack[stackSize++] = current.firstChildOrPrimitive;
+    }
+}
+
+//Children only test the planes their parent straddles; a node entirely inside takes its whole subtree
+void SceneBVH::CullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const {
+    if (nodes.empty()) return;
+
+    struct Entry {
+        uint32_t node;
+        uint32_t mask;
+    };
+    Entry stack[TRAVERSAL_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = { 0, 0x3F };
+
+    while (stackSize > 0) {
+        Entry entry = stack[--stackSize];
+        const BVHNode& node = nodes[entry.node];
+        uint32_t mask = entry.mask;
+        if (!FrustumTest(frustum, GetNodeBounds(node), mask)) continue;
+        if (mask == 0) {
+            AppendSubtree(entry.node, visible);
+            continue;
+        }
+
+        if (node.IsLeaf()) {
+            for (uint32_t i = node.firstChildOrPrimitive; i < node.firstChildOrPrimitive + node.primitiveCount; i++) {
+                uint32_t primitiveMask = mask;
+                if (FrustumTest(frustum, GetPrimitiveBox(i), primitiveMask)) visible.push_back(primitiveIds[i]);
+            }
+            continue;
+        }
+        stack[stackSize++] = { node.firstChildOrPrimitive + 1, mask };
+        stack[stackSize++] = { node.firstChildOrPrimitive, mask };
+    }
+}
+
+void SceneBVH::Overlap(const BoundingBox& box, std::vector<uint32_t>& overlapping) const {
+    if (nodes.empty() || box.IsEmpty()) return;
+
+    auto overlaps = [&box](const BoundingBox& other) {
+        return box.min.x <= other.max.x && box.max.x >= other.min.x &&
+            box.min.y <= other.max.y && box.max.y >= other.min.y &&
+            box.min.z <= other.max.z && box.max.z >= other.min.z;
+    };
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const BVHNode& node = nodes[stack[--stackSize]];
+        if (!overlaps(GetNodeBounds(node))) continue;
+
+        if (node.IsLeaf()) {
+            for (uint32_t i = node.firstChildOrPrimitive; i < node.firstChildOrPrimitive + node.primitiveCount; i++) {
+                if (overlaps(GetPrimitiveBox(i))) overlapping.push_back(primitiveIds[i]);
+            }
+            continue;
+        }
+        stack[stackSize++] = node.firstChildOrPrimitive + 1;
+        stack[stackSize++] = node.firstChildOrPrimitive;
+    }
+}
+
+//Visits the nearer child first and skips anything that starts beyond the closest hit so far.
+//Box primitives that contain the origin are not reported, so a ray can start inside a prop's box.
+bool SceneBVH::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const {
+    if (nodes.empty()) return false;
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+    float closest = maxDistance;
+    bool found = false;
+
+    struct Entry {
+        uint32_t node;
+        float distance;
+    };
+    Entry stack[TRAVERSAL_STACK_SIZE];
+    int stackSize = 0;
+    int axis;
+    float rootDistance = RayBoxEntry(nodes[0].boundsMin, nodes[0].boundsMax, origin, inverseDirection, closest, axis);
+    if (rootDistance == FLT_MAX) return false;
+    stack[stackSize++] = { 0, rootDistance };
+
+    while (stackSize > 0) {
+        Entry entry = stack[--stackSize];
+        if (entry.distance > closest) continue;
+        const BVHNode& node = nodes[entry.node];
+
+        if (node.IsLeaf()) {
+            for (uint32_t i = node.firstChildOrPrimitive; i < node.firstChildOrPrimitive + node.primitiveCount; i++) {
+                if (type == BVH_PRIMITIVE_TRIANGLE) {
+                    const glm::vec3* corner = &corners[3 * i];
+                    float distance = RayTriangle(corner, origin, direction);
+                    if (distance > closest) continue;
+                    glm::vec3 normal = glm::normalize(glm::cross(corner[1] - corner[0], corner[2] - corner[0]));
+                    closest = distance;
+                    hit.distance = distance;
+                    hit.primitive = primitiveIds[i];
+                    hit.normal = glm::dot(normal, direction) > 0.0f ? -normal : normal;
+                    found = true;
+                }
+                else {
+                    const BoundingBox& box = boxes[i];
+                    float distance = RayBoxEntry(&box.min[0], &box.max[0], origin, inverseDirection, closest, axis);
+                    if (distance == FLT_MAX || axis < 0) continue;
+                    closest = distance;
+                    hit.distance = distance;
+                    hit.primitive = primitiveIds[i];
+                    hit.normal = glm::vec3(0.0f);
+                    hit.normal[axis] = direction[axis] > 0.0f ? -1.0f : 1.0f;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        uint32_t nearChild = node.firstChildOrPrimitive, farChild = nearChild + 1;
+        float nearDistance = RayBoxEntry(nodes[nearChild].boundsMin, nodes[nearChild].boundsMax, origin, inverseDirection, closest, axis);
+        float farDistance = RayBoxEntry(nodes[farChild].boundsMin, nodes[farChild].boundsMax, origin, inverseDirection, closest, axis);
+        if (farDistance < nearDistance) {
+            std::swap(nearChild, farChild);
+            std::swap(nearDistance, farDistance);
+        }
+        if (farDistance != FLT_MAX) stack[stackSize++] = { farChild, farDistance };
+        if (nearDistance != FLT_MAX) stack[stackSize++] = { nearChild, nearDistance };
+    }
+    return found;
+}
+
+bool SceneBVH::Save(const std::string& filename, uint64_t sourceHash) const {
+    BVHFileHeader header = {};
+    std::memcpy(header.magic, BVH_FILE_MAGIC, sizeof(BVH_FILE_MAGIC));
+    header.version = BVH_FILE_VERSION;
+    header.primitiveType = type;
+    header.nodeCount = static_cast<uint32_t>(nodes.size());
+    header.primitiveCount = static_cast<uint32_t>(primitiveIds.size());
+    header.inputCount = inputCount;
+    header.sourceHash = sourceHash;
+
+    // Write to a temporary file first so an interrupted save never leaves a truncated file behind
+    std::string tempFilename = filename + ".tmp";
+    bool written;
+    {
+        std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cout << "Failed to write BVH: " << filename << std::endl;
+            return false;
+        }
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(BVHNode));
+        out.write(reinterpret_cast<const char*>(primitiveIds.data()), primitiveIds.size() * sizeof(uint32_t));
+        if (type == BVH_PRIMITIVE_BOX) {
+            out.write(reinterpret_cast<const char*>(boxes.data()), boxes.size() * sizeof(BoundingBox));
+        }
+        else {
+            out.write(reinterpret_cast<const char*>(corners.data()), corners.size() * sizeof(glm::vec3));
+        }
+
+        out.close();
+        written = !out.fail();
+    }
+
+    if (!written) {
+        std::cout << "Failed to write BVH: " << filename << std::endl;
+        std::remove(tempFilename.c_str());
+        return false;
+    }
+
+    std::remove(filename.c_str());
+    return std::rename(tempFilename.c_str(), filename.c_str()) == 0;
+}
+
+//Rejects files from another version or source, any file whose links or ids point outside its own arrays, and
+//trees deeper than the traversal stacks allow
+bool SceneBVH::Load(const std::string& filename, uint64_t sourceHash) {
+    MappedFile file(filename);
+    if (!file.IsOpen() || file.GetSize() < sizeof(BVHFileHeader)) return false;
+
+    BVHFileHeader header;
+    std::memcpy(&header, file.GetData(), sizeof(header));
+    if (std::memcmp(header.magic, BVH_FILE_MAGIC, sizeof(BVH_FILE_MAGIC)) != 0 ||
+        header.version != BVH_FILE_VERSION ||
+        header.sourceHash != sourceHash ||
+        (header.primitiveType != BVH_PRIMITIVE_BOX && header.primitiveType != BVH_PRIMITIVE_TRIANGLE) ||
+        header.nodeCount == 0 || header.primitiveCount > header.inputCount) {
+        return false;
+    }
+
+    size_t primitiveSize = header.primitiveType == BVH_PRIMITIVE_BOX ? sizeof(BoundingBox) : 3 * sizeof(glm::vec3);
+    uint64_t expectedSize = sizeof(BVHFileHeader) + uint64_t(header.nodeCount) * sizeof(BVHNode) +
+        uint64_t(header.primitiveCount) * (sizeof(uint32_t) + primitiveSize);
+    if (file.GetSize() != expectedSize) return false;
+
+    const unsigned char* data = file.GetData() + sizeof(BVHFileHeader);
+    std::vector<BVHNode> loadedNodes(header.nodeCount);
+    std::memcpy(loadedNodes.data(), data, loadedNodes.size() * sizeof(BVHNode));
+    data += loadedNodes.size() * sizeof(BVHNode);
+
+    // Children always come after their parent, which also rules out cycles. Walking the nodes in order
+    // therefore reaches every parent before its children, so each node's deepest path is known in one pass;
+    // the traversal stacks hold one entry per level plus one, so nothing deeper than the builder's cap loads.
+    std::vector<int> depths(loadedNodes.size(), 0);
+    for (size_t i = 0; i < loadedNodes.size(); i++) {
+        const BVHNode& node = loadedNodes[i];
+        bool valid = node.IsLeaf() ?
+            uint64_t(node.firstChildOrPrimitive) + node.primitiveCount <= header.primitiveCount :
+            node.firstChildOrPrimitive > i && uint64_t(node.firstChildOrPrimitive) + 1 < header.nodeCount;
+        if (!valid || depths[i] > MAX_DEPTH) return false;
+        if (node.IsLeaf()) continue;
+
+        for (uint32_t child = node.firstChildOrPrimitive; child <= node.firstChildOrPrimitive + 1; child++) {
+            depths[child] = std::max(depths[child], depths[i] + 1);
+        }
+    }
+
+    // Queries hand the ids back to index the build input
+    std::vector<uint32_t> loadedIds(header.primitiveCount);
+    std::memcpy(loadedIds.data(), data, loadedIds.size() * sizeof(uint32_t));
+    data += loadedIds.size() * sizeof(uint32_t);
+    for (uint32_t id : loadedIds) {
+        if (id >= header.inputCount) return false;
+    }
+
+    Clear();
+    type = static_cast<BVHPrimitiveType>(header.primitiveType);
+    nodes.swap(loadedNodes);
+    primitiveIds.swap(loadedIds);
+    inputCount = header.inputCount;
+    if (type == BVH_PRIMITIVE_BOX) {
+        boxes.resize(header.primitiveCount);
+        std::memcpy(boxes.data(), data, boxes.size() * sizeof(BoundingBox));
+    }
+    else {
+        corners.resize(size_t(header.primitiveCount) * 3);
+        std::memcpy(corners.data(), data, corners.size() * sizeof(glm::vec3));
+    }
+    return true;
+}
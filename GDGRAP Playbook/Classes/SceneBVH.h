@@ -0,0 +1,86 @@
+// SceneBVH.h
+
+#ifndef SCENEBVH_H
+#define SCENEBVH_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Bounds.h"
+#include "FrustumCuller.h"
+#include "ThreadPool.h"
+
+// Bump whenever the file header or the node layout changes; older files are then rebuilt
+const uint32_t BVH_FILE_VERSION = 2;
+
+// 32-byte flattened node, two per cache line. The children of an interior node are stored next to each
+// other at firstChildOrPrimitive and firstChildOrPrimitive + 1; a leaf covers primitiveCount primitives
+// of the BVH's leaf order starting at firstChildOrPrimitive.
+struct BVHNode {
+    float boundsMin[3];
+    uint32_t firstChildOrPrimitive;
+    float boundsMax[3];
+    uint32_t primitiveCount;    // 0 for interior nodes
+
+    bool IsLeaf() const { return primitiveCount != 0; }
+};
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode must stay 32 bytes");
+
+enum BVHPrimitiveType : uint32_t {
+    BVH_PRIMITIVE_BOX,          // static instances, tested by their world-space boxes
+    BVH_PRIMITIVE_TRIANGLE      // world-space triangles, e.g. the track surface
+};
+
+// Closest hit of a raycast
+struct RayHit {
+    float distance;
+    uint32_t primitive;     // index into the array the BVH was built from
+    glm::vec3 normal;       // faces the ray origin; the entry face for boxes
+};
+
+// Bounding volume hierarchy over a static set of boxes or triangles, built once with a binned SAH and
+// queried every frame. Primitives are stored in leaf order next to the nodes so traversal walks memory
+// mostly forwards; queries report the primitives by their index in the build input.
+class SceneBVH {
+public:
+    SceneBVH();
+
+    // Builds over boxes; empty boxes are skipped and never reported
+    void BuildBoxes(const std::vector<BoundingBox>& boxes, ThreadPool& pool = ThreadPool::Shared());
+    // Builds over triangles given as three consecutive corners each
+    void BuildTriangles(const std::vector<glm::vec3>& corners, ThreadPool& pool = ThreadPool::Shared());
+    void Clear();
+
+    bool IsBuilt() const { return !nodes.empty(); }
+    BVHPrimitiveType GetPrimitiveType() const { return type; }
+    size_t GetNodeCount() const { return nodes.size(); }
+    size_t GetPrimitiveCount() const { return primitiveIds.size(); }
+
+    // Appends every primitive whose box is at least partly inside the frustum
+    void CullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+    // Appends every primitive whose box overlaps the given box (a broad phase for collision)
+    void Overlap(const BoundingBox& box, std::vector<uint32_t>& overlapping) const;
+    // Finds the closest primitive along the ray within maxDistance; direction must be normalized.
+    // Box primitives that contain the origin are skipped, so rays may start inside a prop's box.
+    bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const;
+
+    // sourceHash identifies the build input, so a stale file is rejected by Load and rebuilt by the caller
+    bool Save(const std::string& filename, uint64_t sourceHash) const;
+    bool Load(const std::string& filename, uint64_t sourceHash);
+
+private:
+    void Build(const std::vector<BoundingBox>& primitiveBoxes, ThreadPool& pool);
+    BoundingBox GetPrimitiveBox(size_t leafIndex) const;
+    void AppendSubtree(uint32_t node, std::vector<uint32_t>& primitives) const;
+
+    BVHPrimitiveType type;
+    std::vector<BVHNode> nodes;
+    std::vector<uint32_t> primitiveIds;     // leaf order -> build input index
+    uint32_t inputCount;                    // size of the build input, skipped empty boxes included
+    std::vector<BoundingBox> boxes;         // leaf order, box BVHs only
+    std::vector<glm::vec3> corners;         // leaf order, three per triangle, triangle BVHs only
+};
+
+#endif
@@ -0,0 +1,229 @@
+#include "ShaderProgram.h"
+#include "FrameConstants.h"
+#include "CascadedShadowMap.h"
+#include "ClusteredLights.h"
+#include "LiveryArray.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Nested #include files deeper than this are assumed to include each other
+static const int MAX_INCLUDE_DEPTH = 8;
+
+//Reads a whole shader source file, pasting in the files named by #include "file" lines (relative to the
+//including file's folder; GLSL itself has no includes); returns an empty string if anything cannot be opened
+static std::string ReadShaderSource(const std::string& path, int depth = 0) {
+    std::ifstream file(path);
+    if (!file || depth > MAX_INCLUDE_DEPTH) {
+        std::cout << "Failed to open shader: " << path << std::endl;
+        return std::string();
+    }
+
+    std::string folder = path.substr(0, path.find_last_of("/\\") + 1);
+    std::stringstream buffer;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t open = line.find('"');
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (line.compare(0, 8, "#include") == 0 && close != std::string::npos) {
+            std::string included = ReadShaderSource(folder + line.substr(open + 1, close - open - 1), depth + 1);
+            if (included.empty()) return std::string();
+            buffer << included;
+        }
+        else {
+            buffer << line << '\n';
+        }
+    }
+    return buffer.str();
+}
+
+//Compiles one stage and prints the info log if it fails; returns 0 on failure
+static GLuint CompileStage(GLenum stage, const std::string& path) {
+    std::string source = ReadShaderSource(path);
+    if (source.empty()) return 0;
+
+    const char* text = source.c_str();
+    GLuint shader = glCreateShader(stage);
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cout << "Failed to compile " << path << ":\n" << log << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+//ShaderProgram constructor for a program that is loaded later
+ShaderProgram::ShaderProgram() : program(0) {
+    meshUniforms.tex0 = meshUniforms.normalMap = meshUniforms.liveries = meshUniforms.shadowMap = -1;
+    meshUniforms.lightData = meshUniforms.clusterGrid = meshUniforms.lightIndices = -1;
+}
+
+//ShaderProgram constructor compiles and links the given stages straight away
+ShaderProgram::ShaderProgram(const std::string& vertexPath, const std::string& fragmentPath) : ShaderProgram() {
+    Load(vertexPath, fragmentPath);
+}
+
+ShaderProgram::~ShaderProgram() {
+    if (program) {
+        GLState::ForgetProgram(program);
+        glDeleteProgram(program);
+    }
+}
+
+bool ShaderProgram::Load(const std::string& vertexPath, const std::string& fragmentPath) {
+    if (program) {
+        GLState::ForgetProgram(program);
+        glDeleteProgram(program);
+        program = 0;
+    }
+    uniforms.clear();
+
+    GLuint vertexShader = CompileStage(GL_VERTEX_SHADER, vertexPath);
+    GLuint fragmentShader = CompileStage(GL_FRAGMENT_SHADER, fragmentPath);
+    if (vertexShader && fragmentShader) {
+        program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glLinkProgram(program);
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            char log[1024];
+            glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+            std::cout << "Failed to link " << vertexPath << " + " << fragmentPath << ":\n" << log << std::endl;
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    // The program keeps the compiled stages alive for as long as it needs them
+    if (vertexShader) glDeleteShader(vertexShader);
+    if (fragmentShader) glDeleteShader(fragmentShader);
+
+    ReadUniforms();
+    return program != 0;
+}
+
+//Builds the flat uniform table from the linked program's active uniforms
+void ShaderProgram::ReadUniforms() {
+    if (program) {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<char> name(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, static_cast<GLuint>(i), maxLength, &length, &size, &type, name.data());
+
+            // Uniform block members have no location and are fed through their buffer instead
+            GLint location = glGetUniformLocation(program, name.data());
+            if (location < 0) continue;
+
+            UniformSlot slot;
+            slot.name.assign(name.data(), length);
+            slot.location = location;
+            slot.type = type;
+            slot.hasValue = false;
+
+            // Arrays are reported as "name[0]"; they are looked up by their plain name
+            if (slot.name.size() > 3 && slot.name.compare(slot.name.size() - 3, 3, "[0]") == 0) {
+                slot.name.resize(slot.name.size() - 3);
+            }
+            uniforms.push_back(slot);
+        }
+
+        // GLSL 330 has no layout(binding = N), so the blocks are pointed at their bindings here
+        GLuint frameBlock = glGetUniformBlockIndex(program, "FrameConstants");
+        if (frameBlock != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program, frameBlock, FRAME_CONSTANTS_BINDING);
+        }
+        GLuint shadowBlock = glGetUniformBlockIndex(program, "ShadowConstants");
+        if (shadowBlock != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program, shadowBlock, SHADOW_CONSTANTS_BINDING);
+        }
+        GLuint clusterBlock = glGetUniformBlockIndex(program, "ClusterConstants");
+        if (clusterBlock != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program, clusterBlock, CLUSTER_CONSTANTS_BINDING);
+        }
+    }
+
+    meshUniforms.tex0 = FindUniform("tex0");
+    meshUniforms.normalMap = FindUniform("normalMap");
+    meshUniforms.liveries = FindUniform("liveries");
+    meshUniforms.shadowMap = FindUniform("shadowMap");
+    meshUniforms.lightData = FindUniform("lightData");
+    meshUniforms.clusterGrid = FindUniform("clusterGrid");
+    meshUniforms.lightIndices = FindUniform("lightIndices");
+
+    // Samplers of another type than tex0's would otherwise sit on unit 0 with it until their first bind, and
+    // drawing with two sampler types on one unit is GL_INVALID_OPERATION; give them their own units now
+    if (!program) return;
+    Use();
+    SetInt(meshUniforms.shadowMap, static_cast<GLint>(SHADOW_MAP_TEXTURE_UNIT));
+    SetInt(meshUniforms.lightData, static_cast<GLint>(CLUSTER_LIGHT_DATA_TEXTURE_UNIT));
+    SetInt(meshUniforms.clusterGrid, static_cast<GLint>(CLUSTER_GRID_TEXTURE_UNIT));
+    SetInt(meshUniforms.lightIndices, static_cast<GLint>(CLUSTER_LIGHT_INDEX_TEXTURE_UNIT));
+    SetInt(meshUniforms.liveries, static_cast<GLint>(LIVERY_TEXTURE_UNIT));
+}
+
+//Linear search is fine here: it only runs while setting up, never per draw
+int ShaderProgram::FindUniform(const std::string& name) const {
+    for (size_t i = 0; i < uniforms.size(); i++) {
+        if (uniforms[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+bool ShaderProgram::Changed(int handle, const void* value, size_t size) {
+    if (handle < 0 || handle >= static_cast<int>(uniforms.size())) return false;
+
+    UniformSlot& slot = uniforms[handle];
+    if (slot.hasValue && std::memcmp(slot.value, value, size) == 0) return false;
+
+    std::memcpy(slot.value, value, size);
+    slot.hasValue = true;
+    return true;
+}
+
+void ShaderProgram::SetInt(int handle, GLint value) {
+    if (Changed(handle, &value, sizeof(value))) {
+        glUniform1i(uniforms[handle].location, value);
+    }
+}
+
+void ShaderProgram::SetFloat(int handle, GLfloat value) {
+    if (Changed(handle, &value, sizeof(value))) {
+        glUniform1f(uniforms[handle].location, value);
+    }
+}
+
+void ShaderProgram::SetVec3(int handle, const glm::vec3& value) {
+    if (Changed(handle, glm::value_ptr(value), sizeof(value))) {
+        glUniform3fv(uniforms[handle].location, 1, glm::value_ptr(value));
+    }
+}
+
+void ShaderProgram::SetVec4(int handle, const glm::vec4& value) {
+    if (Changed(handle, glm::value_ptr(value), sizeof(value))) {
+        glUniform4fv(uniforms[handle].location, 1, glm::value_ptr(value));
+    }
+}
+
+void ShaderProgram::SetMat4(int handle, const glm::mat4& value) {
+    if (Changed(handle, glm::value_ptr(value), sizeof(value))) {
+        glUniformMatrix4fv(uniforms[handle].location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+}
@@ -0,0 +1,76 @@
+// ShaderProgram.h
+
+#ifndef SHADERPROGRAM_H
+#define SHADERPROGRAM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "GLState.h"
+#include <string>
+#include <vector>
+
+// Linked GL program with its active uniforms read back once after linking.
+// Uniforms are addressed by a handle (an index into a flat table) found once at setup with FindUniform,
+// so drawing never passes a string to the driver. Each slot remembers the last value uploaded, and the
+// setters return without a GL call when the value has not changed.
+// The setters use glUniform*, so the program must be bound with Use() first.
+// A FrameConstants uniform block, if the program declares one, is attached to FRAME_CONSTANTS_BINDING,
+// a ShadowConstants block to SHADOW_CONSTANTS_BINDING and a ClusterConstants block to CLUSTER_CONSTANTS_BINDING.
+// The shadow, cluster and livery samplers are pointed at their fixed texture units at link time as well.
+class ShaderProgram {
+public:
+    // Handles of the uniforms Model::Draw sets on every mesh shader; -1 when the program lacks one
+    struct MeshUniforms {
+        int tex0;
+        int normalMap;
+        int liveries;
+        int shadowMap;
+        int lightData;
+        int clusterGrid;
+        int lightIndices;
+    };
+
+    ShaderProgram();
+    ShaderProgram(const std::string& vertexPath, const std::string& fragmentPath);
+    ~ShaderProgram();
+
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    // Compiles and links the two stages, replacing any previous program; prints the info log on failure.
+    // Sources may pull in shared code with #include "file", resolved relative to the including file.
+    bool Load(const std::string& vertexPath, const std::string& fragmentPath);
+
+    void Use() const { GLState::UseProgram(program); }
+    GLuint GetID() const { return program; }
+    bool IsLinked() const { return program != 0; }
+
+    // Returns -1 for names that are not active uniforms (including ones the compiler optimized out)
+    int FindUniform(const std::string& name) const;
+    const MeshUniforms& GetMeshUniforms() const { return meshUniforms; }
+
+    void SetInt(int handle, GLint value);
+    void SetFloat(int handle, GLfloat value);
+    void SetVec3(int handle, const glm::vec3& value);
+    void SetVec4(int handle, const glm::vec4& value);
+    void SetMat4(int handle, const glm::mat4& value);
+
+private:
+    struct UniformSlot {
+        std::string name;
+        GLint location;
+        GLenum type;
+        bool hasValue;
+        GLfloat value[16];
+    };
+
+    void ReadUniforms();
+    // Stores the value in the slot and returns true if it differs from the last upload
+    bool Changed(int handle, const void* value, size_t size);
+
+    GLuint program;
+    std::vector<UniformSlot> uniforms;
+    MeshUniforms meshUniforms;
+};
+
+#endif
@@ -1,43 +1,24 @@
 #include "Skybox.h"
+#include "AssetCache.h"
+#include "ThreadPool.h"
+#include "GLState.h"
 #include "../stb_image.h"
+#include <algorithm>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <stdexcept>
+#include <memory>
+#include <vector>
 #include <glm/gtc/matrix_transform.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 
 // Skybox Constructor
-Skybox::Skybox(const std::vector<std::string>& faces)
+Skybox::Skybox(const std::vector<std::string>& faces, bool immutableStorage) :
+    skyboxShader("Shaders/skybox.vert", "Shaders/skybox.frag")
 {
-    std::fstream sky_vertSrc("Shaders/skybox.vert");
-    std::stringstream sky_vertBuff;
-    sky_vertBuff << sky_vertSrc.rdbuf();
+    skyboxUniform = skyboxShader.FindUniform("skybox");
 
-    std::string sky_vertS = sky_vertBuff.str();
-    const char* sky_v = sky_vertS.c_str();
-
-    std::fstream sky_fragSrc("Shaders/skybox.frag");
-    std::stringstream sky_fragBuff;
-    sky_fragBuff << sky_fragSrc.rdbuf();
-    std::string sky_fragS = sky_fragBuff.str();
-    const char* sky_f = sky_fragS.c_str();
-
-    GLuint sky_vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(sky_vertexShader, 1, &sky_v, NULL);
-    glCompileShader(sky_vertexShader);
-
-    GLuint sky_fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(sky_fragShader, 1, &sky_f, NULL);
-    glCompileShader(sky_fragShader);
-
-    skyboxShader = glCreateProgram();
-    glAttachShader(skyboxShader, sky_vertexShader);
-    glAttachShader(skyboxShader, sky_fragShader);
-    glLinkProgram(skyboxShader);
-
-    cubemapTexture = LoadCubemap(faces);
+    cubemapTexture = LoadCubemap(faces, immutableStorage);
 
     float skyboxVertices[] = {
         -1.f, -1.f, 1.f,  
@@ -63,7 +44,7 @@ Skybox::Skybox(const std::vector<std::string>& faces)
     glGenBuffers(1, &skyboxVBO);
     glGenBuffers(1, &skyboxEBO);
 
-    glBindVertexArray(skyboxVAO);
+    GLState::BindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
 
@@ -76,6 +57,8 @@ Skybox::Skybox(const std::vector<std::string>& faces)
 // Skybox Destructor
 Skybox::~Skybox()
 {
+    GLState::ForgetVertexArray(skyboxVAO);
+    GLState::ForgetTexture(cubemapTexture);
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
     glDeleteBuffers(1, &skyboxEBO);
@@ -83,47 +66,62 @@ Skybox::~Skybox()
 }
 
 // Draw function which renders our skybox
-void Skybox::Draw(const glm::mat4& view, const glm::mat4& projection)
+void Skybox::Draw()
 {
-    glDepthFunc(GL_LEQUAL); 
-    glUseProgram(skyboxShader);
+    GLState::DepthFunc(GL_LEQUAL);
+    skyboxShader.Use();
 
-   
-    glm::mat4 viewMat = glm::mat4(glm::mat3(view));  
-    glUniformMatrix4fv(glGetUniformLocation(skyboxShader, "view"), 1, GL_FALSE, &viewMat[0][0]);
-    glUniformMatrix4fv(glGetUniformLocation(skyboxShader, "projection"), 1, GL_FALSE, &projection[0][0]);
+    skyboxShader.SetInt(skyboxUniform, 0);
 
-    glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(100.0f)); 
-    glUniformMatrix4fv(glGetUniformLocation(skyboxShader, "model"), 1, GL_FALSE, &model[0][0]);
-
-    glBindVertexArray(skyboxVAO);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    GLState::BindVertexArray(skyboxVAO);
+    GLState::BindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
     glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 
-    glDepthFunc(GL_LESS); 
+    GLState::DepthFunc(GL_LESS);
 }
 
-// Loads the cubemap texture of the skybox
-GLuint Skybox::LoadCubemap(const std::vector<std::string>& faces)
+// Decodes one cubemap face; runs on a loader thread
+static void DecodeCubemapFace(const std::string& filename, ImageData& image)
 {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    stbi_set_flip_vertically_on_load(false);
+    unsigned char* data = stbi_load(filename.c_str(), &image.width, &image.height, &image.channels, 0);
+    if (data) {
+        image.pixels = std::shared_ptr<unsigned char>(data, stbi_image_free);
+    }
+    else {
+        std::cout << "Cubemap texture failed to load at path: " << filename << std::endl;
+    }
+}
 
-    for (GLuint i = 0; i < faces.size(); i++) {
-        int width, height, nrChannels;
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        }
-        else {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+// Uploads one decoded face. With immutable storage (storageWidth > 0) the face is copied into the
+// preallocated level; otherwise the face image is (re)defined.
+static void UploadCubemapFace(GLuint textureID, GLuint face, const ImageData& image, int storageWidth, int storageHeight)
+{
+    if (!image.pixels) return;
+
+    GLenum format = image.channels == 4 ? GL_RGBA : GL_RGB;
+    GLState::BindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
+    if (storageWidth > 0) {
+        if (image.width != storageWidth || image.height != storageHeight) {
+            std::cout << "Cubemap face size does not match the other faces" << std::endl;
+            return;
         }
-        stbi_image_free(data);
+        glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, 0, 0, image.width, image.height, format, GL_UNSIGNED_BYTE, image.pixels.get());
     }
+    else {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
+    }
+}
+
+// Loads the cubemap texture of the skybox.
+// The six faces are decoded concurrently on the loader threads and uploaded on the GL thread. With async
+// loading every face is its own load and is uploaded as soon as it arrives; until then the face is a dark
+// placeholder color.
+// With immutable storage the cubemap is allocated once up front (size read from the first face's header).
+GLuint Skybox::LoadCubemap(const std::vector<std::string>& faces, bool immutableStorage)
+{
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    GLState::BindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
 
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -131,5 +129,59 @@ GLuint Skybox::LoadCubemap(const std::vector<std::string>& faces)
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
+    stbi_set_flip_vertically_on_load(false);
+
+    AssetCache& cache = AssetCache::Instance();
+    unsigned char placeholder[3] = { 16, 16, 24 };
+    int storageWidth = 0, storageHeight = 0, channels;
+    bool canUseStorage = GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_storage;
+    if (immutableStorage && canUseStorage && !faces.empty() && stbi_info(faces[0].c_str(), &storageWidth, &storageHeight, &channels)) {
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, GL_RGB8, storageWidth, storageHeight);
+        // Immutable faces are undefined until written, so each one is filled with the placeholder color
+        // before the sky can be drawn. Texels are RGBA so the rows need no unpack alignment.
+        if (cache.IsAsyncLoading()) {
+            std::vector<unsigned char> face(size_t(storageWidth) * storageHeight * 4);
+            for (size_t texel = 0; texel < face.size(); texel += 4) {
+                std::copy(placeholder, placeholder + 3, face.begin() + texel);
+                face[texel + 3] = 255;
+            }
+            for (GLuint i = 0; i < 6; i++) {
+                glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, storageWidth, storageHeight, GL_RGBA, GL_UNSIGNED_BYTE, face.data());
+            }
+        }
+    }
+    else {
+        storageWidth = storageHeight = 0;
+        if (cache.IsAsyncLoading()) {
+            for (GLuint i = 0; i < 6; i++) {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, placeholder);
+            }
+        }
+    }
+
+    if (cache.IsAsyncLoading()) {
+        for (GLuint i = 0; i < faces.size(); i++) {
+            std::string face = faces[i];
+            cache.QueueLoad([textureID, i, face, storageWidth, storageHeight]() -> std::function<void()> {
+                std::shared_ptr<ImageData> image = std::make_shared<ImageData>();
+                DecodeCubemapFace(face, *image);
+                return [textureID, i, image, storageWidth, storageHeight]() {
+                    UploadCubemapFace(textureID, i, *image, storageWidth, storageHeight);
+                };
+            });
+        }
+    }
+    else {
+        std::vector<ImageData> images(faces.size());
+        ThreadPool::Shared().ParallelFor(faces.size(), 1, [&faces, &images](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                DecodeCubemapFace(faces[i], images[i]);
+            }
+        });
+        for (GLuint i = 0; i < images.size(); i++) {
+            UploadCubemapFace(textureID, i, images[i], storageWidth, storageHeight);
+        }
+    }
+
     return textureID;
 }
@@ -5,25 +5,25 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <string>
+#include "ShaderProgram.h"
 
 class Skybox {
 public:
-    // Constructor and Destructor
-    Skybox(const std::vector<std::string>& faces);
+    // Constructor and Destructor; immutableStorage allocates the cubemap once with glTexStorage2D (GL 4.2+)
+    Skybox(const std::vector<std::string>& faces, bool immutableStorage = false);
     ~Skybox();
 
     // Method to render the skybox
-    void Draw(const glm::mat4& view, const glm::mat4& projection);
+    // Camera matrices are read from the FrameConstants buffer
+    void Draw();
 
 private:
     GLuint skyboxVAO, skyboxVBO, cubemapTexture, skyboxEBO;  // Added skyboxEBO declaration
-    GLuint skyboxShader;
+    ShaderProgram skyboxShader;
+    int skyboxUniform;
 
     // Method to load cubemap textures
-    GLuint LoadCubemap(const std::vector<std::string>& faces);
-
-    // Optional: Method to load shaders (if you need to implement it separately)
-    GLuint LoadShader(const char* vertexPath, const char* fragmentPath);
+    GLuint LoadCubemap(const std::vector<std::string>& faces, bool immutableStorage);
 };
 
 #endif
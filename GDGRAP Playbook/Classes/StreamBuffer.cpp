@@ -0,0 +1,170 @@
+#include "StreamBuffer.h"
+#include <cstring>
+#include <iostream>
+
+// How long one wait on a frame fence lasts before it is retried, in nanoseconds
+static const GLuint64 FENCE_TIMEOUT = 1000000000;
+
+StreamBuffer::StreamBuffer() :
+    persistentMapping(true), buffer(0), mapping(nullptr), frameSize(0),
+    region(0), head(0), regionEnd(0), fences(), uniformAlignment(256), orphaned(false), stalls(0) {
+}
+
+//Deletes without waiting; the context may already be gone when the statics are destroyed
+StreamBuffer::~StreamBuffer() {
+    if (!buffer) return;
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+    }
+    for (const Retired& old : retired) {
+        glDeleteSync(old.fence);
+        glDeleteBuffers(1, &old.buffer);
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+StreamBuffer& StreamBuffer::Instance() {
+    static StreamBuffer stream;
+    return stream;
+}
+
+//Goes through GL_COPY_WRITE_BUFFER so no vertex array or indexed binding is disturbed
+void StreamBuffer::Create(GLsizeiptr frameSize) {
+    this->frameSize = frameSize;
+    region = 0;
+    head = 0;
+    regionEnd = frameSize;
+    orphaned = true;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (persistentMapping && (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage)) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, STREAM_BUFFER_FRAMES * frameSize, nullptr, flags);
+        mapping = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, STREAM_BUFFER_FRAMES * frameSize, flags));
+        if (!mapping) {
+            // Immutable storage cannot be respecified, so start over with a plain buffer
+            std::cout << "Stream buffer could not be mapped persistently; falling back to orphaning" << std::endl;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+            persistentMapping = false;
+            Create(frameSize);
+            return;
+        }
+    }
+    else {
+        mapping = nullptr;
+        glBufferData(GL_COPY_WRITE_BUFFER, frameSize, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+//Draws already issued still read the old buffer, so it is only deleted once they have finished
+void StreamBuffer::Grow(GLsizeiptr size) {
+    GLsizeiptr grown = frameSize * 2;
+    while (grown < size) grown *= 2;
+
+    if (mapping) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    Retired old = { buffer, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) };
+    retired.push_back(old);
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    Create(grown);
+}
+
+void* StreamBuffer::Map(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset) {
+    if (!buffer) {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+        Create(STREAM_BUFFER_FRAME_SIZE);
+    }
+
+    offset = (head + alignment - 1) / alignment * alignment;
+    if (offset + size > regionEnd) {
+        Grow(size + alignment);
+        offset = head;
+    }
+    head = offset + size;
+    if (mapping) return mapping + offset;
+
+    // Fresh storage each frame, so this frame's ranges never overlap one the GPU is still reading
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (!orphaned) {
+        glBufferData(GL_COPY_WRITE_BUFFER, frameSize, nullptr, GL_STREAM_DRAW);
+        orphaned = true;
+    }
+    return glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void StreamBuffer::Unmap() {
+    if (mapping) return;
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+//Empty writes reserve nothing and only report where the next write would go
+GLintptr StreamBuffer::Write(const void* data, GLsizeiptr size, GLsizeiptr alignment) {
+    GLintptr offset;
+    if (size <= 0) {
+        offset = (head + alignment - 1) / alignment * alignment;
+        return offset;
+    }
+    void* destination = Map(size, alignment, offset);
+    if (destination) std::memcpy(destination, data, size);
+    Unmap();
+    return offset;
+}
+
+void StreamBuffer::WriteUniforms(GLuint binding, const void* data, GLsizeiptr size) {
+    GLintptr offset = Write(data, size, uniformAlignment);
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+}
+
+//Blocks until the GPU is done with the region; the first check does not wait, so a ring that is deep enough
+//never stalls
+void StreamBuffer::WaitForRegion(int region) {
+    GLsync& fence = fences[region];
+    if (!fence) return;
+
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        stalls++;
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED) {
+        }
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void StreamBuffer::DeleteRetired() {
+    size_t kept = 0;
+    for (const Retired& old : retired) {
+        if (glClientWaitSync(old.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            retired[kept++] = old;
+            continue;
+        }
+        glDeleteSync(old.fence);
+        glDeleteBuffers(1, &old.buffer);
+    }
+    retired.resize(kept);
+}
+
+void StreamBuffer::EndFrame() {
+    if (!buffer) return;
+    DeleteRetired();
+
+    if (!mapping) {
+        head = 0;
+        orphaned = false;
+        return;
+    }
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % STREAM_BUFFER_FRAMES;
+    WaitForRegion(region);
+    head = region * frameSize;
+    regionEnd = head + frameSize;
+}
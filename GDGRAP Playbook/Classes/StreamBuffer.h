@@ -0,0 +1,84 @@
+// StreamBuffer.h
+
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+// Frames the GPU may still be reading while the CPU writes the next one
+const int STREAM_BUFFER_FRAMES = 3;
+// Bytes each frame starts with; a frame that writes more grows the ring
+const GLsizeiptr STREAM_BUFFER_FRAME_SIZE = 1 << 20;
+
+// Ring buffer for data written every frame: instance streams, indirect commands and per-frame uniform blocks.
+//
+// With GL 4.4 or ARB_buffer_storage the ring is one persistently and coherently mapped buffer cut into
+// STREAM_BUFFER_FRAMES regions. Writes go straight into the mapping, and EndFrame puts a fence after each
+// frame's region, waiting only if the GPU has not yet finished the frame that last used the next one. Without
+// it, the buffer is orphaned at the start of every frame and each write maps its range unsynchronized.
+//
+// Offsets are only good for the frame they were handed out in, and the buffer can be replaced when a frame
+// outgrows it, so users rebind GetBuffer at the returned offset after every write rather than once at startup.
+// Data that must survive more than a frame does not belong here. The GL objects are created on the first Map.
+class StreamBuffer {
+public:
+    // The ring shared by every per-frame stream
+    static StreamBuffer& Instance();
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Orphaning is used even where buffer storage is available; only takes effect before the first Map
+    void SetPersistentMapping(bool enabled) { persistentMapping = enabled; }
+
+    // Reserves size bytes at a multiple of alignment and returns the memory to write them to, which stays
+    // writable until Unmap
+    void* Map(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+    // Ends the last Map's writes; nothing to do for the persistent mapping
+    void Unmap();
+    // Map, copy and Unmap in one; returns the offset the data landed at
+    GLintptr Write(const void* data, GLsizeiptr size, GLsizeiptr alignment = 16);
+    // Writes a std140 block and binds its range to the uniform buffer binding point
+    void WriteUniforms(GLuint binding, const void* data, GLsizeiptr size);
+
+    // Call once per frame after its last draw
+    void EndFrame();
+
+    GLuint GetBuffer() const { return buffer; }
+    bool IsPersistent() const { return mapping != nullptr; }
+    // Frames that had to wait on the GPU before reusing a region; stays at zero while the ring is deep enough
+    size_t GetStallCount() const { return stalls; }
+
+private:
+    StreamBuffer();
+
+    void Create(GLsizeiptr frameSize);
+    // Retires the current buffer and creates one whose frames hold at least size bytes
+    void Grow(GLsizeiptr size);
+    void WaitForRegion(int region);
+    // Deletes the replaced buffers the GPU has finished with
+    void DeleteRetired();
+
+    // A replaced buffer, deleted once the GPU has passed its fence
+    struct Retired {
+        GLuint buffer;
+        GLsync fence;
+    };
+
+    bool persistentMapping;
+    GLuint buffer;
+    char* mapping;                  // the whole buffer while persistently mapped
+    GLsizeiptr frameSize;
+    int region;
+    GLintptr head, regionEnd;
+    GLsync fences[STREAM_BUFFER_FRAMES];
+    std::vector<Retired> retired;
+    GLint uniformAlignment;
+    bool orphaned;                  // fallback only: the buffer was respecified this frame
+    size_t stalls;
+};
+
+#endif
@@ -0,0 +1,53 @@
+// Texture.h
+
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+#include <memory>
+#include "GLState.h"
+
+// Block compression used for a cooked texture. AUTO picks BC5 for normal maps and BC7 (or BC1/BC3 without
+// BPTC support) for everything else; NONE keeps the old uncompressed upload with runtime mip generation.
+enum TextureCompression {
+    TEXTURE_COMPRESSION_NONE,
+    TEXTURE_COMPRESSION_AUTO,
+    TEXTURE_COMPRESSION_BC1,
+    TEXTURE_COMPRESSION_BC3,
+    TEXTURE_COMPRESSION_BC5,
+    TEXTURE_COMPRESSION_BC7
+};
+
+// Decoded pixels waiting to be uploaded on the GL thread
+struct ImageData {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::shared_ptr<unsigned char> pixels;
+};
+
+// Owns a GL texture object so it can be shared between Models.
+// The ID never changes; an asynchronously loaded texture starts as a 1x1 placeholder in the same object.
+class Texture {
+public:
+    explicit Texture(GLuint id) : id(id), ready(false) {}
+    ~Texture() {
+        if (id) {
+            GLState::ForgetTexture(id);
+            glDeleteTextures(1, &id);
+        }
+    }
+
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
+    GLuint GetID() const { return id; }
+    bool IsReady() const { return ready; }
+    void SetReady() { ready = true; }
+
+private:
+    GLuint id;
+    bool ready;
+};
+
+#endif
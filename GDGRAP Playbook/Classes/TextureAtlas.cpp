@@ -0,0 +1,408 @@
+#include "TextureAtlas.h"
+#include "MappedFile.h"
+#include "Model.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// How far outside [0, 1] a texture coordinate may stray and still count as inside, for exporter rounding
+static const float UV_TOLERANCE = 1e-3f;
+// A normal map may be at most this many times the size of its texture on either axis; bilinear resampling
+// skips texels past 2x, so anything larger would lose its detail in the atlas
+static const int NORMAL_MAP_MAX_SCALE = 2;
+
+SkylinePacker::SkylinePacker(int width, int height) : width(width), height(height) {
+    Segment floor = { 0, 0, width };
+    skyline.push_back(floor);
+}
+
+int SkylinePacker::Fit(size_t i, int rectWidth, int rectHeight) const {
+    if (skyline[i].x + rectWidth > width) return -1;
+
+    int y = 0;
+    for (int covered = 0; covered < rectWidth; i++) {
+        y = std::max(y, skyline[i].y);
+        if (y + rectHeight > height) return -1;
+        covered += skyline[i].width;
+    }
+    return y;
+}
+
+//Places the rect at the lowest spot, then raises the skyline over it and merges segments of equal height
+bool SkylinePacker::Insert(int rectWidth, int rectHeight, AtlasRect& rect) {
+    int bestY = INT_MAX;
+    size_t best = 0;
+    for (size_t i = 0; i < skyline.size(); i++) {
+        int y = Fit(i, rectWidth, rectHeight);
+        if (y >= 0 && y < bestY) {
+            bestY = y;
+            best = i;
+        }
+    }
+    if (bestY == INT_MAX) return false;
+
+    rect.x = skyline[best].x;
+    rect.y = bestY;
+    rect.width = rectWidth;
+    rect.height = rectHeight;
+
+    Segment placed = { rect.x, rect.y + rectHeight, rectWidth };
+    skyline.insert(skyline.begin() + best, placed);
+    int right = placed.x + placed.width;
+    for (size_t i = best + 1; i < skyline.size();) {
+        Segment& segment = skyline[i];
+        if (segment.x >= right) break;
+        int covered = right - segment.x;
+        if (segment.width <= covered) {
+            skyline.erase(skyline.begin() + i);
+            continue;
+        }
+        segment.x += covered;
+        segment.width -= covered;
+        break;
+    }
+
+    for (size_t i = 0; i + 1 < skyline.size();) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else {
+            i++;
+        }
+    }
+    return true;
+}
+
+//Imports the mesh without tangents or LODs and checks every texture coordinate
+static bool UVsInUnitSquare(const std::string& meshFilename) {
+    MeshImportOptions options;
+    options.generateTangents = false;
+    options.generateLODs = false;
+    MeshData data;
+    Model::LoadModel(meshFilename, options, data);
+    if (data.vertices.empty()) return false;
+
+    for (const Vertex& vertex : data.vertices) {
+        if (vertex.texCoord.x < -UV_TOLERANCE || vertex.texCoord.x > 1.0f + UV_TOLERANCE ||
+            vertex.texCoord.y < -UV_TOLERANCE || vertex.texCoord.y > 1.0f + UV_TOLERANCE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Bilinearly resamples an RGBA image to the given size, clamping at the edges
+static ImageData Resample(const ImageData& source, int width, int height) {
+    if (source.width == width && source.height == height) return source;
+
+    ImageData image;
+    image.width = width;
+    image.height = height;
+    image.channels = 4;
+    image.pixels = std::shared_ptr<unsigned char>(new unsigned char[size_t(width) * height * 4], std::default_delete<unsigned char[]>());
+
+    const unsigned char* from = source.pixels.get();
+    unsigned char* to = image.pixels.get();
+    for (int y = 0; y < height; y++) {
+        float sy = std::min(std::max((y + 0.5f) * source.height / height - 0.5f, 0.0f), float(source.height - 1));
+        int y0 = static_cast<int>(sy);
+        int y1 = std::min(y0 + 1, source.height - 1);
+        float fy = sy - y0;
+        for (int x = 0; x < width; x++) {
+            float sx = std::min(std::max((x + 0.5f) * source.width / width - 0.5f, 0.0f), float(source.width - 1));
+            int x0 = static_cast<int>(sx);
+            int x1 = std::min(x0 + 1, source.width - 1);
+            float fx = sx - x0;
+            for (int channel = 0; channel < 4; channel++) {
+                float top = from[(size_t(y0) * source.width + x0) * 4 + channel] * (1.0f - fx) + from[(size_t(y0) * source.width + x1) * 4 + channel] * fx;
+                float bottom = from[(size_t(y1) * source.width + x0) * 4 + channel] * (1.0f - fx) + from[(size_t(y1) * source.width + x1) * 4 + channel] * fx;
+                to[(size_t(y) * width + x) * 4 + channel] = static_cast<unsigned char>(top * (1.0f - fy) + bottom * fy + 0.5f);
+            }
+        }
+    }
+    return image;
+}
+
+//Scales the RGB of every texel back to a unit normal; blending neighbours shortens them, which would dim the
+//lighting wherever the normals vary
+static void Renormalize(ImageData& image) {
+    unsigned char* texel = image.pixels.get();
+    for (size_t i = 0, count = size_t(image.width) * image.height; i < count; i++, texel += 4) {
+        glm::vec3 normal = glm::vec3(texel[0], texel[1], texel[2]) / 127.5f - 1.0f;
+        float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        for (int channel = 0; channel < 3; channel++) {
+            texel[channel] = static_cast<unsigned char>(std::min(std::max((normal[channel] + 1.0f) * 127.5f + 0.5f, 0.0f), 255.0f));
+        }
+    }
+}
+
+//Copies the image into its padded rect, repeating the edge texels out to the rect's border
+static void Blit(std::vector<unsigned char>& atlas, int atlasWidth, const AtlasRect& padded, const ImageData& image) {
+    for (int y = padded.y; y < padded.y + padded.height; y++) {
+        int sy = std::min(std::max(y - padded.y - TEXTURE_ATLAS_PADDING, 0), image.height - 1);
+        for (int x = padded.x; x < padded.x + padded.width; x++) {
+            int sx = std::min(std::max(x - padded.x - TEXTURE_ATLAS_PADDING, 0), image.width - 1);
+            const unsigned char* from = image.pixels.get() + (size_t(sy) * image.width + sx) * 4;
+            std::copy(from, from + 4, atlas.begin() + (size_t(y) * atlasWidth + x) * 4);
+        }
+    }
+}
+
+//Uncompressed 32-bit TGA with a top-left origin, so stb_image reads the rows back in the order they were written
+static bool WriteTGA(const std::string& filename, const std::vector<unsigned char>& pixels, int width, int height) {
+    unsigned char header[18] = {};
+    header[2] = 2;
+    header[12] = width & 0xff;
+    header[13] = (width >> 8) & 0xff;
+    header[14] = height & 0xff;
+    header[15] = (height >> 8) & 0xff;
+    header[16] = 32;
+    header[17] = 0x28;
+
+    std::vector<unsigned char> bgra(pixels);
+    for (size_t i = 0; i < bgra.size(); i += 4) {
+        std::swap(bgra[i], bgra[i + 2]);
+    }
+
+    std::string tempFilename = filename + ".tmp";
+    bool written;
+    {
+        std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cout << "Failed to write texture atlas: " << filename << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(bgra.data()), bgra.size());
+        out.close();
+        written = !out.fail();
+    }
+    if (!written) {
+        std::cout << "Failed to write texture atlas: " << filename << std::endl;
+        std::remove(tempFilename.c_str());
+        return false;
+    }
+
+    std::remove(filename.c_str());
+    return std::rename(tempFilename.c_str(), filename.c_str()) == 0;
+}
+
+//Rounds a size up to the next multiple of TEXTURE_ATLAS_ALIGNMENT
+static int AlignSize(int size) {
+    return (size + TEXTURE_ATLAS_ALIGNMENT - 1) / TEXTURE_ATLAS_ALIGNMENT * TEXTURE_ATLAS_ALIGNMENT;
+}
+
+//Every file the atlas was built from, once each, in entry order
+static std::vector<std::string> GetSources(const std::vector<AtlasEntry>& entries) {
+    std::vector<std::string> sources;
+    for (const AtlasEntry& entry : entries) {
+        for (const std::string* filename : { &entry.meshFilename, &entry.textureFilename, &entry.normalMapFilename }) {
+            if (filename->empty() || std::find(sources.begin(), sources.end(), *filename) != sources.end()) continue;
+            sources.push_back(*filename);
+        }
+    }
+    return sources;
+}
+
+TextureAtlas::TextureAtlas(const std::string& name, const std::vector<AtlasEntry>& entries) :
+    entries(entries),
+    rects(entries.size(), AtlasRect{ 0, 0, 0, 0 }),
+    width(0), height(0),
+    textureFilename(name + ".tga"),
+    normalMapFilename(name + "_normal.tga") {
+    if (!ReadManifest(name, entries)) {
+        std::cout << "Texture atlas " << name << " is missing or out of date; its props keep their own textures " <<
+            "until it is rebuilt with --cook-atlas" << std::endl;
+    }
+}
+
+//Packs the tallest images first, in the smallest power-of-two page that takes them all; anything that
+//still does not fit at TEXTURE_ATLAS_MAX_SIZE is left out
+bool TextureAtlas::Build(const std::string& name, const std::vector<AtlasEntry>& entries) {
+    std::vector<ImageData> images(entries.size()), normalMaps(entries.size());
+    std::vector<size_t> order;
+    int area = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const AtlasEntry& entry = entries[i];
+        if (!Model::DecodeTexture(entry.textureFilename, images[i], 4)) continue;
+
+        if (images[i].width > TEXTURE_ATLAS_MAX_IMAGE_SIZE || images[i].height > TEXTURE_ATLAS_MAX_IMAGE_SIZE) {
+            std::cout << entry.textureFilename << " is " << images[i].width << "x" << images[i].height <<
+                ", too large for the atlas; it keeps its own texture" << std::endl;
+            images[i] = ImageData();
+            continue;
+        }
+        if (!UVsInUnitSquare(entry.meshFilename)) {
+            std::cout << entry.meshFilename << " has texture coordinates outside [0, 1]; it keeps its own texture" << std::endl;
+            images[i] = ImageData();
+            continue;
+        }
+
+        // A normal map covers the same UVs as the texture, so it is stretched to the texture's size
+        ImageData normalMap;
+        if (!entry.normalMapFilename.empty() && Model::DecodeTexture(entry.normalMapFilename, normalMap, 4)) {
+            if (normalMap.width > images[i].width * NORMAL_MAP_MAX_SCALE || normalMap.height > images[i].height * NORMAL_MAP_MAX_SCALE) {
+                std::cout << entry.normalMapFilename << " is " << normalMap.width << "x" << normalMap.height <<
+                    ", too much larger than its texture for the atlas; it keeps its own textures" << std::endl;
+                images[i] = ImageData();
+                continue;
+            }
+            normalMaps[i] = Resample(normalMap, images[i].width, images[i].height);
+            if (normalMaps[i].pixels != normalMap.pixels) Renormalize(normalMaps[i]);
+        }
+
+        order.push_back(i);
+        area += AlignSize(images[i].width + 2 * TEXTURE_ATLAS_PADDING) * AlignSize(images[i].height + 2 * TEXTURE_ATLAS_PADDING);
+    }
+    if (order.empty()) return false;
+
+    std::sort(order.begin(), order.end(), [&images](size_t a, size_t b) {
+        if (images[a].height != images[b].height) return images[a].height > images[b].height;
+        return images[a].width > images[b].width;
+    });
+
+    int atlasWidth = TEXTURE_ATLAS_ALIGNMENT, atlasHeight = TEXTURE_ATLAS_ALIGNMENT;
+    while (atlasWidth * atlasHeight < area && atlasWidth < TEXTURE_ATLAS_MAX_SIZE) {
+        atlasWidth *= 2;
+        if (atlasWidth * atlasHeight < area) atlasHeight *= 2;
+    }
+
+    std::vector<AtlasRect> padded(entries.size(), AtlasRect{ 0, 0, 0, 0 });
+    for (;;) {
+        SkylinePacker packer(atlasWidth, atlasHeight);
+        bool packedAll = true;
+        for (size_t i : order) {
+            int paddedWidth = AlignSize(images[i].width + 2 * TEXTURE_ATLAS_PADDING);
+            int paddedHeight = AlignSize(images[i].height + 2 * TEXTURE_ATLAS_PADDING);
+            if (!packer.Insert(paddedWidth, paddedHeight, padded[i])) {
+                padded[i] = AtlasRect{ 0, 0, 0, 0 };
+                packedAll = false;
+            }
+        }
+        if (packedAll || (atlasWidth >= TEXTURE_ATLAS_MAX_SIZE && atlasHeight >= TEXTURE_ATLAS_MAX_SIZE)) break;
+
+        if (atlasWidth <= atlasHeight) atlasWidth *= 2;
+        else atlasHeight *= 2;
+    }
+
+    std::vector<unsigned char> albedo(size_t(atlasWidth) * atlasHeight * 4, 0);
+    std::vector<unsigned char> normals(size_t(atlasWidth) * atlasHeight * 4);
+    for (size_t texel = 0; texel < normals.size(); texel += 4) {
+        normals[texel + 0] = 128;
+        normals[texel + 1] = 128;
+        normals[texel + 2] = 255;
+        normals[texel + 3] = 255;
+    }
+
+    ImageData flat;
+    flat.width = flat.height = 1;
+    flat.channels = 4;
+    flat.pixels = std::shared_ptr<unsigned char>(new unsigned char[4]{ 128, 128, 255, 255 }, std::default_delete<unsigned char[]>());
+
+    std::ostringstream manifest;
+    manifest << "atlas " << TEXTURE_ATLAS_VERSION << " " << atlasWidth << " " << atlasHeight << "\n";
+    for (size_t i = 0; i < entries.size(); i++) {
+        const AtlasEntry& entry = entries[i];
+        AtlasRect rect = { 0, 0, 0, 0 };
+        if (padded[i].width > 0) {
+            Blit(albedo, atlasWidth, padded[i], images[i]);
+            Blit(normals, atlasWidth, padded[i], normalMaps[i].pixels ? normalMaps[i] : flat);
+            rect = { padded[i].x + TEXTURE_ATLAS_PADDING, padded[i].y + TEXTURE_ATLAS_PADDING, images[i].width, images[i].height };
+        }
+        else if (images[i].pixels) {
+            std::cout << entry.textureFilename << " did not fit in the atlas; it keeps its own texture" << std::endl;
+        }
+        manifest << "entry " << entry.meshFilename << " " << entry.textureFilename << " " <<
+            (entry.normalMapFilename.empty() ? "-" : entry.normalMapFilename) << " " <<
+            rect.x << " " << rect.y << " " << rect.width << " " << rect.height << "\n";
+    }
+    for (const std::string& source : GetSources(entries)) {
+        uint64_t size = 0, modifiedTime = 0;
+        MappedFile::StatFile(source, size, modifiedTime);
+        manifest << "source " << source << " " << size << " " << modifiedTime << "\n";
+    }
+
+    if (!WriteTGA(name + ".tga", albedo, atlasWidth, atlasHeight) ||
+        !WriteTGA(name + "_normal.tga", normals, atlasWidth, atlasHeight)) {
+        return false;
+    }
+
+    // The manifest goes last, so an interrupted build is never mistaken for a finished one
+    std::ofstream out(name + ".atlas", std::ios::trunc);
+    out << manifest.str();
+    out.close();
+    if (out.fail()) {
+        std::cout << "Failed to write texture atlas manifest: " << name << ".atlas" << std::endl;
+        return false;
+    }
+    std::cout << "Built texture atlas " << name << " (" << atlasWidth << "x" << atlasHeight << ", " << order.size() << " images)" << std::endl;
+    return true;
+}
+
+bool TextureAtlas::ReadManifest(const std::string& name, const std::vector<AtlasEntry>& entries) {
+    std::ifstream in(name + ".atlas");
+    if (!in || !std::ifstream(textureFilename) || !std::ifstream(normalMapFilename)) return false;
+
+    std::string tag;
+    int version = 0, atlasWidth = 0, atlasHeight = 0;
+    if (!(in >> tag >> version >> atlasWidth >> atlasHeight) || tag != "atlas" || version != TEXTURE_ATLAS_VERSION ||
+        atlasWidth <= 0 || atlasHeight <= 0) {
+        return false;
+    }
+
+    std::vector<AtlasRect> readRects;
+    for (const AtlasEntry& entry : entries) {
+        std::string mesh, texture, normalMap;
+        AtlasRect rect;
+        if (!(in >> tag >> mesh >> texture >> normalMap >> rect.x >> rect.y >> rect.width >> rect.height) || tag != "entry" ||
+            mesh != entry.meshFilename || texture != entry.textureFilename ||
+            normalMap != (entry.normalMapFilename.empty() ? "-" : entry.normalMapFilename)) {
+            return false;
+        }
+        readRects.push_back(rect);
+    }
+
+    std::vector<std::string> sources = GetSources(entries);
+    for (const std::string& source : sources) {
+        std::string filename;
+        uint64_t size = 0, modifiedTime = 0, currentSize = 0, currentTime = 0;
+        if (!(in >> tag >> filename >> size >> modifiedTime) || tag != "source" || filename != source) return false;
+        if (!MappedFile::StatFile(source, currentSize, currentTime) || size != currentSize || modifiedTime != currentTime) return false;
+    }
+
+    rects = readRects;
+    width = atlasWidth;
+    height = atlasHeight;
+    return true;
+}
+
+int TextureAtlas::FindIndex(const std::string& meshFilename) const {
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].meshFilename == meshFilename) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+const AtlasEntry* TextureAtlas::FindEntry(const std::string& meshFilename) const {
+    int index = FindIndex(meshFilename);
+    return index >= 0 ? &entries[index] : nullptr;
+}
+
+bool TextureAtlas::IsPacked(const std::string& meshFilename) const {
+    int index = FindIndex(meshFilename);
+    return index >= 0 && rects[index].width > 0;
+}
+
+glm::vec4 TextureAtlas::GetUVTransform(const std::string& meshFilename) const {
+    int index = FindIndex(meshFilename);
+    if (index < 0 || rects[index].width <= 0) return glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+
+    const AtlasRect& rect = rects[index];
+    return glm::vec4(float(rect.width) / width, float(rect.height) / height, float(rect.x) / width, float(rect.y) / height);
+}
@@ -0,0 +1,102 @@
+// TextureAtlas.h
+
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Bump whenever the manifest or the packing changes; older atlases are then rebuilt
+const int TEXTURE_ATLAS_VERSION = 3;
+// Mip levels the atlas pages are loaded with, counting the base; the padding and alignment below are sized
+// for this many
+const int TEXTURE_ATLAS_MIP_LEVELS = 3;
+// Texels of edge color repeated around every image. A texel of level n covers 2^n base texels, and a bilinear
+// tap at an image's edge also reads the next one out, up to 2^(n+1) texels away; for the last level kept
+// that is exactly the padding.
+const int TEXTURE_ATLAS_PADDING = 1 << TEXTURE_ATLAS_MIP_LEVELS;
+// Padded rects start and end on multiples of this, so no texel and no 4x4 compression block of any level
+// kept spans two of them
+const int TEXTURE_ATLAS_ALIGNMENT = 4 << (TEXTURE_ATLAS_MIP_LEVELS - 1);
+const int TEXTURE_ATLAS_MAX_SIZE = 4096;
+// Larger images keep their own texture; they would crowd out the small ones the atlas is for
+const int TEXTURE_ATLAS_MAX_IMAGE_SIZE = 1024;
+
+// A prop to pack: its mesh, and the textures it would otherwise load on its own
+struct AtlasEntry {
+    std::string meshFilename;
+    std::string textureFilename;
+    std::string normalMapFilename;      // may be empty; the prop then gets a flat normal
+};
+
+struct AtlasRect {
+    int x, y, width, height;
+};
+
+// Skyline bottom-left bin packing: the top edge of everything placed so far is kept as a list of horizontal
+// segments, and each rect goes where its bottom would sit lowest, the leftmost such place on a tie
+class SkylinePacker {
+public:
+    SkylinePacker(int width, int height);
+
+    bool Insert(int width, int height, AtlasRect& rect);
+
+private:
+    // Height the rect would rest at if its left edge were at segment i, or -1 if it does not fit there
+    int Fit(size_t i, int width, int height) const;
+
+    struct Segment {
+        int x, y, width;
+    };
+
+    int width, height;
+    std::vector<Segment> skyline;
+};
+
+// Small prop textures merged into one albedo image and one matching normal map image, so props that used to
+// differ only in their textures share a material and go out in one multi-draw.
+//
+// Building decodes the sources, packs them with TEXTURE_ATLAS_PADDING and writes <name>.tga,
+// <name>_normal.tga and a <name>.atlas manifest of the rects and the sources' sizes and write times. No GL is
+// needed, and main runs it offline with --cook-atlas; startup only reads the manifest, checking the sources
+// with a stat each, and props fall back to their own textures while it is missing or stale. The .tga files
+// then load and cook to .dds like any other texture, except that their mip chains stop after
+// TEXTURE_ATLAS_MIP_LEVELS.
+//
+// An atlased mesh is imported with MeshImportOptions::uvTransform, which moves its UVs into the rect at cook
+// time. That only works for UVs within [0, 1], so meshes that tile their texture, images over
+// TEXTURE_ATLAS_MAX_IMAGE_SIZE and sources that fail to load stay out of the atlas and keep their own textures.
+// Normal maps are resampled to their texture's size and renormalized; a prop whose normal map is over twice
+// that size stays out as well, rather than lose its detail.
+class TextureAtlas {
+public:
+    // Reads the atlas manifest; when it is missing or stale every entry is left unpacked
+    TextureAtlas(const std::string& name, const std::vector<AtlasEntry>& entries);
+
+    // Packs and writes the atlas and manifest; returns false if nothing could be written
+    static bool Build(const std::string& name, const std::vector<AtlasEntry>& entries);
+
+    // Whether the entry for this mesh was packed; the Model constructor falls back to the entry's own
+    // textures when it was not
+    bool IsPacked(const std::string& meshFilename) const;
+    const AtlasEntry* FindEntry(const std::string& meshFilename) const;
+    // uv * xy + zw maps the mesh's UVs into its rect (identity for entries that were not packed)
+    glm::vec4 GetUVTransform(const std::string& meshFilename) const;
+
+    const std::string& GetTextureFilename() const { return textureFilename; }
+    const std::string& GetNormalMapFilename() const { return normalMapFilename; }
+
+private:
+    // Fills rects from the manifest if it matches entries and every source's size and write time; false when a
+    // build is due
+    bool ReadManifest(const std::string& name, const std::vector<AtlasEntry>& entries);
+    int FindIndex(const std::string& meshFilename) const;
+
+    std::vector<AtlasEntry> entries;
+    std::vector<AtlasRect> rects;       // width 0 for entries left out
+    int width, height;
+    std::string textureFilename, normalMapFilename;
+};
+
+#endif
@@ -0,0 +1,685 @@
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+#include "GLState.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTURECOOKER_SSE2
+#endif
+
+// Container layout follows the DDS spec with the DX10 extension header, so the cooked files open in
+// standard tools. Our own bookkeeping lives in the header's reserved words, which readers ignore.
+struct DDSPixelFormat {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t rBitMask;
+    uint32_t gBitMask;
+    uint32_t bBitMask;
+    uint32_t aBitMask;
+};
+
+struct DDSHeader {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    DDSPixelFormat pixelFormat;
+    uint32_t caps;
+    uint32_t caps2;
+    uint32_t caps3;
+    uint32_t caps4;
+    uint32_t reserved2;
+};
+
+struct DDSHeaderDX10 {
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DDSHeader) == 124, "DDSHeader must match the DDS spec");
+static_assert(sizeof(DDSHeaderDX10) == 20, "DDSHeaderDX10 must match the DDS spec");
+
+static const char DDS_MAGIC[4] = { 'D', 'D', 'S', ' ' };
+static const uint32_t DDS_FOURCC_DX10 = 0x30315844;
+static const uint32_t DDS_COOKER_TAG = 0x58544447;
+static const size_t DDS_DATA_OFFSET = sizeof(DDS_MAGIC) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10);
+
+static const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+static const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+static const uint32_t DXGI_FORMAT_BC1_UNORM = 71;
+static const uint32_t DXGI_FORMAT_BC3_UNORM = 77;
+static const uint32_t DXGI_FORMAT_BC5_UNORM = 83;
+static const uint32_t DXGI_FORMAT_BC7_UNORM = 98;
+
+// Interpolation weights for BC7's 4-bit indices, out of 64
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+//Packs the import options that change the cooked output into a bitmask
+static uint32_t GetImportFlags(const TextureImportOptions& options) {
+    return (options.generateMipmaps ? 1u : 0u) | (options.normalMap ? 2u : 0u) | (uint32_t(options.compression) << 8) |
+        (uint32_t(options.mipLevels) << 16);
+}
+
+static uint32_t ToDXGIFormat(TextureCompression format) {
+    switch (format) {
+    case TEXTURE_COMPRESSION_BC1: return DXGI_FORMAT_BC1_UNORM;
+    case TEXTURE_COMPRESSION_BC3: return DXGI_FORMAT_BC3_UNORM;
+    case TEXTURE_COMPRESSION_BC5: return DXGI_FORMAT_BC5_UNORM;
+    case TEXTURE_COMPRESSION_BC7: return DXGI_FORMAT_BC7_UNORM;
+    default: return 0;
+    }
+}
+
+static TextureCompression FromDXGIFormat(uint32_t format) {
+    switch (format) {
+    case DXGI_FORMAT_BC1_UNORM: return TEXTURE_COMPRESSION_BC1;
+    case DXGI_FORMAT_BC3_UNORM: return TEXTURE_COMPRESSION_BC3;
+    case DXGI_FORMAT_BC5_UNORM: return TEXTURE_COMPRESSION_BC5;
+    case DXGI_FORMAT_BC7_UNORM: return TEXTURE_COMPRESSION_BC7;
+    default: return TEXTURE_COMPRESSION_NONE;
+    }
+}
+
+//Number of levels in a full chain down to 1x1
+static int GetMipCount(int width, int height) {
+    int levels = 1;
+    while (width > 1 || height > 1) {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        levels++;
+    }
+    return levels;
+}
+
+//Levels the options ask for: one without mipmaps, else the full chain capped at mipLevels when that is set
+static int GetLevelCount(const TextureImportOptions& options, int width, int height) {
+    if (!options.generateMipmaps) return 1;
+    int levels = GetMipCount(width, height);
+    return options.mipLevels > 0 ? std::min(levels, options.mipLevels) : levels;
+}
+
+//Fills in the size and offset of every level of a block-compressed chain; returns the total byte size
+static size_t LayoutLevels(TextureCompression format, int width, int height, int levelCount, std::vector<CookedTextureLevel>& levels) {
+    size_t blockSize = TextureCooker::GetBlockSize(format);
+    size_t offset = 0;
+    levels.clear();
+    for (int i = 0; i < levelCount; i++) {
+        CookedTextureLevel level;
+        level.width = width;
+        level.height = height;
+        level.offset = offset;
+        level.size = size_t((width + 3) / 4) * size_t((height + 3) / 4) * blockSize;
+        levels.push_back(level);
+
+        offset += level.size;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return offset;
+}
+
+//Allocates an RGBA8 image of the given size
+static ImageData AllocateImage(int width, int height) {
+    ImageData image;
+    image.width = width;
+    image.height = height;
+    image.channels = 4;
+    image.pixels = std::shared_ptr<unsigned char>(new unsigned char[size_t(width) * height * 4], std::default_delete<unsigned char[]>());
+    return image;
+}
+
+//Averages each 2x2 quad of an RGBA8 image into one pixel of the next level; odd edges reuse the last row/column
+static void Downsample(const ImageData& source, ImageData& destination) {
+    destination = AllocateImage(std::max(1, source.width / 2), std::max(1, source.height / 2));
+
+    const unsigned char* sourcePixels = source.pixels.get();
+    unsigned char* destinationPixels = destination.pixels.get();
+    size_t sourceStride = size_t(source.width) * 4;
+
+    for (int y = 0; y < destination.height; y++) {
+        const unsigned char* row0 = sourcePixels + std::min(2 * y, source.height - 1) * sourceStride;
+        const unsigned char* row1 = sourcePixels + std::min(2 * y + 1, source.height - 1) * sourceStride;
+        unsigned char* out = destinationPixels + size_t(y) * destination.width * 4;
+        int x = 0;
+
+#ifdef TEXTURECOOKER_SSE2
+        // Two output pixels per step: four source pixels from each row, widened to 16 bits and summed
+        if (source.width > 1) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i rounding = _mm_set1_epi16(2);
+            for (; x + 2 <= destination.width; x += 2) {
+                __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+                __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+                __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+                __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+                __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(left, right), _mm_unpackhi_epi64(left, right));
+                sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(sum, sum));
+            }
+        }
+#endif
+
+        for (; x < destination.width; x++) {
+            int x0 = std::min(2 * x, source.width - 1) * 4;
+            int x1 = std::min(2 * x + 1, source.width - 1) * 4;
+            for (int c = 0; c < 4; c++) {
+                out[x * 4 + c] = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+//Rescales the averaged XY of every texel of a normal map level to a unit normal and recomputes Z from them,
+//which is all a BC5 level keeps
+static void RenormalizeLevel(ImageData& image) {
+    unsigned char* texel = image.pixels.get();
+    for (size_t i = 0, count = size_t(image.width) * image.height; i < count; i++, texel += 4) {
+        float x = texel[0] / 127.5f - 1.0f;
+        float y = texel[1] / 127.5f - 1.0f;
+        float z = texel[2] / 127.5f - 1.0f;
+        float length = std::sqrt(x * x + y * y + z * z);
+        if (length > 0.0f) {
+            x /= length;
+            y /= length;
+        }
+        else {
+            x = y = 0.0f;
+        }
+        z = std::sqrt(std::max(1.0f - x * x - y * y, 0.0f));
+        texel[0] = static_cast<unsigned char>(std::min(std::max((x + 1.0f) * 127.5f + 0.5f, 0.0f), 255.0f));
+        texel[1] = static_cast<unsigned char>(std::min(std::max((y + 1.0f) * 127.5f + 0.5f, 0.0f), 255.0f));
+        texel[2] = static_cast<unsigned char>(std::min((z + 1.0f) * 127.5f + 0.5f, 255.0f));
+    }
+}
+
+//Copies a 4x4 block out of an RGBA8 image, clamping at the edges of levels smaller than a block
+static void FetchBlock(const ImageData& image, int blockX, int blockY, unsigned char block[16][4]) {
+    const unsigned char* pixels = image.pixels.get();
+    for (int y = 0; y < 4; y++) {
+        int sourceY = std::min(blockY * 4 + y, image.height - 1);
+        for (int x = 0; x < 4; x++) {
+            int sourceX = std::min(blockX * 4 + x, image.width - 1);
+            std::memcpy(block[y * 4 + x], pixels + (size_t(sourceY) * image.width + sourceX) * 4, 4);
+        }
+    }
+}
+
+//Fits a line through the block's colors (power iteration on the covariance) and returns its extreme points
+static void FindEndpoints(const unsigned char block[16][4], int channels, float low[4], float high[4]) {
+    float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < channels; c++) mean[c] += block[i][c];
+    }
+    for (int c = 0; c < channels; c++) mean[c] /= 16.0f;
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++) {
+        float d[4];
+        for (int c = 0; c < channels; c++) d[c] = block[i][c] - mean[c];
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++) covariance[a][b] += d[a] * d[b];
+        }
+    }
+
+    // Start from the channel with the most variance so anti-correlated channels still converge
+    float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    int widest = 0;
+    for (int c = 1; c < channels; c++) {
+        if (covariance[c][c] > covariance[widest][widest]) widest = c;
+    }
+    axis[widest] = 1.0f;
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float length = 0.0f;
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++) next[a] += covariance[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        if (length < 1e-6f) break;
+        length = std::sqrt(length);
+        for (int c = 0; c < channels; c++) axis[c] = next[c] / length;
+    }
+
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++) t += (block[i][c] - mean[c]) * axis[c];
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    for (int c = 0; c < 4; c++) {
+        low[c] = c < channels ? std::min(255.0f, std::max(0.0f, mean[c] + minT * axis[c])) : 255.0f;
+        high[c] = c < channels ? std::min(255.0f, std::max(0.0f, mean[c] + maxT * axis[c])) : 255.0f;
+    }
+}
+
+//Index of the palette entry closest to the pixel over the first `channels` channels
+static int NearestIndex(const unsigned char pixel[4], const int (*palette)[4], int paletteSize, int channels) {
+    int best = 0, bestError = 0x7FFFFFFF;
+    for (int k = 0; k < paletteSize; k++) {
+        int error = 0;
+        for (int c = 0; c < channels; c++) {
+            int d = pixel[c] - palette[k][c];
+            error += d * d;
+        }
+        if (error < bestError) {
+            bestError = error;
+            best = k;
+        }
+    }
+    return best;
+}
+
+static uint16_t PackRGB565(const float color[4]) {
+    int r = static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f);
+    int g = static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f);
+    int b = static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRGB565(uint16_t packed, int color[4]) {
+    int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+    color[3] = 255;
+}
+
+//BC1: two RGB565 endpoints and a 2-bit index per pixel, always in 4-color mode
+static void EncodeBC1(const unsigned char block[16][4], unsigned char* out) {
+    float low[4], high[4];
+    FindEndpoints(block, 3, low, high);
+
+    uint16_t color0 = PackRGB565(high);
+    uint16_t color1 = PackRGB565(low);
+    if (color0 < color1) std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][4];
+        UnpackRGB565(color0, palette[0]);
+        UnpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            indices |= uint32_t(NearestIndex(block[i], palette, 4, 3)) << (2 * i);
+        }
+    }
+
+    out[0] = static_cast<unsigned char>(color0 & 0xFF);
+    out[1] = static_cast<unsigned char>(color0 >> 8);
+    out[2] = static_cast<unsigned char>(color1 & 0xFF);
+    out[3] = static_cast<unsigned char>(color1 >> 8);
+    for (int b = 0; b < 4; b++) out[4 + b] = static_cast<unsigned char>(indices >> (8 * b));
+}
+
+//BC4 (one channel): min/max endpoints and a 3-bit index per pixel in 8-value mode
+static void EncodeBC4(const unsigned char block[16][4], int channel, unsigned char* out) {
+    int low = 255, high = 0;
+    for (int i = 0; i < 16; i++) {
+        low = std::min(low, int(block[i][channel]));
+        high = std::max(high, int(block[i][channel]));
+    }
+
+    uint64_t indices = 0;
+    if (high != low) {
+        int palette[8];
+        palette[0] = high;
+        palette[1] = low;
+        for (int k = 1; k < 7; k++) palette[k + 1] = ((7 - k) * high + k * low) / 7;
+
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestError = 256;
+            for (int k = 0; k < 8; k++) {
+                int error = std::abs(block[i][channel] - palette[k]);
+                if (error < bestError) {
+                    bestError = error;
+                    best = k;
+                }
+            }
+            indices |= uint64_t(best) << (3 * i);
+        }
+    }
+
+    out[0] = static_cast<unsigned char>(high);
+    out[1] = static_cast<unsigned char>(low);
+    for (int b = 0; b < 6; b++) out[2 + b] = static_cast<unsigned char>(indices >> (8 * b));
+}
+
+//Quantizes a BC7 mode 6 endpoint to 7 bits per channel plus the p-bit that reconstructs it best
+static void QuantizeBC7Endpoint(const float endpoint[4], int quantized[4], int& pBit, int reconstructed[4]) {
+    float bestError = 1e30f;
+    for (int p = 0; p < 2; p++) {
+        int candidate[4], value[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            candidate[c] = std::min(127, std::max(0, static_cast<int>((endpoint[c] - p) / 2.0f + 0.5f)));
+            value[c] = (candidate[c] << 1) | p;
+            error += (value[c] - endpoint[c]) * (value[c] - endpoint[c]);
+        }
+        if (error < bestError) {
+            bestError = error;
+            pBit = p;
+            std::memcpy(quantized, candidate, sizeof(candidate));
+            std::memcpy(reconstructed, value, sizeof(value));
+        }
+    }
+}
+
+//Appends `count` bits of `value` to a 128-bit little-endian block
+static void WriteBits(uint64_t words[2], int& position, uint32_t value, int count) {
+    for (int b = 0; b < count; b++, position++) {
+        if ((value >> b) & 1) words[position / 64] |= uint64_t(1) << (position % 64);
+    }
+}
+
+//BC7 mode 6: one RGBA line per block with 7.7.7.7 endpoints, a p-bit each and 4-bit indices
+static void EncodeBC7(const unsigned char block[16][4], unsigned char* out) {
+    float low[4], high[4];
+    FindEndpoints(block, 4, low, high);
+
+    int quantized[2][4], pBits[2], endpoints[2][4];
+    QuantizeBC7Endpoint(low, quantized[0], pBits[0], endpoints[0]);
+    QuantizeBC7Endpoint(high, quantized[1], pBits[1], endpoints[1]);
+
+    int palette[16][4];
+    for (int k = 0; k < 16; k++) {
+        for (int c = 0; c < 4; c++) {
+            palette[k][c] = ((64 - BC7_WEIGHTS[k]) * endpoints[0][c] + BC7_WEIGHTS[k] * endpoints[1][c] + 32) >> 6;
+        }
+    }
+
+    int indices[16];
+    for (int i = 0; i < 16; i++) indices[i] = NearestIndex(block[i], palette, 16, 4);
+
+    // The first pixel's index is stored without its top bit, so flip the line if that bit is set
+    if (indices[0] & 8) {
+        for (int c = 0; c < 4; c++) std::swap(quantized[0][c], quantized[1][c]);
+        std::swap(pBits[0], pBits[1]);
+        for (int i = 0; i < 16; i++) indices[i] = 15 - indices[i];
+    }
+
+    uint64_t words[2] = { 0, 0 };
+    int position = 0;
+    WriteBits(words, position, 1u << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        WriteBits(words, position, quantized[0][c], 7);
+        WriteBits(words, position, quantized[1][c], 7);
+    }
+    WriteBits(words, position, pBits[0], 1);
+    WriteBits(words, position, pBits[1], 1);
+    WriteBits(words, position, indices[0], 3);
+    for (int i = 1; i < 16; i++) WriteBits(words, position, indices[i], 4);
+
+    for (int b = 0; b < 16; b++) out[b] = static_cast<unsigned char>(words[b / 8] >> (8 * (b % 8)));
+}
+
+//Encodes one 4x4 block in the given format
+static void EncodeBlock(TextureCompression format, const unsigned char block[16][4], unsigned char* out) {
+    switch (format) {
+    case TEXTURE_COMPRESSION_BC1:
+        EncodeBC1(block, out);
+        break;
+    case TEXTURE_COMPRESSION_BC3:
+        EncodeBC4(block, 3, out);
+        EncodeBC1(block, out + 8);
+        break;
+    case TEXTURE_COMPRESSION_BC5:
+        EncodeBC4(block, 0, out);
+        EncodeBC4(block, 1, out + 8);
+        break;
+    case TEXTURE_COMPRESSION_BC7:
+        EncodeBC7(block, out);
+        break;
+    default:
+        break;
+    }
+}
+
+//Queries which block formats the current context can sample
+TextureFormatSupport TextureFormatSupport::Query() {
+    TextureFormatSupport support;
+    support.s3tc = GLAD_GL_EXT_texture_compression_s3tc != 0;
+    support.bptc = GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_compression_bptc;
+    return support;
+}
+
+std::string TextureCooker::GetCookedPath(const std::string& sourceFilename, const TextureImportOptions& options) {
+    size_t dot = sourceFilename.find_last_of('.');
+    size_t slash = sourceFilename.find_last_of("/\\");
+    std::string base = (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? sourceFilename.substr(0, dot) : sourceFilename;
+    if (!options.generateMipmaps) return base + ".nomips.dds";
+    if (options.mipLevels > 0) return base + ".mips" + std::to_string(options.mipLevels) + ".dds";
+    return base + ".dds";
+}
+
+TextureCompression TextureCooker::ChooseFormat(const TextureImportOptions& options, bool hasAlpha, const TextureFormatSupport& support) {
+    TextureCompression format = options.compression;
+    if (format == TEXTURE_COMPRESSION_AUTO) {
+        if (options.normalMap) format = TEXTURE_COMPRESSION_BC5;
+        else if (support.bptc) format = TEXTURE_COMPRESSION_BC7;
+        else format = hasAlpha ? TEXTURE_COMPRESSION_BC3 : TEXTURE_COMPRESSION_BC1;
+    }
+
+    // BC5 (RGTC) is core since GL 3.0; the others depend on extensions
+    if ((format == TEXTURE_COMPRESSION_BC1 || format == TEXTURE_COMPRESSION_BC3) && !support.s3tc) return TEXTURE_COMPRESSION_NONE;
+    if (format == TEXTURE_COMPRESSION_BC7 && !support.bptc) return TEXTURE_COMPRESSION_NONE;
+    return format;
+}
+
+std::unique_ptr<CookedTexture> TextureCooker::Open(const std::string& cookedFilename, const TextureImportOptions& options, const TextureFormatSupport& support, uint64_t sourceHash, uint64_t sourceSize) {
+    std::unique_ptr<MappedFile> file(new MappedFile(cookedFilename));
+    if (!file->IsOpen() || file->GetSize() < DDS_DATA_OFFSET) return nullptr;
+
+    DDSHeader header;
+    DDSHeaderDX10 header10;
+    std::memcpy(&header, file->GetData() + sizeof(DDS_MAGIC), sizeof(header));
+    std::memcpy(&header10, file->GetData() + sizeof(DDS_MAGIC) + sizeof(header), sizeof(header10));
+
+    uint64_t storedHash = header.reserved1[4] | (uint64_t(header.reserved1[5]) << 32);
+    uint64_t storedSize = header.reserved1[6] | (uint64_t(header.reserved1[7]) << 32);
+    if (std::memcmp(file->GetData(), DDS_MAGIC, sizeof(DDS_MAGIC)) != 0 ||
+        header.size != sizeof(DDSHeader) ||
+        header.pixelFormat.fourCC != DDS_FOURCC_DX10 ||
+        header.reserved1[0] != DDS_COOKER_TAG ||
+        header.reserved1[1] != TEXTURE_FILE_VERSION ||
+        header.reserved1[2] != GetImportFlags(options) ||
+        storedHash != sourceHash ||
+        storedSize != sourceSize ||
+        header10.resourceDimension != DDS_DIMENSION_TEXTURE2D ||
+        header10.arraySize != 1 ||
+        header.width == 0 || header.height == 0) {
+        return nullptr;
+    }
+
+    // A cook made for a context with different format support is redone rather than uploaded
+    bool hasAlpha = header.reserved1[3] != 0;
+    TextureCompression format = FromDXGIFormat(header10.dxgiFormat);
+    if (format == TEXTURE_COMPRESSION_NONE || format != ChooseFormat(options, hasAlpha, support)) return nullptr;
+
+    int width = static_cast<int>(header.width);
+    int height = static_cast<int>(header.height);
+    int levelCount = GetLevelCount(options, width, height);
+    if (header.mipMapCount != uint32_t(levelCount)) return nullptr;
+
+    std::unique_ptr<CookedTexture> cooked(new CookedTexture());
+    size_t dataSize = LayoutLevels(format, width, height, levelCount, cooked->levels);
+    if (DDS_DATA_OFFSET + dataSize > file->GetSize()) return nullptr;
+
+    cooked->format = format;
+    cooked->hasAlpha = hasAlpha;
+    cooked->data = file->GetData() + DDS_DATA_OFFSET;
+    cooked->file = std::move(file);
+    return cooked;
+}
+
+std::unique_ptr<CookedTexture> TextureCooker::Cook(const ImageData& image, const TextureImportOptions& options, const TextureFormatSupport& support) {
+    if (!image.pixels || image.channels != 4) return nullptr;
+
+    bool hasAlpha = false;
+    const unsigned char* pixels = image.pixels.get();
+    for (size_t i = 0, count = size_t(image.width) * image.height; i < count && !hasAlpha; i++) {
+        hasAlpha = pixels[i * 4 + 3] != 255;
+    }
+
+    TextureCompression format = ChooseFormat(options, hasAlpha, support);
+    if (format == TEXTURE_COMPRESSION_NONE) return nullptr;
+
+    std::vector<ImageData> mips;
+    if (options.generateMipmaps) {
+        BuildMipChain(image, mips, options.normalMap);
+        mips.resize(GetLevelCount(options, image.width, image.height));
+    }
+    else {
+        mips.push_back(image);
+    }
+
+    std::unique_ptr<CookedTexture> cooked(new CookedTexture());
+    cooked->format = format;
+    cooked->hasAlpha = hasAlpha;
+    cooked->buffer.resize(LayoutLevels(format, image.width, image.height, static_cast<int>(mips.size()), cooked->levels));
+    cooked->data = cooked->buffer.data();
+
+    // Block rows are independent, so each level is encoded in parallel
+    size_t blockSize = GetBlockSize(format);
+    for (size_t i = 0; i < mips.size(); i++) {
+        const ImageData& mip = mips[i];
+        unsigned char* levelData = cooked->buffer.data() + cooked->levels[i].offset;
+        int blocksX = (mip.width + 3) / 4;
+        int blocksY = (mip.height + 3) / 4;
+
+        ThreadPool::Shared().ParallelFor(blocksY, 16, [&](size_t begin, size_t end) {
+            unsigned char block[16][4];
+            for (size_t by = begin; by < end; by++) {
+                for (int bx = 0; bx < blocksX; bx++) {
+                    FetchBlock(mip, bx, static_cast<int>(by), block);
+                    EncodeBlock(format, block, levelData + (by * blocksX + bx) * blockSize);
+                }
+            }
+        });
+    }
+    return cooked;
+}
+
+bool TextureCooker::Write(const std::string& cookedFilename, const CookedTexture& texture, const TextureImportOptions& options, uint64_t sourceHash, uint64_t sourceSize) {
+    const CookedTextureLevel& top = texture.levels.front();
+    const CookedTextureLevel& last = texture.levels.back();
+
+    DDSHeader header = {};
+    header.size = sizeof(DDSHeader);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.height = top.height;
+    header.width = top.width;
+    header.pitchOrLinearSize = static_cast<uint32_t>(top.size);
+    header.mipMapCount = static_cast<uint32_t>(texture.levels.size());
+    header.reserved1[0] = DDS_COOKER_TAG;
+    header.reserved1[1] = TEXTURE_FILE_VERSION;
+    header.reserved1[2] = GetImportFlags(options);
+    header.reserved1[3] = texture.hasAlpha ? 1 : 0;
+    header.reserved1[4] = static_cast<uint32_t>(sourceHash);
+    header.reserved1[5] = static_cast<uint32_t>(sourceHash >> 32);
+    header.reserved1[6] = static_cast<uint32_t>(sourceSize);
+    header.reserved1[7] = static_cast<uint32_t>(sourceSize >> 32);
+    header.pixelFormat.size = sizeof(DDSPixelFormat);
+    header.pixelFormat.flags = DDPF_FOURCC;
+    header.pixelFormat.fourCC = DDS_FOURCC_DX10;
+    header.caps = DDSCAPS_TEXTURE | (texture.levels.size() > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+    DDSHeaderDX10 header10 = {};
+    header10.dxgiFormat = ToDXGIFormat(texture.format);
+    header10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+    header10.arraySize = 1;
+
+    // Write to a temporary file first so an interrupted cook never leaves a truncated .dds behind
+    std::string tempFilename = cookedFilename + ".tmp";
+    bool written;
+    {
+        std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cout << "Failed to write cooked texture: " << cookedFilename << std::endl;
+            return false;
+        }
+
+        out.write(DDS_MAGIC, sizeof(DDS_MAGIC));
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&header10), sizeof(header10));
+        out.write(reinterpret_cast<const char*>(texture.data), last.offset + last.size);
+
+        out.close();
+        written = !out.fail();
+    }
+
+    if (!written) {
+        std::cout << "Failed to write cooked texture: " << cookedFilename << std::endl;
+        std::remove(tempFilename.c_str());
+        return false;
+    }
+
+    std::remove(cookedFilename.c_str());
+    return std::rename(tempFilename.c_str(), cookedFilename.c_str()) == 0;
+}
+
+void TextureCooker::Upload(GLuint textureID, const CookedTexture& texture, const TextureImportOptions& options) {
+    GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
+
+    GLint levelCount = static_cast<GLint>(texture.levels.size());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, options.wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, options.wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+    GLenum glFormat = GetGLFormat(texture.format);
+    for (GLint i = 0; i < levelCount; i++) {
+        const CookedTextureLevel& level = texture.levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, glFormat, level.width, level.height, 0, static_cast<GLsizei>(level.size), texture.data + level.offset);
+    }
+}
+
+//Each level is filtered from the one above it, so a normal map's levels are renormalized before the next is made
+void TextureCooker::BuildMipChain(const ImageData& image, std::vector<ImageData>& levels, bool normalMap) {
+    levels.clear();
+    levels.push_back(image);
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        ImageData next;
+        Downsample(levels.back(), next);
+        if (normalMap) RenormalizeLevel(next);
+        levels.push_back(next);
+    }
+}
+
+GLenum TextureCooker::GetGLFormat(TextureCompression format) {
+    switch (format) {
+    case TEXTURE_COMPRESSION_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TEXTURE_COMPRESSION_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TEXTURE_COMPRESSION_BC5: return GL_COMPRESSED_RG_RGTC2;
+    case TEXTURE_COMPRESSION_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default: return 0;
+    }
+}
+
+size_t TextureCooker::GetBlockSize(TextureCompression format) {
+    return format == TEXTURE_COMPRESSION_BC1 ? 8 : 16;
+}
@@ -0,0 +1,73 @@
+// TextureCooker.h
+
+#ifndef TEXTURECOOKER_H
+#define TEXTURECOOKER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Texture.h"
+#include "AssetCache.h"
+#include "MappedFile.h"
+
+// Bump whenever the encoders or the container layout change; older cooks are then rebuilt
+const uint32_t TEXTURE_FILE_VERSION = 2;
+
+// Block formats the current GL context can sample; queried on the GL thread and handed to the loaders
+struct TextureFormatSupport {
+    bool s3tc = false;
+    bool bptc = false;
+
+    static TextureFormatSupport Query();
+};
+
+// One mip level inside a cooked texture's block data
+struct CookedTextureLevel {
+    int width;
+    int height;
+    size_t offset;
+    size_t size;
+};
+
+// Block-compressed mip chain, either mapped from a cooked .dds or freshly encoded in memory
+struct CookedTexture {
+    TextureCompression format;
+    bool hasAlpha;
+    std::vector<CookedTextureLevel> levels;
+    std::unique_ptr<MappedFile> file;
+    std::vector<unsigned char> buffer;
+    const unsigned char* data;
+};
+
+// Encodes textures to BC1/BC3/BC5/BC7 with a CPU-built mip chain and caches them as .dds files next to the source.
+// The cooked file stores the source hash in the DDS header's reserved words, so editing the image triggers a recook.
+class TextureCooker {
+public:
+    // Path of the cooked file for an image, e.g. 3D/gtr.png -> 3D/gtr.dds
+    static std::string GetCookedPath(const std::string& sourceFilename, const TextureImportOptions& options);
+
+    // Resolves AUTO to a concrete block format, or NONE if the context cannot sample the requested one
+    static TextureCompression ChooseFormat(const TextureImportOptions& options, bool hasAlpha, const TextureFormatSupport& support);
+
+    // Maps and validates the cooked file without touching GL, so it can run on a loader thread.
+    // Returns null if the file is missing, corrupt, or was cooked from a different source or with other options.
+    static std::unique_ptr<CookedTexture> Open(const std::string& cookedFilename, const TextureImportOptions& options, const TextureFormatSupport& support, uint64_t sourceHash, uint64_t sourceSize);
+
+    // Builds the mip chain and block-compresses every level; the image must be RGBA8
+    static std::unique_ptr<CookedTexture> Cook(const ImageData& image, const TextureImportOptions& options, const TextureFormatSupport& support);
+
+    static bool Write(const std::string& cookedFilename, const CookedTexture& texture, const TextureImportOptions& options, uint64_t sourceHash, uint64_t sourceSize);
+
+    // Uploads every level with glCompressedTexImage2D and sets the sampling state
+    static void Upload(GLuint textureID, const CookedTexture& texture, const TextureImportOptions& options);
+
+    // Halves an RGBA8 image repeatedly down to 1x1 with a 2x2 box filter (SSE2 where available). For a normal
+    // map every level is renormalized, since averaging shortens the normals and flattens distant surfaces.
+    static void BuildMipChain(const ImageData& image, std::vector<ImageData>& levels, bool normalMap = false);
+
+    static GLenum GetGLFormat(TextureCompression format);
+    static size_t GetBlockSize(TextureCompression format);
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+// Shared between ParallelFor and its helper jobs; helpers that start late find no ranges left
+struct ParallelForState {
+    std::function<void(size_t, size_t)> body;
+    size_t count;
+    size_t grainSize;
+    size_t rangeCount;
+    std::atomic<size_t> nextRange;
+    std::atomic<size_t> finishedRanges;
+    std::mutex mutex;
+    std::condition_variable done;
+
+    //Claims and runs ranges until none are left
+    void Run() {
+        for (size_t range = nextRange++; range < rangeCount; range = nextRange++) {
+            size_t begin = range * grainSize;
+            size_t end = std::min(begin + grainSize, count);
+            body(begin, end);
+            if (++finishedRanges == rangeCount) {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }
+        }
+    }
+};
+
+//ThreadPool constructor starts the worker threads
+ThreadPool::ThreadPool(size_t workerCount) : stopping(false) {
+    for (size_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+//ThreadPool destructor lets queued jobs finish and joins the workers
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+//Returns the pool shared by the loaders; keeps at least one worker so async loads never run inline
+ThreadPool& ThreadPool::Shared() {
+    static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+//Queues a job for the next free worker
+void ThreadPool::Submit(std::function<void()> job) {
+    if (workers.empty()) {
+        job();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) return;
+    grainSize = std::max<size_t>(grainSize, 1);
+
+    size_t rangeCount = (count + grainSize - 1) / grainSize;
+    if (workers.empty() || rangeCount == 1) {
+        body(0, count);
+        return;
+    }
+
+    std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+    state->body = body;
+    state->count = count;
+    state->grainSize = grainSize;
+    state->rangeCount = rangeCount;
+    state->nextRange = 0;
+    state->finishedRanges = 0;
+
+    size_t helperCount = std::min(workers.size(), rangeCount - 1);
+    for (size_t i = 0; i < helperCount; i++) {
+        Submit([state]() { state->Run(); });
+    }
+
+    state->Run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state]() { return state->finishedRanges == state->rangeCount; });
+}
+
+//Runs queued jobs until the pool is destroyed
+void ThreadPool::WorkerLoop() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,45 @@
+// ThreadPool.h
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for CPU-side loading work. Never touches GL.
+class ThreadPool {
+public:
+    // A pool with zero workers runs ParallelFor inline on the calling thread
+    explicit ThreadPool(size_t workerCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pool sized to the machine (one thread is left for the caller, minimum one worker), created on first use
+    static ThreadPool& Shared();
+
+    void Submit(std::function<void()> job);
+
+    // Splits [0, count) into ranges of about grainSize and runs body(begin, end) on the workers and the
+    // calling thread. Returns once every range has finished, so body may capture locals by reference.
+    void ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+
+    size_t GetWorkerCount() const { return workers.size(); }
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "TransparencyBuffer.h"
+#include "GLState.h"
+#include <iostream>
+
+//Allocates one render target texture; the composite pass reads it texel for texel
+static GLuint CreateTarget(GLenum internalFormat, GLenum format, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+TransparencyBuffer::TransparencyBuffer(ShaderProgram& compositeShader) :
+    compositeShader(compositeShader), width(0), height(0), framebuffer(0), accumulationTexture(0), weightTexture(0), depthBuffer(0), emptyVAO(0) {
+    accumulationUniform = compositeShader.FindUniform("accumulation");
+    weightUniform = compositeShader.FindUniform("weight");
+
+    // The fullscreen triangle is generated from gl_VertexID, but core profile still needs a VAO bound
+    glGenVertexArrays(1, &emptyVAO);
+}
+
+TransparencyBuffer::~TransparencyBuffer() {
+    Release();
+    GLState::ForgetVertexArray(emptyVAO);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void TransparencyBuffer::Release() {
+    if (!framebuffer) return;
+    GLuint textures[2] = { accumulationTexture, weightTexture };
+    for (GLuint texture : textures) GLState::ForgetTexture(texture);
+    glDeleteTextures(2, textures);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    framebuffer = accumulationTexture = weightTexture = depthBuffer = 0;
+}
+
+void TransparencyBuffer::Resize(int width, int height) {
+    Release();
+    this->width = width;
+    this->height = height;
+
+    accumulationTexture = CreateTarget(GL_RGBA16F, GL_RGBA, width, height);
+    weightTexture = CreateTarget(GL_R16F, GL_RED, width, height);
+
+    // Same format as the default framebuffer's depth, which a blit requires
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulationTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weightTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Transparency framebuffer is incomplete" << std::endl;
+    }
+}
+
+void TransparencyBuffer::Begin(int width, int height) {
+    if (width != this->width || height != this->height || !framebuffer) Resize(width, height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    // Nothing accumulated and everything behind fully revealed
+    const GLfloat clearAccumulation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    const GLfloat clearWeight[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+    glClearBufferfv(GL_COLOR, 1, clearWeight);
+
+    GLState::SetDepthTest(true);
+    GLState::DepthMask(false);
+}
+
+void TransparencyBuffer::Composite() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::SetDepthTest(false);
+    GLState::SetBlend(true);
+    GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    GLState::BindTexture(0, GL_TEXTURE_2D, accumulationTexture);
+    GLState::BindTexture(1, GL_TEXTURE_2D, weightTexture);
+    compositeShader.Use();
+    compositeShader.SetInt(accumulationUniform, 0);
+    compositeShader.SetInt(weightUniform, 1);
+
+    GLState::BindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    GLState::SetBlend(false);
+    GLState::SetDepthTest(true);
+    GLState::DepthMask(true);
+}
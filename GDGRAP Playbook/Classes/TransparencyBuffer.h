@@ -0,0 +1,47 @@
+// TransparencyBuffer.h
+
+#ifndef TRANSPARENCYBUFFER_H
+#define TRANSPARENCYBUFFER_H
+
+#include <glad/glad.h>
+#include "ShaderProgram.h"
+
+// Weighted blended order-independent transparency (McGuire and Bavoil 2013).
+//
+// Translucent surfaces are drawn in any order between Begin and Composite, into two targets that only
+// ever add or multiply, so the result does not depend on draw order:
+//   accumulation  RGBA16F  rgb: sum of color * alpha * weight, a: revealage, the product of (1 - alpha)
+//   weight        R16F     sum of alpha * weight
+// Both targets share one blend function (RenderQueue's BLEND_TRANSPARENT), which keeps this on GL 3.3.
+// Shaders write them through WriteTransparent in Shaders/transparency.glsl, where the weight falls off with
+// view depth so nearer surfaces dominate. Composite then draws one fullscreen triangle that divides out the
+// weights and blends the average color over framebuffer 0 by (1 - revealage).
+//
+// Opaque depth is copied in from framebuffer 0 so hidden surfaces are rejected; nothing writes depth here.
+class TransparencyBuffer {
+public:
+    // compositeShader resolves the targets (Shaders/fullscreen.vert and transparency_composite.frag)
+    explicit TransparencyBuffer(ShaderProgram& compositeShader);
+    ~TransparencyBuffer();
+
+    TransparencyBuffer(const TransparencyBuffer&) = delete;
+    TransparencyBuffer& operator=(const TransparencyBuffer&) = delete;
+
+    // Resizes the targets if the window changed, copies the opaque depth, clears and binds them with depth
+    // writes off
+    void Begin(int width, int height);
+    // Blends the result over framebuffer 0 and restores depth writes. Leaves framebuffer 0 bound.
+    void Composite();
+
+private:
+    void Resize(int width, int height);
+    void Release();
+
+    ShaderProgram& compositeShader;
+    int accumulationUniform, weightUniform;
+    int width, height;
+    GLuint framebuffer, accumulationTexture, weightTexture, depthBuffer;
+    GLuint emptyVAO;
+};
+
+#endif
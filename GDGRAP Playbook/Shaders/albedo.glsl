@@ -0,0 +1,10 @@
+// Base color of a mesh surface, shared by the forward, G-buffer and transparent fragment shaders.
+// Instances of a model with a LiveryArray (Classes/LiveryArray.h) pick a layer of it; the rest use tex0.
+
+uniform sampler2D tex0;
+uniform sampler2DArray liveries;
+flat in float livery;       // layer of liveries, or -1 for tex0
+
+vec4 SampleAlbedo(vec2 uv) {
+    return livery < 0.0 ? texture(tex0, uv) : texture(liveries, vec3(uv, livery));
+}
@@ -0,0 +1,52 @@
+#version 330 core
+
+// Lighting pass of the deferred path; reads the targets of Classes/GBuffer.h
+out vec4 FragColor;
+
+in vec2 screenUV;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gTint;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+
+// Must match FrameConstants in Classes/FrameConstants.h
+layout(std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 dirLightDirection;
+    vec4 dirLightColor;
+    vec4 pointLightPosition;
+    vec4 pointLightColor;
+    vec4 pointLightAttenuation;
+} frame;
+
+#include "lighting.glsl"
+
+// Inverse of OctahedralEncode in gbuffer.frag
+vec3 OctahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // Nothing was drawn here; the sky fills it afterwards
+    if (depth == 1.0) discard;
+
+    vec4 world = inverseViewProjection * vec4(vec3(screenUV, depth) * 2.0 - 1.0, 1.0);
+    vec3 worldPos = world.xyz / world.w;
+    vec3 normal = OctahedralDecode(texelFetch(gNormal, pixel, 0).rg);
+    vec3 albedo = texelFetch(gAlbedo, pixel, 0).rgb;
+
+    vec3 tint = texelFetch(gTint, pixel, 0).rgb;
+
+    FragColor = vec4(ShadeSurface(worldPos, normal, albedo) * tint, 1.0);
+}
@@ -0,0 +1,5 @@
+#version 330 core
+
+// Depth-only pass: the rasterizer writes depth, there is no color target
+void main() {
+}
@@ -0,0 +1,12 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+
+// Per-instance data (InstanceData in Classes/Mesh.h), read from the instance stream the RenderQueue uploads
+layout(location = 5) in mat4 aModel;
+
+uniform mat4 lightViewProjection;
+
+void main() {
+    gl_Position = lightViewProjection * aModel * vec4(aPos, 1.0);
+}
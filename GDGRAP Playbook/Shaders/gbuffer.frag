@@ -0,0 +1,25 @@
+#version 330 core
+
+// Geometry pass of the deferred path; the targets and the normal encoding are in gbuffer.glsl
+
+in vec2 texCoord;
+in vec3 FragPos;
+in mat3 TBN;
+in vec4 tint;
+
+uniform sampler2D normalMap;
+
+#include "albedo.glsl"
+#include "gbuffer.glsl"
+
+void main() {
+    // Normal maps are cooked to two-channel BC5, so Z is rebuilt from X and Y
+    vec2 normalXY = texture(normalMap, texCoord).rg * 2.0 - 1.0;
+    vec3 normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
+    normal = normalize(TBN * normal);
+
+    // Tint is kept apart and applied after lighting, as sample.frag does, so both paths shade alike
+    gAlbedo = vec4(SampleAlbedo(texCoord).rgb, 1.0);
+    gNormal = OctahedralEncode(normal);
+    gTint = vec4(tint.rgb, 1.0);
+}
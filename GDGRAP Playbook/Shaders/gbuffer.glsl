@@ -0,0 +1,16 @@
+// Targets of the deferred path's geometry pass, shared by gbuffer.frag and impostor_gbuffer.frag; must match
+// the targets of Classes/GBuffer.h
+layout(location = 0) out vec4 gAlbedo;
+layout(location = 1) out vec2 gNormal;
+layout(location = 2) out vec4 gTint;
+
+// Folds the unit sphere onto the [-1, 1] square: the upper half maps to the inner diamond and the lower
+// half is mirrored into the corners
+vec2 OctahedralEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0) {
+        vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return n.xy;
+}
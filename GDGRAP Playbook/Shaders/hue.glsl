@@ -0,0 +1,14 @@
+// Hue rotation matching LiveryArray::ShiftHue (Classes/LiveryArray.cpp), for impostors baked from a model's
+// base texture that stand in for instances wearing a repainted livery layer
+
+vec3 ShiftHue(vec3 color, float degrees) {
+    float angle = radians(degrees);
+    float c = cos(angle);
+    float s = sin(angle) / sqrt(3.0);
+    float t = (1.0 - c) / 3.0;
+    mat3 rotation = mat3(
+        c + t, t + s, t - s,
+        t - s, c + t, t + s,
+        t + s, t - s, c + t);
+    return clamp(rotation * color, 0.0, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 texCoord;
+in vec4 tint;
+flat in float hueShift;
+
+uniform sampler2D tex0;
+
+#include "hue.glsl"
+
+void main() {
+    // The atlas stores coverage in alpha; impostors are drawn in the opaque pass, so cut out the rest
+    vec4 color = texture(tex0, texCoord);
+    if (color.a < 0.5) discard;
+    FragColor = vec4(ShiftHue(color.rgb, hueShift) * tint.rgb, tint.a);
+}
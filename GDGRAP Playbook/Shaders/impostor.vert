@@ -0,0 +1,65 @@
+#version 330 core
+
+// Quad vertices from ImpostorAtlas (Classes/ImpostorAtlas.h): every corner sits at the model-space
+// bounding-sphere center, texCoord holds the corner in [-1, 1] and normal.x the sphere radius
+layout(location = 0) in vec3 aCenter;
+layout(location = 1) in vec3 aRadius;
+layout(location = 2) in vec2 aCorner;
+
+// Per-instance data (InstanceData in Classes/Mesh.h)
+layout(location = 5) in mat4 aModel;
+layout(location = 9) in vec4 aTint;
+layout(location = 10) in float aHueShift;    // the livery slot; Model fills in the hue shift of the instance's layer
+layout(location = 11) in mat3 aNormalMatrix;
+
+out vec2 texCoord;
+out vec4 tint;
+flat out float hueShift;    // degrees, applied with ShiftHue (Shaders/hue.glsl)
+out vec3 facing;            // world-space direction to the camera, the quad's normal in the G-buffer
+
+// Must match FrameConstants in Classes/FrameConstants.h
+layout(std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 dirLightDirection;
+    vec4 dirLightColor;
+    vec4 pointLightPosition;
+    vec4 pointLightColor;
+    vec4 pointLightAttenuation;
+} frame;
+
+// Must match IMPOSTOR_* in Classes/ImpostorAtlas.h
+const float YAW_VIEWS = 16.0;
+const float PITCH_VIEWS = 3.0;
+const float MAX_PITCH = radians(50.0);
+const float TWO_PI = 6.28318531;
+
+void main() {
+    vec3 center = (aModel * vec4(aCenter, 1.0)).xyz;
+    mat3 basis = mat3(aModel);
+    float scale = sqrt(max(dot(basis[0], basis[0]), max(dot(basis[1], basis[1]), dot(basis[2], basis[2]))));
+    float radius = aRadius.x * scale;
+
+    // Pick the baked view closest to the direction the model is seen from, in model space
+    vec3 toCamera = normalize(frame.cameraPosition.xyz - center);
+    // The normal matrix is the inverse transpose up to a positive scale, so its transpose undoes the basis
+    vec3 localView = normalize(transpose(aNormalMatrix) * toCamera);
+    float yaw = atan(localView.x, localView.z);
+    float pitch = asin(clamp(localView.y, -1.0, 1.0));
+    float column = mod(floor(yaw / TWO_PI * YAW_VIEWS + 0.5), YAW_VIEWS);
+    float row = PITCH_VIEWS > 1.0 ? floor(clamp(pitch / MAX_PITCH, 0.0, 1.0) * (PITCH_VIEWS - 1.0) + 0.5) : 0.0;
+    texCoord = (vec2(column, row) + aCorner * 0.5 + 0.5) / vec2(YAW_VIEWS, PITCH_VIEWS);
+
+    // Face the camera, keeping the model's up direction upright on screen as the baked views did
+    vec3 up = normalize(basis[1]);
+    vec3 right = cross(up, toCamera);
+    right = dot(right, right) > 1e-6 ? normalize(right) : normalize(basis[0]);
+    up = cross(toCamera, right);
+
+    tint = aTint;
+    hueShift = aHueShift;
+    facing = toCamera;
+    gl_Position = frame.viewProjection * vec4(center + (aCorner.x * right + aCorner.y * up) * radius, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+// Impostors of opaque models in the deferred path's geometry pass; otherwise the same as impostor.frag. The
+// quad has no surface normal of its own, so it is lit as if it faced the camera.
+
+in vec2 texCoord;
+in vec4 tint;
+flat in float hueShift;
+in vec3 facing;
+
+uniform sampler2D tex0;
+
+#include "gbuffer.glsl"
+#include "hue.glsl"
+
+void main() {
+    vec4 color = texture(tex0, texCoord);
+    if (color.a < 0.5) discard;
+    gAlbedo = vec4(ShiftHue(color.rgb, hueShift), 1.0);
+    gNormal = OctahedralEncode(normalize(facing));
+    gTint = vec4(tint.rgb, 1.0);
+}
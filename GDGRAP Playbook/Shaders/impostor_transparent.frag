@@ -0,0 +1,19 @@
+#version 330 core
+
+// Impostors of translucent models, written into a TransparencyBuffer; otherwise the same as impostor.frag
+
+in vec2 texCoord;
+in vec4 tint;
+flat in float hueShift;
+
+uniform sampler2D tex0;
+
+#include "transparency.glsl"
+#include "hue.glsl"
+
+void main() {
+    // Coverage is still cut out, so the dilated border around the baked silhouette never shows
+    vec4 color = texture(tex0, texCoord);
+    if (color.a < 0.5) discard;
+    WriteTransparent(ShiftHue(color.rgb, hueShift) * tint.rgb, tint.a);
+}
@@ -0,0 +1,111 @@
+// Scene lighting shared by the forward (sample.frag) and deferred (deferred.frag) paths.
+// Included after the FrameConstants block, which it reads through "frame".
+
+uniform sampler2DArrayShadow shadowMap;
+uniform samplerBuffer lightData;        // two texels per light: position and range, color times intensity
+uniform usamplerBuffer clusterGrid;     // per cluster: first entry in lightIndices, light count
+uniform usamplerBuffer lightIndices;
+
+// Must match ShadowConstants in Classes/CascadedShadowMap.h
+layout(std140) uniform ShadowConstants {
+    mat4 cascadeMatrices[4];
+    vec4 cascadeSplits;
+    vec4 params;    // cascade count, texel size, depth bias
+} shadow;
+
+// Must match ClusterConstants in Classes/ClusteredLights.h
+layout(std140) uniform ClusterConstants {
+    vec4 grid;      // cluster counts along x, y and z, light count
+    vec4 depth;     // view depth where slice 1 starts, slices per unit of log depth
+    vec4 screen;    // 1 / viewport width, 1 / viewport height
+} cluster;
+
+// Fraction of the sun that reaches the fragment: the first cascade whose slice holds the fragment's view
+// depth is sampled with a 3x3 PCF kernel of hardware-compared taps
+float SunVisibility(vec3 worldPos) {
+    int cascadeCount = int(shadow.params.x);
+    float viewDepth = -(frame.view * vec4(worldPos, 1.0)).z;
+    if (cascadeCount == 0 || viewDepth > shadow.cascadeSplits[cascadeCount - 1]) return 1.0;
+
+    int cascade = cascadeCount - 1;
+    for (int i = 0; i < cascadeCount - 1; i++) {
+        if (viewDepth <= shadow.cascadeSplits[i]) {
+            cascade = i;
+            break;
+        }
+    }
+
+    vec4 shadowPos = shadow.cascadeMatrices[cascade] * vec4(worldPos, 1.0);
+    if (shadowPos.z > 1.0) return 1.0;
+
+    float reference = shadowPos.z - shadow.params.z;
+    float visibility = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec2 offset = vec2(x, y) * shadow.params.y;
+            visibility += texture(shadowMap, vec4(shadowPos.xy + offset, float(cascade), reference));
+        }
+    }
+    return visibility / 9.0;
+}
+
+// Diffuse and specular light from the point lights of the fragment's cluster. Each light fades with the
+// inverse square of its distance, windowed to reach zero at its range.
+vec3 ClusterLighting(vec3 worldPos, vec3 normal, vec3 viewDir) {
+    if (cluster.grid.w == 0.0) return vec3(0.0);
+
+    float viewDepth = -(frame.view * vec4(worldPos, 1.0)).z;
+    int slice = viewDepth > cluster.depth.x ? 1 + int(log(viewDepth / cluster.depth.x) * cluster.depth.y) : 0;
+    slice = min(slice, int(cluster.grid.z) - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy * cluster.screen.xy * cluster.grid.xy), ivec2(0), ivec2(cluster.grid.xy) - 1);
+    uvec2 range = texelFetch(clusterGrid, tile.x + int(cluster.grid.x) * (tile.y + int(cluster.grid.y) * slice)).rg;
+
+    vec3 lighting = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r);
+        vec4 positionRange = texelFetch(lightData, 2 * light);
+        vec3 color = texelFetch(lightData, 2 * light + 1).rgb;
+
+        vec3 toLight = positionRange.xyz - worldPos;
+        float distance = length(toLight);
+        vec3 lightDir = toLight / max(distance, 0.0001);
+        float ratio = distance / positionRange.w;
+        float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+        float falloff = window * window / (1.0 + distance * distance);
+
+        float diff = max(dot(normal, lightDir), 0.0);
+        float spec = pow(max(dot(normal, normalize(lightDir + viewDir)), 0.0), 128.0);
+        lighting += (diff + spec) * falloff * color;
+    }
+    return lighting;
+}
+
+// Lit color of a surface point: ambient, the frame's point light tinted by the sun and shadowed by the
+// cascades, and the clustered point lights
+vec3 ShadeSurface(vec3 worldPos, vec3 normal, vec3 albedo) {
+    vec3 lightPos = frame.pointLightPosition.xyz;
+    vec3 viewPos = frame.cameraPosition.xyz;
+    vec3 dirLightColor = frame.dirLightColor.rgb * frame.dirLightColor.a;
+
+    vec3 lightDir = normalize(lightPos - worldPos);
+
+    // Diffuse Light
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = diff * dirLightColor;
+
+    // Specular Light
+    vec3 viewDir = normalize(viewPos - worldPos);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), 128.0);
+    vec3 specular = spec * dirLightColor;
+
+    // Attenuation Adjustment
+    float distance = length(lightPos - worldPos);
+    vec3 falloff = frame.pointLightAttenuation.xyz;
+    float attenuation = 1.0 / (falloff.x + falloff.y * distance + falloff.z * (distance * distance));
+
+    vec3 ambient = vec3(0.5) * albedo;
+
+    // Final Color Composition
+    return (ambient + attenuation * SunVisibility(worldPos) * (diffuse + specular) + ClusterLighting(worldPos, normal, viewDir)) * albedo;
+}
@@ -0,0 +1,28 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+
+// Per-instance data (InstanceData in Classes/Mesh.h); single draws set these as generic attribute values
+layout(location = 5) in mat4 aModel;
+
+// Must match FrameConstants in Classes/FrameConstants.h
+layout(std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 dirLightDirection;
+    vec4 dirLightColor;
+    vec4 pointLightPosition;
+    vec4 pointLightColor;
+    vec4 pointLightAttenuation;
+} frame;
+
+// The main pass tests with GL_EQUAL against this depth, so the position must be computed exactly as
+// sample.vert computes it, and both declare it invariant
+invariant gl_Position;
+
+void main() {
+    vec4 worldPos = aModel * vec4(aPos, 1.0);
+    gl_Position = frame.viewProjection * worldPos;
+}
@@ -5,54 +5,37 @@ out vec4 FragColor;
 in vec2 texCoord;
 in vec3 FragPos;
 in mat3 TBN;
+in vec4 tint;
 
 uniform sampler2D normalMap;
-uniform sampler2D tex0;
 uniform vec3 lightColor = vec3(3.0, 3.0, 3.0);
-uniform vec3 lightPos;
-uniform vec3 viewPos;
 
-uniform struct DirectionalLight { 
-    vec3 color;
-    float intensity;
-} dirLight;
+#include "albedo.glsl"
 
-uniform struct PointLight { 
-    vec3 position;
-    vec3 color;
-    float intensity;
-    float constant;
-    float linear;
-    float quadratic;
-} pointLight;
+// Must match FrameConstants in Classes/FrameConstants.h
+layout(std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 dirLightDirection;
+    vec4 dirLightColor;
+    vec4 pointLightPosition;
+    vec4 pointLightColor;
+    vec4 pointLightAttenuation;
+} frame;
 
+#include "lighting.glsl"
 
 void main() {
-    vec3 normal = texture(normalMap, texCoord).rgb;
-    normal = normalize(normal * 2.0 - 1.0);
+    // Normal maps are cooked to two-channel BC5, so Z is rebuilt from X and Y
+    vec2 normalXY = texture(normalMap, texCoord).rg * 2.0 - 1.0;
+    vec3 normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
     normal = normalize(TBN * normal);
 
-    vec3 lightDir = normalize(lightPos - FragPos);
-
-    // Diffuse Light
-    float diff = max(dot(normal, lightDir), 0.0);
-    vec3 diffuse = diff * dirLight.color * dirLight.intensity; 
-
-    // Specular Light
-    vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), 128.0);
-    vec3 specular = spec * dirLight.color * dirLight.intensity; 
-
-    // Attenuation Adjustment
-    float distance = length(lightPos - FragPos);
-    float attenuation = 1.0 / (1.0 + 0.02 * distance + 0.002 * (distance * distance));
-
     // Texture Mapping
-    vec3 textureColor = texture(tex0, texCoord).rgb;
-    vec3 ambient = vec3(0.5) * textureColor;
+    vec3 textureColor = SampleAlbedo(texCoord).rgb;
 
-    // Final Color Composition
-    vec3 finalColor = (ambient + attenuation * (diffuse + specular)) * textureColor;
-    FragColor = vec4(finalColor, 1.0);
+    vec3 finalColor = ShadeSurface(FragPos, normal, textureColor);
+    FragColor = vec4(finalColor * tint.rgb, tint.a);
 }
@@ -6,22 +6,48 @@ layout(location = 2) in vec3 aNormal;
 layout(location = 3) in vec3 aTangent;
 layout(location = 4) in vec3 aBitangent;
 
+// Per-instance data (InstanceData in Classes/Mesh.h); single draws set these as generic attribute values
+layout(location = 5) in mat4 aModel;
+layout(location = 9) in vec4 aTint;
+layout(location = 10) in float aLivery;
+layout(location = 11) in mat3 aNormalMatrix;
+
 out vec2 texCoord;
 out vec3 FragPos;
 out mat3 TBN;
+out vec4 tint;
+flat out float livery;
+
+// Must match FrameConstants in Classes/FrameConstants.h
+layout(std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 dirLightDirection;
+    vec4 dirLightColor;
+    vec4 pointLightPosition;
+    vec4 pointLightColor;
+    vec4 pointLightAttenuation;
+} frame;
 
-uniform mat4 MVP;
+// Matches the depth written by prepass.vert bit for bit, so the GL_EQUAL test after a depth pre-pass passes
+invariant gl_Position;
 
 void main() {
+    vec4 worldPos = aModel * vec4(aPos, 1.0);
     texCoord = aTexCoord;
-    FragPos = vec3(MVP * vec4(aPos, 1.0));
+    tint = aTint;
+    livery = aLivery;
+    FragPos = worldPos.xyz;
 
-    vec3 T = normalize(mat3(MVP) * aTangent);
-    vec3 N = normalize(mat3(MVP) * aNormal);
+    // The normal matrix keeps normals perpendicular under the road's non-uniform scale
+    vec3 T = normalize(mat3(aModel) * aTangent);
+    vec3 N = normalize(aNormalMatrix * aNormal);
     T = normalize(T - dot(T, N) * N);
     vec3 B = cross(N, T);
 
     TBN = mat3(T, B, N);
 
-    gl_Position = MVP * vec4(aPos, 1.0);
+    gl_Position = frame.viewProjection * worldPos;
 }
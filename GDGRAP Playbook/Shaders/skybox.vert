@@ -4,11 +4,22 @@ layout(location = 0) in vec3 aPos;
 
 out vec3 texCoord;
 
-uniform mat4 projection;
-uniform mat4 view;
+// Must match FrameConstants in Classes/FrameConstants.h
+layout(std140) uniform FrameConstants {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 cameraPosition;
+	vec4 dirLightDirection;
+	vec4 dirLightColor;
+	vec4 pointLightPosition;
+	vec4 pointLightColor;
+	vec4 pointLightAttenuation;
+} frame;
 
 void main(){
-	vec4 pos = projection * view * vec4(aPos,1.0);
+	// Drop the camera translation so the box stays centred on the viewer
+	vec4 pos = frame.projection * mat4(mat3(frame.view)) * vec4(aPos,1.0);
 
 	gl_Position = vec4(pos.x,pos.y,pos.w,pos.w);
 
@@ -0,0 +1,15 @@
+// Output of translucent surfaces into a TransparencyBuffer (Classes/TransparencyBuffer.h), blended with
+// glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA)
+
+layout(location = 0) out vec4 accumulation;
+layout(location = 1) out float weight;
+
+// color is not premultiplied. The weight is McGuire and Bavoil's depth falloff (their equation 7), clamped so
+// 16-bit float targets neither overflow nor lose faint, distant surfaces.
+void WriteTransparent(vec3 color, float alpha) {
+    float viewDepth = 1.0 / gl_FragCoord.w;
+    float falloff = 10.0 / (1e-5 + pow(viewDepth / 5.0, 2.0) + pow(viewDepth / 200.0, 6.0));
+    float w = alpha * clamp(falloff, 1e-2, 3e3);
+    accumulation = vec4(color * alpha * w, alpha);
+    weight = alpha * w;
+}
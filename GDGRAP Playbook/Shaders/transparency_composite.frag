@@ -0,0 +1,21 @@
+#version 330 core
+
+// Resolves the targets of Classes/TransparencyBuffer.h over the opaque scene, blended with
+// glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA)
+out vec4 FragColor;
+
+in vec2 screenUV;
+
+uniform sampler2D accumulation;
+uniform sampler2D weight;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 sum = texelFetch(accumulation, pixel, 0);
+    float revealage = sum.a;
+    // Nothing translucent covers this pixel
+    if (revealage == 1.0) discard;
+
+    float weightSum = max(texelFetch(weight, pixel, 0).r, 1e-5);
+    FragColor = vec4(sum.rgb / weightSum, 1.0 - revealage);
+}
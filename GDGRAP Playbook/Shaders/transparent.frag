@@ -0,0 +1,41 @@
+#version 330 core
+
+// Forward shading of translucent meshes into a TransparencyBuffer; otherwise the same as sample.frag
+
+in vec2 texCoord;
+in vec3 FragPos;
+in mat3 TBN;
+in vec4 tint;
+
+uniform sampler2D normalMap;
+
+#include "albedo.glsl"
+
+// Must match FrameConstants in Classes/FrameConstants.h
+layout(std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 dirLightDirection;
+    vec4 dirLightColor;
+    vec4 pointLightPosition;
+    vec4 pointLightColor;
+    vec4 pointLightAttenuation;
+} frame;
+
+#include "lighting.glsl"
+#include "transparency.glsl"
+
+void main() {
+    // Normal maps are cooked to two-channel BC5, so Z is rebuilt from X and Y
+    vec2 normalXY = texture(normalMap, texCoord).rg * 2.0 - 1.0;
+    vec3 normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
+    normal = normalize(TBN * normal);
+
+    // Texture Mapping
+    vec3 textureColor = SampleAlbedo(texCoord).rgb;
+
+    vec3 finalColor = ShadeSurface(FragPos, normal, textureColor);
+    WriteTransparent(finalColor * tint.rgb, tint.a);
+}
@@ -5,88 +5,36 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <chrono>
 #include <cmath>
+#include <cstdio>
 #include "Classes/Model.h"
 #include "Classes/Camera.h"
 #include "Classes/Light.h"
 #include "Classes/Skybox.h"
 #include "Classes/Player.h"
+#include "Classes/Benchmark.h"
+#include "Classes/AssetCache.h"
+#include "Classes/ShaderProgram.h"
+#include "Classes/FrameConstants.h"
+#include "Classes/RenderQueue.h"
+#include "Classes/GLState.h"
+#include "Classes/MappedFile.h"
+#include "Classes/SceneBVH.h"
+#include "Classes/ImpostorAtlas.h"
+#include "Classes/CascadedShadowMap.h"
+#include "Classes/ClusteredLights.h"
+#include "Classes/GBuffer.h"
+#include "Classes/FragmentCounter.h"
+#include "Classes/GpuTimer.h"
+#include "Classes/TransparencyBuffer.h"
+#include "Classes/StreamBuffer.h"
+#include "Classes/LiveryArray.h"
+#include "Classes/TextureAtlas.h"
+#include <algorithm>
 
-GLuint shaderProgram;
-GLuint lightShaderProgram;
 Skybox* skybox;
 
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-#include <iostream>
-#include <string>
-#include <fstream>
-#include <sstream>
-#include <chrono>
-#include <cmath>
-#include "Classes/Model.h"
-#include "Classes/Camera.h"
-#include "Classes/Light.h"
-#include "Classes/Skybox.h"
-#include "Classes/Player.h"
-
-GLuint shaderProgram;
-GLuint lightShaderProgram;
-Skybox* skybox;
-
-// Function to compile the vertex and fragment shaders
-void CompileShaders() {
-    std::fstream vertSrc("Shaders/sample.vert");
-    std::stringstream vertBuff;
-    vertBuff << vertSrc.rdbuf();
-    std::string vertS = vertBuff.str();
-    const char* vert = vertS.c_str();
-
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vert, nullptr);
-    glCompileShader(vertexShader);
-
-    std::fstream fragSrc("Shaders/sample.frag");
-    std::stringstream fragBuff;
-    fragBuff << fragSrc.rdbuf();
-    std::string fragS = fragBuff.str();
-    const char* frag = fragS.c_str();
-
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &frag, nullptr);
-    glCompileShader(fragmentShader);
-
-    std::fstream lightFragSrc("Shaders/light.frag");
-    std::stringstream lightFragBuff;
-    lightFragBuff << lightFragSrc.rdbuf();
-    std::string lightFragS = lightFragBuff.str();
-    const char* lightFrag = lightFragS.c_str();
-
-    GLuint lightFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(lightFragmentShader, 1, &lightFrag, nullptr);
-    glCompileShader(lightFragmentShader);
-
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    lightShaderProgram = glCreateProgram();
-    glAttachShader(lightShaderProgram, vertexShader);
-    glAttachShader(lightShaderProgram, lightFragmentShader);
-    glLinkProgram(lightShaderProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    glDeleteShader(lightFragmentShader);
-}
-
 // Initialize perspective camera and third person camera
 PerspectiveCamera perspectiveCamera(glm::vec3(0.0f, 0.0f, 10.0f), 45.0f, 0.1f, 100.0f);
 ThirdPersonCamera thirdPersonCamera(glm::vec3(0.0f, 0.0f, 20.0f), 5.0f, 0.1f, 200.0f);
@@ -99,6 +47,13 @@ glm::vec3 directionalLightDir = glm::vec3(0.0f, -1.0f, 0.0f);
 glm::vec3 dirLightColor = glm::vec3(1.0f, 1.0f, 1.0f);
 float dirLightIntensity = 1.0f;
 
+// Point light position and its constant/linear/quadratic falloff
+glm::vec3 pointLightPosition = glm::vec3(1.0f, 5.0f, 1.0f);
+glm::vec3 pointLightAttenuation = glm::vec3(1.0f, 0.02f, 0.002f);
+
+// Night mode turns on the streetlights and headlights
+bool isNight = false;
+
 // Variables for object rotations
 float rotationX = 0.0f;
 float rotationY = 0.2f;
@@ -186,10 +141,12 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
     if (key == GLFW_KEY_Q && action == GLFW_PRESS) {
         dirLightColor = glm::vec3(1.0f, 0.95f, 0.8f); 
         dirLightIntensity = 1.0f; 
+        isNight = false;
     }
     if (key == GLFW_KEY_E && action == GLFW_PRESS) {
         dirLightColor = glm::vec3(0.1f, 0.15f, 0.3f);
         dirLightIntensity = 0.3f;
+        isNight = true;
     }
 }
 
@@ -220,6 +177,126 @@ void MouseCallback(GLFWwindow* window, double xpos, double ypos) {
     thirdPersonCamera.UpdateCameraPosition(carPosition, thirdPersonCamera.yaw);
 }
 
+// A model that never moves, placed once in the static-scene BVH
+struct StaticProp {
+    Model* model;
+    glm::mat4 transform;
+};
+
+// How far in front of an obstacle a chase camera stops
+const float CAMERA_COLLISION_MARGIN = 0.3f;
+
+// Alpha of the ghost cars' tint; they are drawn see-through through the transparency buffer
+const float GHOST_CAR_OPACITY = 0.5f;
+
+// Approximate wheel contact points of Car2.obj relative to its origin
+const glm::vec3 WHEEL_OFFSETS[4] = {
+    glm::vec3(-0.8f, 0.0f, 1.3f),
+    glm::vec3(0.8f, 0.0f, 1.3f),
+    glm::vec3(-0.8f, 0.0f, -1.3f),
+    glm::vec3(0.8f, 0.0f, -1.3f)
+};
+
+// Height of the flat road plane, used for wheel contact until the track BVH is ready
+const float FLAT_GROUND_HEIGHT = 0.0f;
+
+// Loads the BVH over the track's world-space triangles from the cache next to the OBJ, or imports the
+// OBJ, builds it and writes the cache. The cache is keyed on the OBJ's contents and the track transform.
+// Runs on a loader thread; returns null if the track cannot be read.
+std::shared_ptr<SceneBVH> BuildTrackBVH(const std::string& filename, const glm::mat4& transform) {
+    uint64_t hash = 0, size = 0;
+    if (!MappedFile::HashFile(filename, hash, size)) {
+        std::cout << "Failed to open track: " << filename << std::endl;
+        return nullptr;
+    }
+    hash = MappedFile::HashBytes(&transform, sizeof(transform), hash);
+
+    std::shared_ptr<SceneBVH> bvh = std::make_shared<SceneBVH>();
+    std::string cachedFilename = filename.substr(0, filename.find_last_of('.')) + ".bvh";
+    if (bvh->Load(cachedFilename, hash)) return bvh;
+
+    MeshImportOptions options;
+    options.generateTangents = false;
+    options.generateLODs = false;
+    MeshData data;
+    Model::LoadModel(filename, options, data);
+
+    std::vector<glm::vec3> corners;
+    corners.reserve(data.indices.size());
+    for (GLuint index : data.indices) {
+        corners.push_back(glm::vec3(transform * glm::vec4(data.vertices[index].position, 1.0f)));
+    }
+    bvh->BuildTriangles(corners);
+    if (bvh->IsBuilt()) bvh->Save(cachedFilename, hash);
+    return bvh;
+}
+
+// Queues the track BVH's load or build as an asset job, like a mesh; the finished BVH replaces bvh on the
+// render thread, so bvh stays empty for the first frames
+void LoadTrackBVH(const std::string& filename, const glm::mat4& transform, SceneBVH& bvh) {
+    AssetCache::Instance().QueueLoad([filename, transform, &bvh]() -> std::function<void()> {
+        std::shared_ptr<SceneBVH> loaded = BuildTrackBVH(filename, transform);
+        if (!loaded) return nullptr;
+        return [loaded, &bvh]() {
+            bvh = std::move(*loaded);
+        };
+    });
+}
+
+// Casts a ray down at each wheel and averages the heights of the ground they touch.
+// Returns false if no wheel is over the track.
+bool FindGroundHeight(const SceneBVH& track, const glm::vec3& position, float yawDegrees, float& height) {
+    glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), glm::radians(yawDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+    float total = 0.0f;
+    int contacts = 0;
+    for (const glm::vec3& offset : WHEEL_OFFSETS) {
+        glm::vec3 origin = position + glm::vec3(rotation * glm::vec4(offset, 0.0f)) + glm::vec3(0.0f, 2.0f, 0.0f);
+        RayHit hit;
+        if (track.Raycast(origin, glm::vec3(0.0f, -1.0f, 0.0f), 4.0f, hit)) {
+            total += origin.y - hit.distance;
+            contacts++;
+        }
+    }
+    if (contacts == 0) return false;
+    height = total / contacts;
+    return true;
+}
+
+// Moves a chase camera in front of the first static prop between it and its target
+glm::vec3 ResolveCameraCollision(const SceneBVH& props, const glm::vec3& target, const glm::vec3& cameraPosition) {
+    glm::vec3 offset = cameraPosition - target;
+    float distance = glm::length(offset);
+    if (distance <= 0.0f) return cameraPosition;
+
+    glm::vec3 direction = offset / distance;
+    RayHit hit;
+    if (!props.Raycast(target, direction, distance, hit)) return cameraPosition;
+    return target + direction * std::max(hit.distance - CAMERA_COLLISION_MARGIN, 0.0f);
+}
+
+// Milliseconds per frame the render thread may spend uploading finished asset loads
+const double ASSET_UPLOAD_BUDGET_MS = 4.0;
+
+// Draws a loading progress bar along the bottom of the screen using scissored clears
+void DrawLoadingBar(int width, int height, float progress) {
+    int barWidth = width / 2;
+    int barHeight = 12;
+    int barX = (width - barWidth) / 2;
+    int barY = height / 12;
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(barX - 2, barY - 2, barWidth + 4, barHeight + 4);
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glScissor(barX, barY, static_cast<int>(barWidth * progress), barHeight);
+    glClearColor(0.9f, 0.6f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glDisable(GL_SCISSOR_TEST);
+}
+
 // Function to check for collision between a car and a collider
 bool CheckCollision(glm::vec3 carPosition, glm::vec3 colliderPosition, glm::vec3 colliderSize) {
     return (carPosition.x >= colliderPosition.x - colliderSize.x / 2 &&
@@ -228,8 +305,69 @@ bool CheckCollision(glm::vec3 carPosition, glm::vec3 colliderPosition, glm::vec3
         carPosition.z <= colliderPosition.z + colliderSize.z / 2);
 }
 
+//Adds a pair of headlights in front of a car, whose model faces +Z
+void AddHeadlights(std::vector<PointLight>& lights, const glm::mat4& carTransform) {
+    for (float side : { -0.8f, 0.8f }) {
+        glm::vec3 position = glm::vec3(carTransform * glm::vec4(side, 0.8f, 3.0f, 1.0f));
+        lights.push_back(PointLight(position, glm::vec3(1.0f, 0.95f, 0.85f), 25.0f, 12.0f));
+    }
+}
+
+// Track props whose small textures share one atlas, so they draw as a single material
+const std::string PROP_ATLAS_NAME = "3D/props";
+std::vector<AtlasEntry> PropAtlasEntries() {
+    return {
+        { "3D/tires.obj", "3D/carbon.png", "3D/brickwall_normal.jpg" },
+        { "3D/Flag.obj", "3D/tuxedosam.png", "3D/brickwall_normal.jpg" }
+    };
+}
+
 // Main function
-int main(void) {
+int main(int argc, char** argv) {
+    // Command-line benchmarks run without opening a window
+    if (argc >= 3 && std::string(argv[1]) == "--bench-obj") {
+        RunObjParseBenchmark(argv[2]);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-cull") {
+        RunCullingBenchmark(argc >= 3 ? std::stoul(argv[2]) : 100000);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-bvh") {
+        RunBVHBenchmark(argc >= 3 ? std::stoul(argv[2]) : 100000);
+        return 0;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--bench-lod") {
+        RunLODBenchmark(argv[2], argc >= 4 ? std::stoul(argv[3]) : 32);
+        return 0;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-lights") {
+        RunClusterBenchmark(argc >= 3 ? std::stoul(argv[2]) : MAX_CLUSTERED_LIGHTS);
+        return 0;
+    }
+    // Offline asset step: rebuilds the prop atlas without opening a window
+    if (argc >= 2 && std::string(argv[1]) == "--cook-atlas") {
+        return TextureAtlas::Build(PROP_ATLAS_NAME, PropAtlasEntries()) ? 0 : 1;
+    }
+
+    // Shadow quality can be lowered from the command line on slower GPUs
+    ShadowSettings shadowSettings;
+    int streetlightCount = 64;
+    bool useDeferred = false;
+    bool useDepthPrepass = false;
+    bool persistentMapping = true;
+    bool vsync = true;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--deferred") useDeferred = true;
+        else if (std::string(argv[i]) == "--depth-prepass") useDepthPrepass = true;
+        else if (std::string(argv[i]) == "--stream-orphaning") persistentMapping = false;
+        else if (std::string(argv[i]) == "--no-vsync") vsync = false;
+        else if (i + 1 >= argc) break;
+        else if (std::string(argv[i]) == "--shadow-cascades") shadowSettings.cascadeCount = std::stoi(argv[++i]);
+        else if (std::string(argv[i]) == "--shadow-resolution") shadowSettings.resolution = std::stoi(argv[++i]);
+        else if (std::string(argv[i]) == "--streetlights") streetlightCount = std::stoi(argv[++i]);
+    }
+
     std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
     GLFWwindow* window;
     if (!glfwInit()) return -1;
@@ -242,11 +380,77 @@ int main(void) {
 
     glfwMakeContextCurrent(window);
     gladLoadGL();
+    // --no-vsync lets the frame time drop below the refresh interval, for comparing the shading paths
+    glfwSwapInterval(vsync ? 1 : 0);
+    // --stream-orphaning keeps per-frame data on the GL 3.3 path even where buffer storage is available
+    StreamBuffer::Instance().SetPersistentMapping(persistentMapping);
     glfwSetKeyCallback(window, KeyCallback);
     glfwSetCursorPosCallback(window, MouseCallback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    CompileShaders();
+    ShaderProgram shaderProgram("Shaders/sample.vert", "Shaders/sample.frag");
+    ShaderProgram lightShaderProgram("Shaders/sample.vert", "Shaders/light.frag");
+    // Translucent meshes write weighted color and revealage instead of blending over the frame, and so do the
+    // impostors of translucent models such as the ghost cars; opaque models' impostors are alpha-tested, and
+    // under --deferred they fill the G-buffer like the meshes they stand in for
+    ShaderProgram transparentShaderProgram("Shaders/sample.vert", "Shaders/transparent.frag");
+    ShaderProgram impostorShaderProgram("Shaders/impostor.vert", useDeferred ? "Shaders/impostor_gbuffer.frag" : "Shaders/impostor.frag");
+    ShaderProgram transparentImpostorShaderProgram("Shaders/impostor.vert", "Shaders/impostor_transparent.frag");
+    ShaderProgram transparencyCompositeShaderProgram("Shaders/fullscreen.vert", "Shaders/transparency_composite.frag");
+    TransparencyBuffer transparencyBuffer(transparencyCompositeShaderProgram);
+    ShaderProgram depthShaderProgram("Shaders/depth.vert", "Shaders/depth.frag");
+
+    // The deferred path (--deferred) draws opaque meshes into a G-buffer with gBufferShaderProgram and lights
+    // each pixel once with deferredShaderProgram; blended meshes are forward shaded either way
+    ShaderProgram gBufferShaderProgram;
+    ShaderProgram deferredShaderProgram;
+    if (useDeferred) {
+        gBufferShaderProgram.Load("Shaders/sample.vert", "Shaders/gbuffer.frag");
+        deferredShaderProgram.Load("Shaders/fullscreen.vert", "Shaders/deferred.frag");
+    }
+    GBuffer gBuffer(deferredShaderProgram);
+    ShaderProgram& opaqueShaderProgram = useDeferred ? gBufferShaderProgram : shaderProgram;
+
+    // The depth pre-pass (--depth-prepass) lays down opaque depth with a trivial shader first, so the opaque
+    // pass only shades visible pixels; fragment shader invocations are counted to measure the difference
+    ShaderProgram prepassShaderProgram;
+    if (useDepthPrepass) {
+        prepassShaderProgram.Load("Shaders/prepass.vert", "Shaders/depth.frag");
+    }
+    FragmentCounter fragmentCounter;
+    GpuTimer sceneTimer;
+    float frameTimeSum = 0.0f;
+    int frameCount = 0;
+
+    // Camera and light data shared by every shader, uploaded once per frame
+    FrameConstantBuffer frameConstantBuffer;
+
+    // Scene draws are queued, sorted to minimize state changes, and issued in an opaque and a blended Flush per frame
+    RenderQueue renderQueue;
+    float lastStatsTime = 0.0f;
+
+    // Directional light shadows, drawn just before the queue is flushed each frame
+    CascadedShadowMap shadowMap(shadowSettings);
+    std::vector<ShadowCaster> shadowCasters;
+
+    // Point lights are binned into screen-space clusters each frame so sample.frag only shades the nearby ones.
+    // Samplers of different types may not share a unit, so they are pointed at their own units before anything draws.
+    ClusteredLights clusteredLights;
+    std::vector<PointLight> pointLights;
+    shadowMap.Bind(shaderProgram);
+    clusteredLights.Disable();
+    clusteredLights.Bind(shaderProgram);
+    shadowMap.Bind(transparentShaderProgram);
+    clusteredLights.Bind(transparentShaderProgram);
+    if (useDeferred) {
+        shadowMap.Bind(deferredShaderProgram);
+        clusteredLights.Bind(deferredShaderProgram);
+    }
+
+    // Models and the skybox come back as placeholders; decoding runs on loader threads and
+    // the finished data is uploaded a few milliseconds per frame below
+    AssetCache& assetCache = AssetCache::Instance();
+    assetCache.SetAsyncLoading(true);
 
     // Load the player car model
     Model model("3D/Car2.obj", "3D/gtr.png", "3D/steel.png");
@@ -254,11 +458,23 @@ int main(void) {
     float lastFrame = 0.0f;
 
     // Load models for other ghost cars, road, tires, and flag
-    Model modelCar2("3D/Car2.obj", "3D/gtr.png", "3D/steel.png");
-    Model modelCar3("3D/Car2.obj", "3D/gtr.png","3D/steel.png");
+    // Both ghost cars share one model and are drawn together as instances
+    Model ghostCarModel("3D/Car2.obj", "3D/gtr.png", "3D/steel.png");
+    std::vector<InstanceData> ghostCars(2);
+    // Each ghost car wears its own repaint of the player's livery, still in the same instanced draw
+    LiveryArray ghostLiveries({ { "3D/gtr.png", 120.0f }, { "3D/gtr.png", 240.0f } });
+    ghostCarModel.SetLiveries(&ghostLiveries);
+    for (size_t i = 0; i < ghostCars.size(); i++) {
+        ghostCars[i].livery = static_cast<float>(i % ghostLiveries.GetLayerCount());
+    }
+    // Ghost cars far down the track are drawn as billboards, baked once the car has loaded
+    ImpostorAtlas carImpostor(impostorShaderProgram, transparentImpostorShaderProgram);
+    ghostCarModel.SetImpostor(&carImpostor);
     Model roadModel("3D/plane.obj", "3D/asphalt.png");
-    Model tireModel("3D/tires.obj", "3D/carbon.png", "3D/brickwall_normal.jpg");
-    Model flagModel("3D/Flag.obj", "3D/tuxedosam.png", "3D/brickwall_normal.jpg");
+    // Only reads the manifest; --cook-atlas builds the atlas
+    TextureAtlas propAtlas(PROP_ATLAS_NAME, PropAtlasEntries());
+    Model tireModel(propAtlas, "3D/tires.obj");
+    Model flagModel(propAtlas, "3D/Flag.obj");
 
     //Collider properties for the finish line (tires) and its position
     glm::vec3 tireColliderSize = glm::vec3(45.0f, 1.0f, 10.0f);
@@ -269,6 +485,43 @@ int main(void) {
     glm::vec3 car2Position = glm::vec3(4.5f, 0.0f, -0.3f);
     glm::vec3 car3Position = glm::vec3(-2.5f, 0.0f, -0.3f);
 
+    // The tires, flag and road never move, so their transforms are set up once
+    glm::mat4 tireTransform = glm::mat4(1.0f);
+    tireTransform = glm::scale(tireTransform, glm::vec3(1.0f, 1.0f, 1.0f));
+    tireTransform = glm::translate(tireTransform, tirePosition);
+
+    glm::mat4 flagTransform = glm::mat4(1.0f);
+    flagTransform = glm::scale(flagTransform, glm::vec3(0.5f, 0.5f, 0.5f));
+    flagTransform = glm::translate(flagTransform, flagPosition);
+
+    glm::mat4 roadTransform = glm::mat4(1.0f);
+    roadTransform = glm::rotate(roadTransform, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    roadTransform = glm::translate(roadTransform, glm::vec3(0.0f, 90.0f, -0.0000001f));
+    roadTransform = glm::scale(roadTransform, glm::vec3(10.5f, 205.0f, 10.0f));
+
+    // Static props are culled and collided through a BVH over their world boxes. It is built once every
+    // prop's mesh has loaded; until then all of them are submitted and left to the render queue's culling.
+    std::vector<StaticProp> staticProps = {
+        { &tireModel, tireTransform },
+        { &flagModel, flagTransform },
+        { &roadModel, roadTransform }
+    };
+    SceneBVH staticBVH;
+    std::vector<uint32_t> visibleProps;
+
+    // Triangle BVH of the road surface for wheel ground contact, loaded in the background; the car rides on
+    // FLAT_GROUND_HEIGHT until it is in
+    SceneBVH trackBVH;
+    LoadTrackBVH("3D/plane.obj", roadTransform, trackBVH);
+
+    // Streetlights in pairs on both sides of the road, from the start line to past the finish
+    std::vector<PointLight> streetlights;
+    for (int i = 0; i < streetlightCount; i++) {
+        float z = -10.0f + 310.0f * (i / 2) / std::max(streetlightCount / 2, 1);
+        float x = (i % 2 == 0) ? -12.0f : 12.0f;
+        streetlights.push_back(PointLight(glm::vec3(x, 6.0f, z), glm::vec3(1.0f, 0.8f, 0.55f), 40.0f, 15.0f));
+    }
+
     //Skybox textures loading
     std::vector<std::string> skyboxFaces = {
         "Skybox/sunset_rt.png",
@@ -279,51 +532,74 @@ int main(void) {
         "Skybox/sunset_bk.png"
     };
 
-    skybox = new Skybox(skyboxFaces);
+    skybox = new Skybox(skyboxFaces, true);
 
     while (!glfwWindowShouldClose(window)) {
         float currentFrame = glfwGetTime();
         float deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        GLState::ResetCounters();
+        assetCache.ProcessUploads(ASSET_UPLOAD_BUDGET_MS);
+        // glClear leaves depth alone while depth writes are off
+        GLState::DepthMask(true);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
+        GLState::SetDepthTest(true);
 
         int width, height;
         glfwGetFramebufferSize(window, &width, &height);
+        GLState::Viewport(0, 0, width, height);
 
         glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
         glm::mat4 view = activeCamera->GetViewMatrix();
 
         if (activeCamera == &perspectiveCamera) {
-            dynamic_cast<PerspectiveCamera*>(activeCamera)->UpdateCameraPosition(carPosition, carRotationY);
+            PerspectiveCamera* camera = dynamic_cast<PerspectiveCamera*>(activeCamera);
+            camera->UpdateCameraPosition(carPosition, carRotationY);
+            camera->position = ResolveCameraCollision(staticBVH, carPosition + glm::vec3(0.0f, 1.0f, 0.0f), camera->position);
         }
         else {
-            dynamic_cast<ThirdPersonCamera*>(activeCamera)->UpdateCameraPosition(carPosition, carRotationY);
+            ThirdPersonCamera* camera = dynamic_cast<ThirdPersonCamera*>(activeCamera);
+            camera->UpdateCameraPosition(carPosition, carRotationY);
+            camera->position = ResolveCameraCollision(staticBVH, carPosition + glm::vec3(0.0f, 1.0f, 0.0f), camera->position);
         }
 
-        glm::mat4 skyboxView = glm::mat4(glm::mat3(view));
-        skybox->Draw(skyboxView, projection);
-
-        glUseProgram(shaderProgram);
-
         glm::vec3 lightOffset(0.0f, 5.0f, 0.0f);
         glm::vec3 lightDirection = carPosition + lightOffset;
         directionalLightDir = glm::normalize(carPosition - lightDirection);
 
-        GLuint dirLightDirLoc = glGetUniformLocation(shaderProgram, "directionalLightDir");
-        glUniform3fv(dirLightDirLoc, 1, glm::value_ptr(directionalLightDir));
+        glm::vec3 cameraPosition = activeCamera == &perspectiveCamera ?
+            dynamic_cast<PerspectiveCamera*>(activeCamera)->position :
+            dynamic_cast<ThirdPersonCamera*>(activeCamera)->position;
+
+        // Baking overwrites the frame constants and the viewport, so it runs before both are set for the frame
+        if (!carImpostor.IsBuilt() && !assetCache.IsLoading() && ghostCarModel.IsReady()) {
+            FrameConstants bakeLighting;
+            bakeLighting.SetDirectionalLight(directionalLightDir, dirLightColor, dirLightIntensity);
+            bakeLighting.SetPointLight(pointLightPosition, glm::vec3(1.0f), 1.0f, pointLightAttenuation);
+            shadowMap.Disable();
+            clusteredLights.Disable();
+            carImpostor.Build(ghostCarModel, shaderProgram, frameConstantBuffer, bakeLighting);
+            GLState::Viewport(0, 0, width, height);
+        }
 
-        GLint dirLightColorLoc = glGetUniformLocation(shaderProgram, "dirLight.color");
-        glUniform3fv(dirLightColorLoc, 1, glm::value_ptr(dirLightColor)); 
+        FrameConstants frameConstants;
+        frameConstants.SetCamera(view, projection, cameraPosition);
+        frameConstants.SetDirectionalLight(directionalLightDir, dirLightColor, dirLightIntensity);
+        frameConstants.SetPointLight(pointLightPosition, glm::vec3(1.0f), 1.0f, pointLightAttenuation);
+        frameConstantBuffer.Update(frameConstants);
 
-        GLint dirLightIntensityLoc = glGetUniformLocation(shaderProgram, "dirLight.intensity");
-        glUniform1f(dirLightIntensityLoc, dirLightIntensity);
+        renderQueue.Begin(cameraPosition, view, projection);
 
         float radians = glm::radians(carRotationY);
         glm::vec3 direction(sin(radians), 0.0f, cos(radians));
         carPosition += direction * carVelocity * deltaTime;
 
         player1.Update(deltaTime);
+        float groundHeight = FLAT_GROUND_HEIGHT;
+        if (!trackBVH.IsBuilt() || FindGroundHeight(trackBVH, carPosition, carRotationY, groundHeight)) {
+            carPosition.y = groundHeight;
+            player1.SetGroundHeight(groundHeight);
+        }
         player1.SetVelocity(carVelocity);
         player1.SetRotationY(carRotationY);
 
@@ -351,76 +627,125 @@ int main(void) {
             std::cout << "Game Over! All karts finished in: " << elapsed.count() << " seconds" << std::endl;
             printTimeOnce = true;
         }
-        player1.Draw(shaderProgram, projection, view);
-
-        glm::mat4 tireTransform = glm::mat4(1.0f);
-        tireTransform = glm::scale(tireTransform, glm::vec3(1.0f, 1.0f, 1.0f));
-        tireTransform = glm::translate(tireTransform, tirePosition);
-        glm::mat4 tireMVP = projection * view * tireTransform;
-
-        
-        glUseProgram(shaderProgram); 
-
-   
-        glm::vec3 lightPos = glm::vec3(1, 5, 1);
-        GLuint lightPosLoc = glGetUniformLocation(shaderProgram, "lightPos");
-        glUniform3fv(lightPosLoc, 1, glm::value_ptr(lightPos));
-
-        GLuint viewPosLoc = glGetUniformLocation(shaderProgram, "viewPos");
+        player1.Submit(renderQueue, opaqueShaderProgram);
 
+        if (!staticBVH.IsBuilt() && std::all_of(staticProps.begin(), staticProps.end(), [](const StaticProp& prop) { return prop.model->IsReady(); })) {
+            std::vector<BoundingBox> propBoxes;
+            for (const StaticProp& prop : staticProps) {
+                propBoxes.push_back(prop.model->GetBounds().box.Transform(prop.transform));
+            }
+            staticBVH.BuildBoxes(propBoxes);
+        }
 
-        if (activeCamera == &perspectiveCamera) {
-            glUniform3fv(viewPosLoc, 1, glm::value_ptr(dynamic_cast<PerspectiveCamera*>(activeCamera)->position));
+        visibleProps.clear();
+        if (staticBVH.IsBuilt()) {
+            staticBVH.CullFrustum(Frustum::FromMatrix(frameConstants.viewProjection), visibleProps);
         }
         else {
-            glUniform3fv(viewPosLoc, 1, glm::value_ptr(dynamic_cast<ThirdPersonCamera*>(activeCamera)->position));
+            for (uint32_t i = 0; i < staticProps.size(); i++) visibleProps.push_back(i);
+        }
+        for (uint32_t prop : visibleProps) {
+            staticProps[prop].model->Submit(renderQueue, opaqueShaderProgram, staticProps[prop].transform);
         }
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, tireModel.GetTextureID());
-        glUniform1i(glGetUniformLocation(shaderProgram, "tex0"), 0);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, tireModel.GetNormalMapTextureID());
-        glUniform1i(glGetUniformLocation(shaderProgram, "normalMap"), 1);
-
-        tireModel.Draw(shaderProgram, tireMVP);
-
-        glm::mat4 flagTransform = glm::mat4(1.0f);
-        flagTransform = glm::scale(flagTransform, glm::vec3(0.5f, 0.5f, 0.5f));
-        flagTransform = glm::translate(flagTransform, flagPosition);
-        glm::mat4 flagMVP = projection * view * flagTransform;
-        flagModel.Draw(shaderProgram, flagMVP);
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_DST_COLOR);
 
         glm::mat4 car2Transform = glm::mat4(1.0f);
         car2Transform = glm::scale(car2Transform, glm::vec3(0.8f, 0.8f, 0.8f));
         car2Transform = glm::translate(car2Transform, car2Position);
-        glm::mat4 car2MVP = projection * view * car2Transform;
-        modelCar2.Draw(shaderProgram, car2MVP);
+        ghostCars[0].model = car2Transform;
+        ghostCars[0].tint = glm::vec4(1.0f, 1.0f, 1.0f, GHOST_CAR_OPACITY);
 
         glm::mat4 car3Transform = glm::mat4(1.0f);
         car3Transform = glm::scale(car3Transform, glm::vec3(1.7f, 1.7f, 1.7f));
         car3Transform = glm::translate(car3Transform, car3Position);
-        glm::mat4 car3MVP = projection * view * car3Transform;
-        modelCar3.Draw(shaderProgram, car3MVP);
+        ghostCars[1].model = car3Transform;
+        ghostCars[1].tint = glm::vec4(1.0f, 1.0f, 1.0f, GHOST_CAR_OPACITY);
 
-        glm::mat4 roadTransform = glm::mat4(1.0f);
+        ghostCarModel.SubmitInstanced(renderQueue, transparentShaderProgram, ghostCars, BLEND_TRANSPARENT);
 
-        glDisable(GL_BLEND);
+        // Every car and prop except the road casts, whether or not the camera can see it
+        shadowCasters.clear();
+        player1.AddShadowCaster(shadowCasters);
+        for (const InstanceData& ghostCar : ghostCars) {
+            ghostCarModel.AddShadowCaster(shadowCasters, ghostCar.model);
+        }
+        for (const StaticProp& prop : staticProps) {
+            if (prop.model != &roadModel) prop.model->AddShadowCaster(shadowCasters, prop.transform);
+        }
+        shadowMap.Update(view, projection, directionalLightDir);
+        shadowMap.Render(shadowCasters, depthShaderProgram);
+        GLState::Viewport(0, 0, width, height);
+        shadowMap.Bind(shaderProgram);
+
+        pointLights.clear();
+        if (isNight) {
+            pointLights.insert(pointLights.end(), streetlights.begin(), streetlights.end());
+            AddHeadlights(pointLights, player1.GetTransform());
+            for (const InstanceData& ghostCar : ghostCars) {
+                AddHeadlights(pointLights, ghostCar.model);
+            }
+        }
+        clusteredLights.Assign(pointLights, view, projection, width, height);
+        clusteredLights.Upload();
+        clusteredLights.Bind(shaderProgram);
+        shadowMap.Bind(transparentShaderProgram);
+        clusteredLights.Bind(transparentShaderProgram);
+
+        fragmentCounter.Begin();
+        sceneTimer.Begin();
+        if (useDeferred) {
+            shadowMap.Bind(deferredShaderProgram);
+            clusteredLights.Bind(deferredShaderProgram);
+            gBuffer.BeginGeometry(width, height);
+        }
+        if (useDepthPrepass) {
+            renderQueue.FlushDepthPrepass(opaqueShaderProgram, prepassShaderProgram);
+        }
+        renderQueue.Flush(RENDER_PASS_OPAQUE);
+        if (useDeferred) {
+            gBuffer.Light(glm::inverse(frameConstants.viewProjection));
+        }
+        // The sky goes last among the opaque draws, so early-Z rejects it wherever geometry covers it
+        skybox->Draw();
+        // Translucent draws accumulate in any order, then resolve over the frame in one fullscreen pass
+        transparencyBuffer.Begin(width, height);
+        renderQueue.Flush(RENDER_PASS_BLENDED);
+        transparencyBuffer.Composite();
+        sceneTimer.End();
+        fragmentCounter.End();
+
+        // Report the shading path, average frame time and GPU time of the scene passes, the queue's draw, draw call, triangle, cull and state-change counts, stream buffer stalls, and
+        // how many GL calls the state cache let through versus dropped this frame, in the title once a second
+        frameTimeSum += deltaTime;
+        frameCount++;
+        if (currentFrame - lastStatsTime >= 1.0f) {
+            const RenderStats& stats = renderQueue.GetStats();
+            const GLStateCounters& calls = GLState::GetCounters();
+            char frameTime[48];
+            std::snprintf(frameTime, sizeof(frameTime), "%.2f ms, GPU %.2f ms", 1000.0f * frameTimeSum / frameCount, sceneTimer.TakeAverageMilliseconds());
+            frameTimeSum = 0.0f;
+            frameCount = 0;
+            std::string title = "Machine Project | " + std::string(useDeferred ? "deferred" : "forward") +
+                (useDepthPrepass ? " + depth pre-pass " : " ") + frameTime + " | " +
+                (fragmentCounter.IsSupported() ? std::to_string(fragmentCounter.GetLastCount()) + " fragments, " : std::string()) + std::to_string(stats.draws) + " draws in " + std::to_string(stats.drawCalls) + " calls, " + std::to_string(stats.triangles) + " triangles, " +
+                std::to_string(stats.culled) + " culled, " + std::to_string(shadowMap.GetDrawCount()) + " shadow draws, " +
+                std::to_string(StreamBuffer::Instance().GetStallCount()) + " stream stalls, " +
+                std::to_string(clusteredLights.GetLightCount()) + " lights, " + std::to_string(stats.GetStateChanges()) + " state changes, " +
+                std::to_string(calls.issued) + " GL calls issued / " + std::to_string(calls.skipped) + " skipped";
+            glfwSetWindowTitle(window, title.c_str());
+            lastStatsTime = currentFrame;
+        }
 
-        roadTransform = glm::rotate(roadTransform, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        roadTransform = glm::translate(roadTransform, glm::vec3(0.0f, 90.0f, -0.0000001f));
-        roadTransform = glm::scale(roadTransform, glm::vec3(10.5f, 205.0f, 10.0f));
-        glm::mat4 roadMVP = projection * view * roadTransform;
-        roadModel.Draw(shaderProgram, roadMVP);
+        if (assetCache.IsLoading()) {
+            DrawLoadingBar(width, height, assetCache.GetLoadingProgress());
+        }
 
+        // Fences this frame's streamed instances, commands and constants before the next frame writes its own
+        StreamBuffer::Instance().EndFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    assetCache.Shutdown();
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;